@@ -0,0 +1,86 @@
+/*
+ * Benchmark of xalgo sorting and searching against the C library.
+ *
+ * Usage: xalgobench [count]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <xlib/xalgo.h>
+
+XVEC_ALGO_INIT(int, int, xv_generic_lt)
+XVEC_RADIX_INIT(int, int)
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+    int *src = malloc(sizeof(int) * n), *a = malloc(sizeof(int) * n);
+    uint64_t rng = UINT64_C(0x9e3779b97f4a7c15);
+    size_t found = 0;
+    double t;
+
+    if (src == NULL || a == NULL || n == 0) {
+        fprintf(stderr, "cannot allocate %zu elements\n", n);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < n; i++) {
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        src[i] = (int) (rng * UINT64_C(2685821657736338717) >> 32);
+    }
+
+    memcpy(a, src, sizeof(int) * n);
+    t = now();
+    qsort(a, n, sizeof(int), cmp_int);
+    printf("qsort          %8.2f ns/element\n", (now() - t) * 1e9 / n);
+
+    memcpy(a, src, sizeof(int) * n);
+    t = now();
+    xv_sort_int(a, n);
+    printf("xv_sort        %8.2f ns/element\n", (now() - t) * 1e9 / n);
+
+    memcpy(a, src, sizeof(int) * n);
+    t = now();
+    if (xv_radix_sort_int(a, n) != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("xv_radix_sort  %8.2f ns/element\n", (now() - t) * 1e9 / n);
+
+    t = now();
+    for (size_t i = 0; i < n; i++) {
+        found += bsearch(&src[i], a, n, sizeof(int), cmp_int) != NULL;
+    }
+    printf("bsearch        %8.2f ns/lookup\n", (now() - t) * 1e9 / n);
+
+    t = now();
+    for (size_t i = 0; i < n; i++) {
+        found += xv_bsearch_int(a, n, src[i]) != n;
+    }
+    printf("xv_bsearch     %8.2f ns/lookup\n", (now() - t) * 1e9 / n);
+
+    free(a);
+    free(src);
+    return (found == 2 * n) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
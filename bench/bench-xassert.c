@@ -0,0 +1,133 @@
+/*
+ * Benchmark of the hot-loop cost of each xassert tier: a loop summing an array
+ * with no check, then with one XASSERT_LT, XASSERT_DEBUG_LT or
+ * XASSERT_PARANOID_LT per element. Built once with every tier enabled and once
+ * with only the always-on tier.
+ *
+ * For comparison, a last loop expands its check the way xassert used to, with
+ * the failure logging inline at the site instead of in a cold handler. Compare
+ * the code size of sum_always and sum_inline with nm -S.
+ *
+ * Usage: xassertbench [count]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <xlib/xassert.h>
+
+#define N 4096
+
+static int s_data[N];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__ ((noinline))
+static int64_t sum_none(const int *a, size_t n)
+{
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i];
+    }
+    return sum;
+}
+
+__attribute__ ((noinline))
+static int64_t sum_always(const int *a, size_t n)
+{
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        XASSERT_LT(a[i], N);
+        sum += a[i];
+    }
+    return sum;
+}
+
+__attribute__ ((noinline))
+static int64_t sum_debug(const int *a, size_t n)
+{
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        XASSERT_DEBUG_LT(a[i], N);
+        sum += a[i];
+    }
+    return sum;
+}
+
+__attribute__ ((noinline))
+static int64_t sum_paranoid(const int *a, size_t n)
+{
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        XASSERT_PARANOID_LT(a[i], N);
+        sum += a[i];
+    }
+    return sum;
+}
+
+/* The failure path as it was: logging calls and their arguments at the site. */
+#define INLINE_ASSERT_LT(x, y) do { \
+        if (!((x) < (y))) { \
+            _xlog(XLOG_CRIT, true, __FILE__, __LINE__, __func__, \
+                  "Assert: failed expression (%s)", #x " < " #y); \
+            _xlog(XLOG_CRIT, false, __FILE__, __LINE__, __func__, \
+                  "LHS: %d\nRHS: %d", (x), (y)); \
+            abort(); \
+        } \
+    } while (0)
+
+__attribute__ ((noinline))
+static int64_t sum_inline(const int *a, size_t n)
+{
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        INLINE_ASSERT_LT(a[i], N);
+        sum += a[i];
+    }
+    return sum;
+}
+
+static void run(const char *name, int64_t (*f)(const int *, size_t), size_t rounds)
+{
+    volatile int64_t sink = 0;
+    double t = now();
+
+    for (size_t r = 0; r < rounds; r++) {
+        sink = sink + f(s_data, N);
+    }
+    printf("%-20s %8.3f ns/elem\n", name, (now() - t) * 1e9 / ((double) rounds * N));
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000000;
+    size_t rounds = (count + N - 1) / N;
+
+    for (int i = 0; i < N; i++) {
+        s_data[i] = i;
+    }
+
+    printf("XASSERT_LEVEL %d\n", XASSERT_LEVEL);
+    run("no check", sum_none, rounds);
+    run("XASSERT_LT", sum_always, rounds);
+    run("XASSERT_DEBUG_LT", sum_debug, rounds);
+    run("XASSERT_PARANOID_LT", sum_paranoid, rounds);
+    run("inline failure", sum_inline, rounds);
+
+    return EXIT_SUCCESS;
+}
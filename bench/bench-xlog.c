@@ -0,0 +1,104 @@
+/*
+ * Benchmark of the cost of disabled xlog messages: compiled out, disabled at
+ * runtime by the inline level check, and disabled behind a call to
+ * xlog_enabled, with an enabled message to a no-op log function for scale.
+ *
+ * Usage: xlogbench [count]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* XLOG_DEBUG messages are compiled out; XLOG_INFO ones are checked at runtime. */
+#define XLOG_COMPILE_LEVEL XLOG_INFO
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <xlib/xlog.h>
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void null_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) line;
+    (void) func;
+    (void) fmt;
+    (void) args;
+}
+
+/* An argument that is costly to compute, which disabled messages skip. */
+static uint64_t costly(uint64_t x)
+{
+    for (int i = 0; i < 8; i++) {
+        x = x * UINT64_C(6364136223846793005) + 1;
+    }
+    return x;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000000;
+    volatile uint64_t sink = 0;
+    double t;
+
+    xlog_set_log_func(null_func);
+    xlog_set_log_priority(XLOG_WARNING);
+
+    t = now();
+    for (size_t i = 0; i < count; i++) {
+        sink = sink + i;
+    }
+    printf("empty loop       %8.2f ns/iter\n", (now() - t) * 1e9 / count);
+
+    t = now();
+    for (size_t i = 0; i < count; i++) {
+        sink = sink + i;
+        xlog(XLOG_DEBUG, "value %llu", (unsigned long long) costly(sink));
+    }
+    printf("compiled out     %8.2f ns/iter\n", (now() - t) * 1e9 / count);
+
+    t = now();
+    for (size_t i = 0; i < count; i++) {
+        sink = sink + i;
+        xlog(XLOG_INFO, "value %llu", (unsigned long long) costly(sink));
+    }
+    printf("runtime check    %8.2f ns/iter\n", (now() - t) * 1e9 / count);
+
+    /* What the macros did before: a call, with the arguments evaluated. */
+    t = now();
+    for (size_t i = 0; i < count; i++) {
+        sink = sink + i;
+        _xlog(XLOG_INFO, true, __FILE__, __LINE__, __func__,
+              "value %llu", (unsigned long long) costly(sink));
+    }
+    printf("call and check   %8.2f ns/iter\n", (now() - t) * 1e9 / count);
+
+    count /= 10;
+    xlog_set_log_priority(XLOG_INFO);
+    t = now();
+    for (size_t i = 0; i < count; i++) {
+        sink = sink + i;
+        xlog(XLOG_INFO, "value %llu", (unsigned long long) costly(sink));
+    }
+    printf("enabled, no-op   %8.2f ns/iter\n", (now() - t) * 1e9 / count);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*
+ * Benchmark of xpool against malloc on an alloc/free churn over a working set
+ * of live objects.
+ *
+ * Usage: xpoolbench [rounds]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <xlib/xpool.h>
+
+#define LIVE     1000
+#define OBJ_SIZE 48
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000;
+    static void *live[LIVE];
+    uint64_t rng = UINT64_C(0x9e3779b97f4a7c15);
+    size_t k;
+    xpool *pool;
+    double t;
+
+    /* Replace random live objects, so frees come in a scattered order. */
+    for (size_t i = 0; i < LIVE; i++) {
+        live[i] = malloc(OBJ_SIZE);
+    }
+    t = now();
+    for (size_t i = 0; i < rounds * LIVE; i++) {
+        rng = rng * UINT64_C(6364136223846793005) + 1;
+        k = (rng >> 33) % LIVE;
+        free(live[k]);
+        live[k] = malloc(OBJ_SIZE);
+    }
+    printf("malloc/free      %8.2f ns/pair\n", (now() - t) * 1e9 / (rounds * LIVE));
+    for (size_t i = 0; i < LIVE; i++) {
+        free(live[i]);
+    }
+
+    pool = xpool_create(OBJ_SIZE, 0);
+    if (pool == NULL) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < LIVE; i++) {
+        live[i] = xpool_alloc(pool);
+    }
+    t = now();
+    for (size_t i = 0; i < rounds * LIVE; i++) {
+        rng = rng * UINT64_C(6364136223846793005) + 1;
+        k = (rng >> 33) % LIVE;
+        xpool_free(pool, live[k]);
+        live[k] = xpool_alloc(pool);
+    }
+    printf("xpool alloc/free %8.2f ns/pair\n", (now() - t) * 1e9 / (rounds * LIVE));
+    xpool_destroy(pool);
+
+    return EXIT_SUCCESS;
+}
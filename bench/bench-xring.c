@@ -0,0 +1,111 @@
+/*
+ * Benchmark of xring throughput with one producer and one consumer thread,
+ * for single and batch operations on both queue flavors.
+ *
+ * Usage: xringbench [count]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <xlib/xring.h>
+
+#define CAPACITY 1024
+#define BATCH    16
+
+XRING_INIT(u64, uint64_t)
+
+typedef struct run {
+    int mpmc;
+    size_t batch;
+    uint64_t count;
+    xring_spsc_t(u64) *spsc;
+    xring_mpmc_t(u64) *q;
+} run;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *producer(void *arg)
+{
+    run *r = arg;
+    uint64_t buf[BATCH];
+    uint64_t next = 0;
+    size_t n;
+
+    while (next < r->count) {
+        for (n = 0; n < r->batch && next + n < r->count; n++) {
+            buf[n] = next + n;
+        }
+        n = r->mpmc ? xr_mpmc_push_n(u64, r->q, buf, n)
+                    : xr_spsc_push_n(u64, r->spsc, buf, n);
+        if (n == 0) {
+            sched_yield();
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+static void measure(int mpmc, size_t batch, uint64_t count)
+{
+    run r = { mpmc, batch, count, NULL, NULL };
+    uint64_t buf[BATCH], got = 0, sum = 0;
+    pthread_t thread;
+    size_t n;
+    double t;
+
+    r.spsc = xr_spsc_init(u64, CAPACITY);
+    r.q = xr_mpmc_init(u64, CAPACITY);
+    if (r.spsc == NULL || r.q == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    t = now();
+    pthread_create(&thread, NULL, producer, &r);
+    while (got < count) {
+        n = mpmc ? xr_mpmc_pop_n(u64, r.q, buf, batch)
+                 : xr_spsc_pop_n(u64, r.spsc, buf, batch);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            sum += buf[i];
+        }
+        got += n;
+    }
+    pthread_join(thread, NULL);
+    t = now() - t;
+
+    if (sum != count * (count - 1) / 2) {
+        fprintf(stderr, "lost elements\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%s batch %2zu  %8.2f Mops/s\n", mpmc ? "mpmc" : "spsc", batch,
+           count / t * 1e-6);
+
+    xr_spsc_destroy(u64, r.spsc);
+    xr_mpmc_destroy(u64, r.q);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t count = (argc > 1) ? strtoull(argv[1], NULL, 0) : 10000000;
+
+    measure(0, 1, count);
+    measure(0, BATCH, count);
+    measure(1, 1, count);
+    measure(1, BATCH, count);
+    return EXIT_SUCCESS;
+}
@@ -23,6 +23,26 @@ limitations under the License.
 #define xroundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 #endif
 
+/*
+ * With XLIB_ALLOC_ARENA defined, allocations go through the arena bound to the
+ * calling thread with xarena_bind, and through libc when none is bound.
+ */
+#ifdef XLIB_ALLOC_ARENA
+#include <xlib/xarena.h>
+#ifndef xcalloc
+#define xcalloc(N,Z) xarena_bound_calloc(N,Z)
+#endif
+#ifndef xmalloc
+#define xmalloc(Z) xarena_bound_malloc(Z)
+#endif
+#ifndef xrealloc
+#define xrealloc(P,Z) xarena_bound_realloc(P,Z)
+#endif
+#ifndef xfree
+#define xfree(P) xarena_bound_free(P)
+#endif
+#endif
+
 #ifndef xcalloc
 #define xcalloc(N,Z) calloc(N,Z)
 #endif
@@ -0,0 +1,300 @@
+/*
+Copyright 2020 Xevo Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+<http://www.apache.org/licenses/LICENSE-2.0>
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+  An example:
+
+#include <xlib/xalgo.h>
+#include <xlib/xvec.h>
+XVEC_ALGO_INIT(int, int, xv_generic_lt)
+XVEC_RADIX_INIT(int, int)
+int main() {
+	xvec_t(int) array;
+	xv_init(array);
+	...
+	xv_sort(int, array); // introsort
+	xv_radix_sort(int, array); // LSD radix sort, integer types only
+	xv_unique(int, array); // drop adjacent duplicates
+	size_t i = xv_lower_bound(int, array, 5);
+	xv_destroy(array);
+	return 0;
+}
+*/
+
+#ifndef XLIB_XALGO_H_
+#define XLIB_XALGO_H_
+
+/*!
+  @header
+
+  Generic, type-specialized algorithms over arrays and xvecs.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <xlib/alloc.h>
+
+#ifndef xa_inline
+#define xa_inline static inline __attribute__ ((__unused__))
+#endif
+
+/* Below this many elements, introsort finishes with an insertion sort. */
+#define XVEC_ALGO_SMALL 16
+
+/*! @function
+  @abstract     Default less-than comparison
+ */
+#define xv_generic_lt(a, b) ((a) < (b))
+
+#define __XVEC_ALGO_SORT(name, type, __less)							\
+	xa_inline void __xv_insertsort_##name(type *s, type *e)				\
+	{																	\
+		type *i, *j, t;													\
+		for (i = s + 1; i < e; ++i) {									\
+			t = *i;														\
+			for (j = i; j > s && __less(t, *(j - 1)); --j)				\
+				*j = *(j - 1);											\
+			*j = t;														\
+		}																\
+	}																	\
+	xa_inline void __xv_siftdown_##name(type *a, size_t i, size_t n)	\
+	{																	\
+		size_t k;														\
+		type t = a[i];													\
+		while ((k = (i << 1) + 1) < n) {								\
+			if (k + 1 < n && __less(a[k], a[k + 1])) ++k;				\
+			if (!__less(t, a[k])) break;								\
+			a[i] = a[k];												\
+			i = k;														\
+		}																\
+		a[i] = t;														\
+	}																	\
+	xa_inline void __xv_heapsort_##name(type *a, size_t n)				\
+	{																	\
+		size_t i;														\
+		type t;															\
+		for (i = n >> 1; i-- > 0; )										\
+			__xv_siftdown_##name(a, i, n);								\
+		for (i = n; i-- > 1; ) {										\
+			t = a[0]; a[0] = a[i]; a[i] = t;							\
+			__xv_siftdown_##name(a, 0, i);								\
+		}																\
+	}																	\
+	/* Order *a <= *b <= *c and return b. */							\
+	xa_inline type *__xv_median3_##name(type *a, type *b, type *c)		\
+	{																	\
+		type t;															\
+		if (__less(*b, *a)) { t = *a; *a = *b; *b = t; }				\
+		if (__less(*c, *b)) {											\
+			t = *b; *b = *c; *c = t;									\
+			if (__less(*b, *a)) { t = *a; *a = *b; *b = t; }			\
+		}																\
+		return b;														\
+	}																	\
+	xa_inline void __xv_introsort_##name(type *s, type *e, int depth)	\
+	{																	\
+		type *i, *j, pivot, t;											\
+		while (e - s > XVEC_ALGO_SMALL) {								\
+			if (depth-- == 0) {											\
+				__xv_heapsort_##name(s, (size_t)(e - s));				\
+				return;													\
+			}															\
+			pivot = *__xv_median3_##name(s, s + ((e - s) >> 1), e - 1);	\
+			/* Hoare partition; s[0] and e[-1] act as sentinels. */		\
+			i = s; j = e - 1;											\
+			for (;;) {													\
+				while (__less(*i, pivot)) ++i;							\
+				while (__less(pivot, *j)) --j;							\
+				if (i >= j) break;										\
+				t = *i; *i = *j; *j = t;								\
+				++i; --j;												\
+			}															\
+			++j;														\
+			/* Recurse into the smaller half, loop on the larger. */	\
+			if (j - s < e - j) {										\
+				__xv_introsort_##name(s, j, depth);						\
+				s = j;													\
+			} else {													\
+				__xv_introsort_##name(j, e, depth);						\
+				e = j;													\
+			}															\
+		}																\
+		__xv_insertsort_##name(s, e);									\
+	}																	\
+	xa_inline void xv_sort_##name(type *a, size_t n)					\
+	{																	\
+		int depth = 0;													\
+		size_t k;														\
+		for (k = n; k > 1; k >>= 1) depth += 2;							\
+		__xv_introsort_##name(a, a + n, depth);							\
+	}
+
+#define __XVEC_ALGO_SEARCH(name, type, __less)							\
+	/* Index of the first element not less than key, branch-free. */	\
+	xa_inline size_t xv_lower_bound_##name(const type *a, size_t n, type key) \
+	{																	\
+		const type *base = a;											\
+		size_t half;													\
+		if (n == 0) return 0;											\
+		while (n > 1) {													\
+			half = n >> 1;												\
+			base = __less(base[half], key)? base + half : base;		\
+			n -= half;													\
+		}																\
+		return (size_t)(base - a) + __less(*base, key);					\
+	}																	\
+	/* Index of the first element greater than key, branch-free. */		\
+	xa_inline size_t xv_upper_bound_##name(const type *a, size_t n, type key) \
+	{																	\
+		const type *base = a;											\
+		size_t half;													\
+		if (n == 0) return 0;											\
+		while (n > 1) {													\
+			half = n >> 1;												\
+			base = !__less(key, base[half])? base + half : base;		\
+			n -= half;													\
+		}																\
+		return (size_t)(base - a) + !__less(key, *base);				\
+	}																	\
+	/* Index of an element equal to key, or n if there is none. */		\
+	xa_inline size_t xv_bsearch_##name(const type *a, size_t n, type key) \
+	{																	\
+		size_t i = xv_lower_bound_##name(a, n, key);					\
+		return (i < n && !__less(key, a[i]))? i : n;					\
+	}
+
+#define __XVEC_ALGO_FILTER(name, type, __less)							\
+	/*																	\
+	 * Keep the elements for which pred is true, preserving their order. \
+	 * Returns the new number of elements.								\
+	 */																	\
+	xa_inline size_t xv_filter_##name(type *a, size_t n,				\
+			int (*pred)(const type *, void *), void *ctx)				\
+	{																	\
+		size_t i, j;													\
+		for (i = j = 0; i < n; ++i) {									\
+			if (pred(&a[i], ctx)) {										\
+				if (i != j) a[j] = a[i];								\
+				++j;													\
+			}															\
+		}																\
+		return j;														\
+	}																	\
+	/*																	\
+	 * Move the elements for which pred is true in front of the others,	\
+	 * preserving the relative order in both groups. Returns the number	\
+	 * of elements for which pred is true, or (size_t)-1 if the scratch	\
+	 * buffer could not be allocated.										\
+	 */																	\
+	xa_inline size_t xv_stable_partition_##name(type *a, size_t n,		\
+			int (*pred)(const type *, void *), void *ctx)				\
+	{																	\
+		size_t i, j, k;													\
+		type *rest;														\
+		/* Skip the prefix that is already in place. */					\
+		for (i = 0; i < n && pred(&a[i], ctx); ++i);					\
+		if (i == n) return n;											\
+		rest = (type*)xmalloc(sizeof(type) * (n - i));					\
+		if (!rest) return (size_t)-1;									\
+		for (j = k = i; j < n; ++j) {									\
+			if (pred(&a[j], ctx)) a[k++] = a[j];						\
+			else rest[j - k] = a[j];									\
+		}																\
+		memcpy(a + k, rest, sizeof(type) * (n - k));					\
+		xfree(rest);													\
+		return k;														\
+	}																	\
+	/*																	\
+	 * Remove adjacent duplicates, keeping the first of each run.		\
+	 * Returns the new number of elements.								\
+	 */																	\
+	xa_inline size_t xv_unique_##name(type *a, size_t n)				\
+	{																	\
+		size_t i, j;													\
+		if (n == 0) return 0;											\
+		for (i = j = 1; i < n; ++i) {									\
+			if (__less(a[j - 1], a[i]) || __less(a[i], a[j - 1])) {	\
+				if (i != j) a[j] = a[i];								\
+				++j;													\
+			}															\
+		}																\
+		return j;														\
+	}
+
+/*! @function
+  @abstract     Instantiate sort, search, filter and unique algorithms
+  @param  name  Name of the instantiation [symbol]
+  @param  type  Type of the elements [type]
+  @param  __less  Strict weak ordering, called as __less(a, b) [macro or function]
+ */
+#define XVEC_ALGO_INIT(name, type, __less)								\
+	__XVEC_ALGO_SORT(name, type, __less)								\
+	__XVEC_ALGO_SEARCH(name, type, __less)								\
+	__XVEC_ALGO_FILTER(name, type, __less)
+
+/*! @function
+  @abstract     Instantiate an LSD radix sort for an integer type
+  @param  name  Name of the instantiation [symbol]
+  @param  type  Integer type of the elements, signed or unsigned [type]
+  @discussion   xv_radix_sort_##name returns 0 on success, -1 if the scratch
+                buffer could not be allocated.
+ */
+#define XVEC_RADIX_INIT(name, type)										\
+	xa_inline uint64_t __xv_radix_key_##name(type x)					\
+	{																	\
+		/* Flip the sign bit so negative values sort first. */			\
+		return (uint64_t)x ^ (((type)-1 < (type)1)?						\
+			(uint64_t)1 << (sizeof(type) * 8 - 1) : 0);					\
+	}																	\
+	xa_inline int xv_radix_sort_##name(type *a, size_t n)				\
+	{																	\
+		size_t cnt[256], i, sum, c;										\
+		unsigned shift;													\
+		type *src = a, *dst, *buf, *t;									\
+		if (n < 2) return 0;											\
+		buf = dst = (type*)xmalloc(sizeof(type) * n);					\
+		if (!buf) return -1;											\
+		for (shift = 0; shift < sizeof(type) * 8; shift += 8) {			\
+			memset(cnt, 0, sizeof(cnt));								\
+			for (i = 0; i < n; ++i)										\
+				++cnt[(__xv_radix_key_##name(src[i]) >> shift) & 0xff];	\
+			/* All elements share this digit; nothing to reorder. */	\
+			if (cnt[(__xv_radix_key_##name(src[0]) >> shift) & 0xff] == n) \
+				continue;												\
+			for (i = sum = 0; i < 256; ++i) {							\
+				c = cnt[i]; cnt[i] = sum; sum += c;						\
+			}															\
+			for (i = 0; i < n; ++i)										\
+				dst[cnt[(__xv_radix_key_##name(src[i]) >> shift) & 0xff]++] = src[i]; \
+			t = src; src = dst; dst = t;								\
+		}																\
+		if (src != a) memcpy(a, src, sizeof(type) * n);					\
+		xfree(buf);														\
+		return 0;														\
+	}
+
+/* Convenience wrappers operating on xvecs. */
+
+#define xv_sort(name, v) xv_sort_##name((v).a, (v).n)
+#define xv_radix_sort(name, v) xv_radix_sort_##name((v).a, (v).n)
+#define xv_lower_bound(name, v, key) xv_lower_bound_##name((v).a, (v).n, key)
+#define xv_upper_bound(name, v, key) xv_upper_bound_##name((v).a, (v).n, key)
+#define xv_bsearch(name, v, key) xv_bsearch_##name((v).a, (v).n, key)
+#define xv_filter(name, v, pred, ctx) ((v).n = xv_filter_##name((v).a, (v).n, pred, ctx))
+#define xv_unique(name, v) ((v).n = xv_unique_##name((v).a, (v).n))
+
+#endif /* XLIB_XALGO_H_ */
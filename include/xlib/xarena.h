@@ -0,0 +1,168 @@
+/*
+ * @file      xarena.h
+ * @brief     Region (arena) allocator with bulk reset.
+ * @copyright Copyright (C) 2020 Xevo Inc. All Rights Reserved.
+ *
+ * An arena allocates by bumping a pointer through large chunks and frees
+ * everything at once with xarena_reset, xarena_rewind or xarena_destroy.
+ *
+ * xvec and xhash can be bound to an arena: define XLIB_ALLOC_ARENA before
+ * including any xlib header, and the allocation macros of alloc.h route
+ * through the arena bound to the calling thread (or libc when none is):
+ *
+ *     #define XLIB_ALLOC_ARENA
+ *     #include <xlib/xvec.h>
+ *
+ *     xarena req;
+ *     xarena_init(&req, 0);
+ *     xarena *prev = xarena_bind(&req);
+ *     ... build xvecs and xhash tables ...
+ *     xarena_bind(prev);
+ *     xarena_destroy(&req); // releases every container at once
+ */
+
+#ifndef XLIB_XARENA_H_
+#define XLIB_XARENA_H_
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Alignment used when none is given. */
+#define XARENA_ALIGN alignof(max_align_t)
+
+typedef struct xarena_chunk xarena_chunk;
+
+typedef struct xarena {
+    /* Most recent chunk; older chunks are linked from it. */
+    xarena_chunk *chunk;
+    char *ptr;
+    char *end;
+    /* Size of the next chunk to allocate. */
+    size_t chunk_size;
+    /* Most recent allocation, which can be grown or freed in place. */
+    void *last;
+} xarena;
+
+/* A position in an arena to rewind to. */
+typedef struct xarena_mark {
+    xarena_chunk *chunk;
+    char *ptr;
+} xarena_mark;
+
+/**
+ * Initialize an arena. No memory is allocated until the first allocation.
+ *
+ * @param a an arena
+ * @param chunk_size size of the first chunk, or 0 for a default; later chunks
+ *        double in size
+ */
+void xarena_init(xarena *a, size_t chunk_size);
+
+/**
+ * Free all the memory of an arena.
+ *
+ * @param a an arena
+ */
+void xarena_destroy(xarena *a);
+
+/**
+ * Free every allocation at once, keeping the most recent chunk for reuse.
+ *
+ * @param a an arena
+ */
+void xarena_reset(xarena *a);
+
+/**
+ * Get the current position of an arena.
+ *
+ * @param a an arena
+ * @return a mark that can be passed to xarena_rewind
+ */
+xarena_mark xarena_get_mark(const xarena *a);
+
+/**
+ * Free every allocation made since a mark was taken.
+ *
+ * @param a an arena
+ * @param mark a mark taken from this arena, not older than the last reset
+ */
+void xarena_rewind(xarena *a, xarena_mark mark);
+
+void *_xarena_alloc_slow(xarena *a, size_t size, size_t align);
+
+/**
+ * Allocate memory with the given alignment.
+ *
+ * @param a an arena
+ * @param size the number of bytes
+ * @param align a power of two
+ * @return the memory, or NULL on allocation failure
+ */
+static inline __attribute__ ((__unused__))
+void *xarena_alloc_align(xarena *a, size_t size, size_t align)
+{
+    uintptr_t p = ((uintptr_t) a->ptr + align - 1) & ~(uintptr_t) (align - 1);
+
+    if (a->ptr != NULL && p <= (uintptr_t) a->end && size <= (uintptr_t) a->end - p) {
+        a->ptr = (char *) (p + size);
+        a->last = (void *) p;
+        return (void *) p;
+    }
+
+    return _xarena_alloc_slow(a, size, align);
+}
+
+/**
+ * Allocate memory aligned for any type.
+ *
+ * @param a an arena
+ * @param size the number of bytes
+ * @return the memory, or NULL on allocation failure
+ */
+static inline __attribute__ ((__unused__))
+void *xarena_alloc(xarena *a, size_t size)
+{
+    return xarena_alloc_align(a, size, XARENA_ALIGN);
+}
+
+/**
+ * Bind an arena to the calling thread, for use by the alloc.h macros when
+ * XLIB_ALLOC_ARENA is defined.
+ *
+ * @param a an arena, or NULL to use libc again
+ * @return the previously bound arena, or NULL
+ */
+xarena *xarena_bind(xarena *a);
+
+/**
+ * Get the arena bound to the calling thread.
+ *
+ * @return the bound arena, or NULL
+ */
+xarena *xarena_bound(void);
+
+/*
+ * malloc-compatible functions using the bound arena, or libc when none is
+ * bound. Each allocation records where it comes from, so containers can be
+ * grown and destroyed whatever arena is bound at the time: libc memory goes
+ * back to libc, and arena memory is reallocated within its own arena. Freeing
+ * arena memory is a no-op, except for the most recent allocation of its arena,
+ * which is given back. Containers must not outlive the reset, rewind or
+ * destruction of their arena, and these functions only accept memory they
+ * handed out.
+ */
+void *xarena_bound_malloc(size_t size);
+void *xarena_bound_calloc(size_t n, size_t size);
+void *xarena_bound_realloc(void *p, size_t size);
+void xarena_bound_free(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XLIB_XARENA_H_ */
@@ -23,6 +23,23 @@
  *            DEFINE_DOUBLE(k,nm,f,fl): floating point double
  *            short name,long name, backing variable, flags
  *
+ *            DEFINE_INT64(k,nm,f,fl): int64_t
+ *            short name,long name, backing variable, flags
+ *
+ *            DEFINE_SIZE(k,nm,f,fl) : size_t, with an optional
+ *            k/M/G/T/P suffix (powers of 1024, "KiB" and "KB" also
+ *            accepted)
+ *            short name,long name, backing variable, flags
+ *
+ *            DEFINE_DURATION(k,nm,f,fl): uint64_t nanoseconds, from
+ *            a sequence of number/unit pairs such as "1h30m" (units
+ *            ns, us, ms, s, m, h, d) or a plain number of seconds
+ *            short name,long name, backing variable, flags
+ *
+ *            DEFINE_ENUM(k,nm,f,ch,fl): int index into ch, a NULL
+ *            terminated array of the accepted names
+ *            short name,long name, backing variable, names, flags
+ *
  *            DEFINE_STRING(k,nm,f,sz,fl):null terminated string
  *            key,long name, backing variable,sizeof of it,flags
  *
@@ -31,8 +48,10 @@
  *            Command line should conform to GNU syntax rules
  *            with either short or long names for options.
  *
- *            Positional arguments, up to the MAX value are
- *            placed into an array of strings upton return
+ *            Positional arguments are placed into a growable
+ *            array of strings upon return (see xargparse_npos and
+ *            xargparse_pos), or handed one by one to a callback
+ *            (see xargparse_set_pos_callback)
  *
  * @author    Vlad Sadovsky <vsadovsky at xevo.com>
  * @copyright Copyright (C) 2017 Xevo Inc. All Rights Reserved.
@@ -49,6 +68,9 @@ extern "C"
 #include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* Entry flags are argp option flags, e.g. OPTION_ARG_OPTIONAL. */
 #include <argp.h>
 
 #ifndef XARG_DEF_PROGRAM_VERSION
@@ -59,12 +81,6 @@ extern "C"
 #define XARG_DEF_MAIL_ADDRESS "<foo@bar.org>"
 #endif
 
-/* Max number of positional arguments. */
-#define XARG_MAX_POS_ARGS 25
-
-extern const char *argp_program_version;
-extern const char *argp_program_bug_address;
-
 /* Externally visible definitions */
 
 /* Allowed types of optional arguments */
@@ -74,16 +90,26 @@ typedef enum _xargparse_type
     XARGPARSE_TYPE_BOOL,
     XARGPARSE_TYPE_INT,
     XARGPARSE_TYPE_UINT,
-    XARGPARSE_TYPE_STRING
+    XARGPARSE_TYPE_STRING,
+    XARGPARSE_TYPE_DOUBLE,
+    XARGPARSE_TYPE_INT64,
+    XARGPARSE_TYPE_SIZE,
+    XARGPARSE_TYPE_DURATION,
+    XARGPARSE_TYPE_ENUM
 } xargparse_type;
 
 /* Validation callback per field */
 struct xargparse;
 struct xargparse_entry;
+struct xargparse_index;
+struct xargparse_commands;
 
 typedef int xargparse_cb(struct xargparse *self,
                          const struct xargparse_entry *entry);
 
+/* Positional argument callback, see xargparse_set_pos_callback. */
+typedef int xargparse_pos_cb(struct xargparse *self, const char *arg, void *ctx);
+
 /**
  * xargparse entry format
  * type - _END indicates the last entry
@@ -93,6 +119,7 @@ typedef int xargparse_cb(struct xargparse *self,
  * default - pointer to the default value
  * callback - called when matching entry is parsed
  * context - context for the callback
+ * choices - accepted names of an enum, NULL terminated
  */
 typedef struct xargparse_entry
 {
@@ -104,40 +131,212 @@ typedef struct xargparse_entry
     char *format;
     unsigned int format_len;
     unsigned int flags;
+    const char *const *choices;
 } xargparse_entry;
 
-/* Parsing context */
-typedef struct xargparse
-{
-    /* Provided by the caller */
-    const xargparse_entry *arguments;
-    unsigned int ent_count;
-    /* Internal */
-    /* Positional arguments */
-    unsigned int max_pos_args, min_pos_args;
-    unsigned int npos_args;
-    char *pos_args[XARG_MAX_POS_ARGS];
-    /* Standard fields */
-    bool verbose;
-} xargparse;
+/* Parsing context, created by xargparse_new. */
+typedef struct xargparse xargparse;
 
 
 /* Entry definitions macros  */
-#define DEFINE_END()              {XARGPARSE_TYPE_END, '\0', NULL, NULL,0, NULL,0,0}
-#define DEFINE_BOOL(k,nm,f,fl)    {XARGPARSE_TYPE_BOOL,k,nm,&f,sizeof(bool), "%1d",4,fl}
-#define DEFINE_UINT(k,nm,f,fl)    {XARGPARSE_TYPE_UINT,k,nm,&f,sizeof(uint),"%4d",4,fl}
-#define DEFINE_INT(k,nm,f,fl)     {XARGPARSE_TYPE_INT,k,nm,&f,sizeof(uint),"%4d",4,fl}
-#define DEFINE_DOUBLE(k,nm,f,fl)  {XARGPARSE_TYPE_DOUBLE,k,nm,&f,sizeof(double),"%8.8f",6,fl}
-#define DEFINE_STRING(k,nm,f,sz,fl) {XARGPARSE_TYPE_STRING,k,nm,f,sz,"%s",2, fl}
+#define DEFINE_END()              {XARGPARSE_TYPE_END, '\0', NULL, NULL,0, NULL,0,0,NULL}
+#define DEFINE_BOOL(k,nm,f,fl)    {XARGPARSE_TYPE_BOOL,k,nm,&f,sizeof(bool), "%1d",4,fl,NULL}
+#define DEFINE_UINT(k,nm,f,fl)    {XARGPARSE_TYPE_UINT,k,nm,&f,sizeof(unsigned int),"%4d",4,fl,NULL}
+#define DEFINE_INT(k,nm,f,fl)     {XARGPARSE_TYPE_INT,k,nm,&f,sizeof(int),"%4d",4,fl,NULL}
+#define DEFINE_DOUBLE(k,nm,f,fl)  {XARGPARSE_TYPE_DOUBLE,k,nm,&f,sizeof(double),"%8.8f",6,fl,NULL}
+#define DEFINE_STRING(k,nm,f,sz,fl) {XARGPARSE_TYPE_STRING,k,nm,f,sz,"%s",2,fl,NULL}
+#define DEFINE_INT64(k,nm,f,fl)   {XARGPARSE_TYPE_INT64,k,nm,&f,sizeof(int64_t),NULL,0,fl,NULL}
+#define DEFINE_SIZE(k,nm,f,fl)    {XARGPARSE_TYPE_SIZE,k,nm,&f,sizeof(size_t),NULL,0,fl,NULL}
+#define DEFINE_DURATION(k,nm,f,fl) {XARGPARSE_TYPE_DURATION,k,nm,&f,sizeof(uint64_t),NULL,0,fl,NULL}
+#define DEFINE_ENUM(k,nm,f,ch,fl) {XARGPARSE_TYPE_ENUM,k,nm,&f,sizeof(int),NULL,0,fl,ch}
 
 typedef int xargparse_err;
 
-/* API */
-xargparse_err xargparse_init(xargparse *self, xargparse_entry *entries,
-                             const char *prg_version, const char *bug_addr,
-                             const char *prg_doc, const char *args_doc);
+/*
+ * API
+ *
+ * All parser state lives in the xargparse instance: the argp option table is
+ * built once by xargparse_new and reused by every xargparse_parse, and the
+ * version and bug address are kept per instance rather than in argp's global
+ * variables. Different instances can therefore parse concurrently from
+ * different threads, as long as their entries point to different variables.
+ *
+ * Command lines made only of known options and positional arguments are
+ * parsed without argp, with the same result. Setting XARGPARSE_ARGP_ONLY in
+ * the environment makes every parse go through argp.
+ */
+
+/* Create a parser; returns NULL on allocation failure. */
+xargparse *xargparse_new(const xargparse_entry *entries,
+                         const char *prg_version, const char *bug_addr,
+                         const char *prg_doc, const char *args_doc);
 xargparse_err xargparse_parse(xargparse *self, int argc, char **argv);
-xargparse_err xargparse_destroy(xargparse *self);
+void xargparse_free(xargparse *self);
+
+/* Whether the last -v or -q given, if any, was -v. */
+bool xargparse_verbose(const xargparse *self);
+
+/*
+ * Subcommands
+ *
+ * A parser with commands parses "prog [global options] COMMAND [options]
+ * [args]": its own entries up to the first positional argument, which names
+ * the command, and the rest with the entries of that command. Only the
+ * selected command gets a parser, built on first use and kept for later
+ * parses, so the cost of a parse does not grow with the number of commands.
+ * The positional arguments are those of the command parser, which takes the
+ * positional callback and response file setting of the main parser at each
+ * parse. The command part of argv is parsed from a copy and left as is.
+ */
+
+/**
+ * Register a subcommand. Registration only records the command; the entries
+ * and strings must stay valid as long as the parser.
+ *
+ * @param self a parser
+ * @param name the command word
+ * @param entries the options of the command
+ * @param doc a description, listed in --help and used as the command doc
+ * @param args_doc the positional arguments of the command, or NULL
+ * @return 0, EEXIST if the name is taken, or ENOMEM
+ */
+xargparse_err xargparse_add_command(xargparse *self, const char *name,
+                                    const xargparse_entry *entries,
+                                    const char *doc, const char *args_doc);
+
+/**
+ * Get the command selected by the last parse. A command line without command
+ * word parses successfully and selects none; an unknown command word is an
+ * error.
+ *
+ * @param self a parser
+ * @return the command name, or NULL
+ */
+const char *xargparse_command_name(const xargparse *self);
+
+/**
+ * Get the parser of the command selected by the last parse, holding its
+ * positional arguments.
+ *
+ * @param self a parser
+ * @return the parser, or NULL if no command was selected
+ */
+xargparse *xargparse_command_parser(const xargparse *self);
+
+/*
+ * Configuration layering
+ *
+ * Options can also be set from a file and from the environment, using the
+ * same entries. Each source overrides the ones applied before it, so calling
+ *
+ *     xa = xargparse_new(entries, ...);
+ *     xargparse_load_file(xa, "/etc/app.conf");
+ *     xargparse_load_env(xa, "APP");
+ *     xargparse_parse(xa, argc, argv);
+ *
+ * gives the precedence defaults < file < environment < command line, the
+ * defaults being the initial values of the backing variables.
+ */
+
+/**
+ * Set an option from its long name and value, as if given on the command line.
+ *
+ * @param self a parser
+ * @param name the long name of the option
+ * @param value its value
+ * @return 0, ENOENT if no entry has that name, or an error of the value
+ *         parsers below
+ */
+xargparse_err xargparse_set(xargparse *self, const char *name, const char *value);
+
+/**
+ * Set options from a configuration file of "name = value" lines, parsed in a
+ * single pass over a private mapping of the file. Lines starting with '#' or
+ * ';' are comments. A "[section]" line prefixes the names that follow with
+ * "section-". Blanks around names and values are ignored, and a value may be
+ * enclosed in double or single quotes. Each bad line is reported on stderr as
+ * "path:line: reason" and the others are still applied.
+ *
+ * @param self a parser
+ * @param path the file
+ * @return 0, the errno of opening or reading the file, or the error of the
+ *         first bad line (EINVAL for a malformed line)
+ */
+xargparse_err xargparse_load_file(xargparse *self, const char *path);
+
+/**
+ * Set options from the environment variables named PREFIX_NAME, where NAME is
+ * the long name in upper case with '-' written as '_' (e.g. APP_LOG_LEVEL for
+ * --log-level). Variables matching no entry are ignored, since the prefix may
+ * be shared with other programs; bad values are reported on stderr.
+ *
+ * @param self a parser
+ * @param prefix the prefix, without the trailing '_'
+ * @return 0 or the error of the first bad value
+ */
+xargparse_err xargparse_load_env(xargparse *self, const char *prefix);
+
+/*
+ * Positional arguments of the last parse. In callback mode nothing is stored
+ * and xargparse_pos returns NULL, but xargparse_npos still counts them.
+ */
+unsigned int xargparse_npos(const xargparse *self);
+const char *xargparse_pos(const xargparse *self, unsigned int i);
+
+/**
+ * Set how many positional arguments a command line may have. By default any
+ * number is accepted; too few or too many are errors of xargparse_parse.
+ *
+ * @param self a parser
+ * @param min the minimum number
+ * @param max the maximum number, or UINT_MAX for no maximum
+ */
+void xargparse_set_pos_limits(xargparse *self, unsigned int min, unsigned int max);
+
+/**
+ * Hand positional arguments to a callback as they are parsed instead of
+ * storing them, e.g. to process thousands of input files without keeping
+ * them. Options given after an argument on the command line may not be set
+ * yet when it is handed out. The string is only valid during the call when
+ * it comes from a response file.
+ *
+ * @param self a parser
+ * @param cb the callback, or NULL to store the arguments again; a non-zero
+ *        return stops the parse and is returned by xargparse_parse
+ * @param ctx passed to the callback
+ */
+void xargparse_set_pos_callback(xargparse *self, xargparse_pos_cb *cb, void *ctx);
+
+/**
+ * Replace positional arguments of the form @file by the lines of file, one
+ * argument per non-empty line (not split on blanks, and not expanded again).
+ * Disabled by default.
+ *
+ * @param self a parser
+ * @param enable whether to expand response files
+ */
+void xargparse_set_response_files(xargparse *self, bool enable);
+
+/*
+ * Value parsers used for the typed entries, usable on their own.
+ *
+ * The whole string must be a value: no leading or trailing blanks or other
+ * characters. Integers are decimal or 0x hexadecimal, with an optional sign
+ * ('+' only for unsigned types). Doubles use '.' whatever the locale.
+ * Nothing is allocated. On error *out is left untouched.
+ *
+ * Return 0 on success, EINVAL if the string is not a value of the type, or
+ * ERANGE if it is but does not fit.
+ */
+int xargparse_parse_bool(const char *s, bool *out);
+int xargparse_parse_int(const char *s, int *out);
+int xargparse_parse_uint(const char *s, unsigned int *out);
+int xargparse_parse_int64(const char *s, int64_t *out);
+int xargparse_parse_double(const char *s, double *out);
+int xargparse_parse_size(const char *s, size_t *out);
+int xargparse_parse_duration(const char *s, uint64_t *out_ns);
+/* Index of s in choices, a NULL terminated array. */
+int xargparse_parse_enum(const char *s, const char *const *choices, int *out);
 
 #ifdef __cplusplus
 }
@@ -17,71 +17,241 @@
 
 #include <xlib/xlog.h>
 
-static __attribute__ ((__unused__))
-void _xassert_log_base(
-    bool print_loc,
-    const char *expr,
-    const char *file,
-    int line,
-    const char *func)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Everything about an assertion site that is known at compile time. Each site
+ * has a static descriptor, so a failing check passes a single pointer to the
+ * failure handler instead of materializing four arguments in the hot path.
+ */
+typedef struct {
+    const char *expr;
+    const char *file;
+    int line;
+    const char *func;
+} XassertSite;
+
+/*
+ * Failure handlers. They are cold, out of line and do not return, so each
+ * assertion only costs a compare and a jump to a call placed away from the hot
+ * code.
+ */
+__attribute__ ((cold, noinline, noreturn))
+void _xassert_fail(const XassertSite *site);
+
+__attribute__ ((cold, noinline, noreturn))
+void _xassert_fail_fmt(const XassertSite *site, const char *fmt, ...);
+
+__attribute__ ((cold, noinline, noreturn))
+void _xassert_fail_extra(const XassertSite *site, const char *extra);
+
+/*
+ * An operand of a comparison assertion, captured by value with its kind, so
+ * that the failure handler can format it without printf or the heap: it must
+ * work from signal handlers and when memory is exhausted or corrupted.
+ */
+typedef enum {
+    XASSERT_OPERAND_INT,
+    XASSERT_OPERAND_UINT,
+    XASSERT_OPERAND_CHAR,
+    XASSERT_OPERAND_FLOAT,
+    XASSERT_OPERAND_PTR,
+    /* A NUL-terminated string, by pointer. */
+    XASSERT_OPERAND_STR
+} XassertOperandKind;
+
+typedef struct {
+    XassertOperandKind kind;
+    union {
+        long long i;
+        unsigned long long u;
+        double f;
+        uintptr_t p;
+        const char *s;
+    } v;
+} XassertOperand;
+
+__attribute__ ((cold, noinline, noreturn))
+void _xassert_fail_ops(const XassertSite *site, XassertOperand x, XassertOperand y);
+
+/**
+ * Format an operand into a buffer without allocating: integers in decimal,
+ * characters and strings as themselves, pointers in hex and floating-point
+ * values (as doubles) with six decimals, or in exponent form when large.
+ *
+ * @param op an operand
+ * @param buf a buffer
+ * @param size the size of buf; 64 bytes are enough for any operand but
+ *        strings, which are truncated to fit
+ * @return the length of the text, which is always NUL-terminated
+ */
+size_t xassert_format_operand(const XassertOperand *op, char *buf, size_t size);
+
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_int(long long v)
 {
-    _xlog(
-        XLOG_CRIT,
-        print_loc,
-        file,
-        line,
-        func,
-        "Assert: failed expression (%s)",
-        expr);
+    XassertOperand op;
+
+    op.kind = XASSERT_OPERAND_INT;
+    op.v.i = v;
+
+    return op;
 }
 
-static __attribute__ ((__unused__))
-void _xassert_log_extra(
-    const char *expr,
-    const char *file,
-    int line,
-    const char *func,
-    const char *extra)
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_uint(unsigned long long v)
 {
-    _xassert_log_base(true, expr, file, line, func);
-    _xlog(XLOG_CRIT, false, file, line, func, extra);
+    XassertOperand op;
+
+    op.kind = XASSERT_OPERAND_UINT;
+    op.v.u = v;
+
+    return op;
 }
 
-static __attribute__ ((__unused__))
-void _xassert_log_fmt(
-    const char *expr,
-    const char *file,
-    int line,
-    const char *func,
-    const char *fmt,
-    ...)
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_char(char v)
 {
-    va_list args;
+    XassertOperand op;
 
-    _xassert_log_base(true, expr, file, line, func);
+    op.kind = XASSERT_OPERAND_CHAR;
+    op.v.i = v;
 
-    va_start(args, fmt);
-    _xlog_va(XLOG_CRIT, false, file, line, func, fmt, args);
-    va_end(args);
+    return op;
 }
 
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_float(double v)
+{
+    XassertOperand op;
+
+    op.kind = XASSERT_OPERAND_FLOAT;
+    op.v.f = v;
+
+    return op;
+}
+
+/*
+ * Pointers are captured as integers: function pointers do not convert to
+ * void pointers, but both convert to uintptr_t.
+ */
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_addr(uintptr_t v)
+{
+    XassertOperand op;
+
+    op.kind = XASSERT_OPERAND_PTR;
+    op.v.p = v;
+
+    return op;
+}
+
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_ptr(const volatile void *v)
+{
+    return _xassert_op_addr((uintptr_t) v);
+}
+
+static inline __attribute__ ((__unused__))
+XassertOperand _xassert_op_str(const char *v)
+{
+    XassertOperand op;
+
+    op.kind = XASSERT_OPERAND_STR;
+    op.v.s = v;
+
+    return op;
+}
+
+/**
+ * Set a file to write a context report to when an assertion fails or, with
+ * xassert_install_crash_handlers, when the process crashes. The report holds
+ * the failure, the process and thread ids, a backtrace, the memory map (to
+ * resolve addresses offline) and the contents of the xlog flight recorder, if
+ * open. In any case, failures write a backtrace to stderr and flush xlog.
+ *
+ * @param path a file path, copied; NULL to write no report
+ * @return 0 on success, or ENAMETOOLONG
+ */
+int xassert_set_crash_file(const char *path);
+
+/**
+ * Report fatal signals (SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT) the way
+ * assertion failures are reported, then let the previous handler or default
+ * action run. The handlers run on the alternate stack of the crashing thread,
+ * so stack overflows are reported too in threads that have one: the calling
+ * thread gets one here, other threads with xassert_thread_init.
+ *
+ * @return 0 on success, or an errno value
+ */
+int xassert_install_crash_handlers(void);
+
+/**
+ * Give the calling thread a 64 KiB alternate signal stack, unless it already
+ * has one as large, so that crash handlers can report its stack overflows.
+ * Call it at the start of each thread; the stack is freed when the thread
+ * exits.
+ *
+ * @return 0 on success, or an errno value
+ */
+int xassert_thread_init(void);
+
 #ifdef __cplusplus
+}
+
 #include <sstream>
+#include <type_traits>
+
+static inline XassertOperand _xassert_op(char v) { return _xassert_op_char(v); }
+static inline XassertOperand _xassert_op(signed char v) { return _xassert_op_int(v); }
+static inline XassertOperand _xassert_op(short v) { return _xassert_op_int(v); }
+static inline XassertOperand _xassert_op(int v) { return _xassert_op_int(v); }
+static inline XassertOperand _xassert_op(long v) { return _xassert_op_int(v); }
+static inline XassertOperand _xassert_op(long long v) { return _xassert_op_int(v); }
+static inline XassertOperand _xassert_op(bool v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(unsigned char v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(unsigned short v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(unsigned int v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(unsigned long v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(unsigned long long v) { return _xassert_op_uint(v); }
+static inline XassertOperand _xassert_op(float v) { return _xassert_op_float(v); }
+static inline XassertOperand _xassert_op(double v) { return _xassert_op_float(v); }
+static inline XassertOperand _xassert_op(long double v) { return _xassert_op_float((double) v); }
+static inline XassertOperand _xassert_op(const volatile void *v) { return _xassert_op_ptr(v); }
+
+template <class R, class... A>
+static inline XassertOperand _xassert_op(R (*v)(A...))
+{
+    return _xassert_op_addr(reinterpret_cast<uintptr_t>(v));
+}
+
+template <class T>
+struct _xassert_is_scalar : std::integral_constant<bool,
+    std::is_arithmetic<T>::value || std::is_pointer<T>::value> {};
 
+/* Built-in types are formatted without allocating. */
 template <class X, class Y>
-static __attribute__ ((__unused__))
-void _xassert_log_formatted_msg_cpp(
-    const X &x,
-    const Y &y,
-    const char *expr,
-    const char *file,
-    int line,
-    const char *func)
+__attribute__ ((cold, noinline, noreturn))
+static typename std::enable_if<
+    _xassert_is_scalar<X>::value && _xassert_is_scalar<Y>::value>::type
+_xassert_fail_cpp(const XassertSite *site, const X &x, const Y &y)
+{
+    _xassert_fail_ops(site, _xassert_op(x), _xassert_op(y));
+}
+
+/* Other types need their operator<<. */
+template <class X, class Y>
+__attribute__ ((cold, noinline, noreturn))
+static typename std::enable_if<
+    !(_xassert_is_scalar<X>::value && _xassert_is_scalar<Y>::value)>::type
+_xassert_fail_cpp(const XassertSite *site, const X &x, const Y &y)
 {
     std::stringstream ss;
 
     ss << "LHS: " << x << "\nRHS: " << y;
-    _xassert_log_extra(expr, file, line, func, ss.str().c_str());
+    _xassert_fail_extra(site, ss.str().c_str());
 }
 #endif /* __cplusplus */
 
@@ -99,27 +269,21 @@ void _xassert_log_formatted_msg_cpp(
 #define _XASSERT_UNLIKELY(x) (x)
 #endif
 
-#define _XASSERT_SKELETON(expr, log_code) \
+#define _XASSERT_SKELETON(expr, fail_code) \
     do { \
         int _res = expr; \
         if (_XASSERT_LIKELY(_res)) { \
             /* Empty, but catches accidental assignment (i.e. a=b) in expr. */ \
         } \
         else { \
-            log_code; \
-            abort(); \
-            __builtin_unreachable(); \
+            static const XassertSite _xassert_site = { \
+                #expr, __FILE__, __LINE__, __func__ \
+            }; \
+            fail_code; \
         } \
     } while (0);
 
-#define XASSERT(expr) \
-    _XASSERT_SKELETON(expr, \
-        _xassert_log_base( \
-           true, \
-           #expr, \
-           __FILE__, \
-           __LINE__, \
-           __func__));
+#define XASSERT(expr) _XASSERT_SKELETON(expr, _xassert_fail(&_xassert_site));
 
 #ifndef __cplusplus
 /*
@@ -129,13 +293,7 @@ void _xassert_log_formatted_msg_cpp(
  */
 #define _XASSERT_FMT(expr, fmt, ...) \
     _XASSERT_SKELETON(expr, \
-        _xassert_log_fmt( \
-            #expr, \
-            __FILE__, \
-            __LINE__, \
-            __func__, \
-            "LHS: " fmt "\nRHS: " fmt, \
-            __VA_ARGS__));
+        _xassert_fail_fmt(&_xassert_site, "LHS: " fmt "\nRHS: " fmt, __VA_ARGS__));
 
 #define _XASSERT_OP_FMT(op, fmt, x, y) _XASSERT_FMT((x) op (y), fmt, x, y)
 
@@ -156,184 +314,50 @@ void _xassert_log_formatted_msg_cpp(
 #include <stdatomic.h>
 #include <stdbool.h>
 
-#define _XFMT(x) _Generic((x), \
-    char:                                  "LHS: %c\n" \
-                                           "RHS: %c", \
-    const char:                            "LHS: %c\n" \
-                                           "RHS: %c", \
-    char *:                                "LHS: %c\n" \
-                                           "RHS: %c", \
-    const char *:                          "LHS: %c\n" \
-                                           "RHS: %c", \
-    _Atomic char:                          "LHS: %c\n" \
-                                           "RHS: %c", \
-    _Atomic char *:                        "LHS: %p\n" \
-                                           "RHS: %p", \
-    signed char:                           "LHS: %hhd\n" \
-                                           "RHS: %hhd", \
-    const signed char:                     "LHS: %hhd\n" \
-                                           "RHS: %hhd", \
-    signed char *:                         "LHS: %hhd\n" \
-                                           "RHS: %hhd", \
-    const signed char *:                   "LHS: %hhd\n" \
-                                           "RHS: %hhd", \
-    _Atomic signed char:                   "LHS: %hhd\n" \
-                                           "RHS: %hhd", \
-    _Atomic signed char *:                 "LHS: %p\n" \
-                                           "RHS: %p", \
-    unsigned char:                         "LHS: %hhu\n" \
-                                           "RHS: %hhu", \
-    const unsigned char:                   "LHS: %hhu\n" \
-                                           "RHS: %hhu", \
-    unsigned char *:                       "LHS: %hhu\n" \
-                                           "RHS: %hhu", \
-    const unsigned char *:                 "LHS: %hhu\n" \
-                                           "RHS: %hhu", \
-    _Atomic unsigned char:                 "LHS: %hhu\n" \
-                                           "RHS: %hhu", \
-    _Atomic unsigned char *:               "LHS: %p\n" \
-                                           "RHS: %p", \
-    signed short:                          "LHS: %hd\n" \
-                                           "RHS: %hd", \
-    const signed short:                    "LHS: %hd\n" \
-                                           "RHS: %hd", \
-    signed short *:                        "LHS: %hd\n" \
-                                           "RHS: %hd", \
-    const signed short *:                  "LHS: %hd\n" \
-                                           "RHS: %hd", \
-    _Atomic signed short:                  "LHS: %hd\n" \
-                                           "RHS: %hd", \
-    _Atomic signed short *:                "LHS: %p\n" \
-                                           "RHS: %p", \
-    unsigned short:                        "LHS: %hu\n" \
-                                           "RHS: %hu", \
-    const unsigned short:                  "LHS: %hu\n" \
-                                           "RHS: %hu", \
-    unsigned short *:                      "LHS: %hu\n" \
-                                           "RHS: %hu", \
-    const unsigned short *:                "LHS: %hu\n" \
-                                           "RHS: %hu", \
-    _Atomic unsigned short:                "LHS: %hu\n" \
-                                           "RHS: %hu", \
-    _Atomic unsigned short *:              "LHS: %p\n" \
-                                           "RHS: %p", \
-    signed int:                            "LHS: %d\n" \
-                                           "RHS: %d", \
-    const signed int:                      "LHS: %d\n" \
-                                           "RHS: %d", \
-    signed int *:                          "LHS: %d\n" \
-                                           "RHS: %d", \
-    const signed int *:                    "LHS: %d\n" \
-                                           "RHS: %d", \
-    _Atomic signed int:                    "LHS: %d\n" \
-                                           "RHS: %d", \
-    _Atomic signed int *:                  "LHS: %p\n" \
-                                           "RHS: %p", \
-    unsigned int:                          "LHS: %u\n" \
-                                           "RHS: %u", \
-    const unsigned int:                    "LHS: %u\n" \
-                                           "RHS: %u", \
-    unsigned int *:                        "LHS: %u\n" \
-                                           "RHS: %u", \
-    const unsigned int *:                  "LHS: %u\n" \
-                                           "RHS: %u", \
-    _Atomic unsigned int:                  "LHS: %u\n" \
-                                           "RHS: %u", \
-    _Atomic unsigned int *:                "LHS: %p\n" \
-                                           "RHS: %p", \
-    long int:                              "LHS: %ld\n" \
-                                           "RHS: %ld", \
-    const long int:                        "LHS: %ld\n" \
-                                           "RHS: %ld", \
-    long int *:                            "LHS: %ld\n" \
-                                           "RHS: %ld", \
-    const long int *:                      "LHS: %ld\n" \
-                                           "RHS: %ld", \
-    _Atomic long int:                      "LHS: %ld\n" \
-                                           "RHS: %ld", \
-    _Atomic long int *:                    "LHS: %p\n" \
-                                           "RHS: %p", \
-    unsigned long int:                     "LHS: %lu\n" \
-                                           "RHS: %lu", \
-    const unsigned long int:               "LHS: %lu\n" \
-                                           "RHS: %lu", \
-    unsigned long int *:                   "LHS: %lu\n" \
-                                           "RHS: %lu", \
-    const unsigned long int *:             "LHS: %lu\n" \
-                                           "RHS: %lu", \
-    _Atomic unsigned long int:             "LHS: %lu\n" \
-                                           "RHS: %lu", \
-    _Atomic unsigned long int *:           "LHS: %p\n" \
-                                           "RHS: %p", \
-    long long int:                         "LHS: %lld\n" \
-                                           "RHS: %lld", \
-    const long long int:                   "LHS: %lld\n" \
-                                           "RHS: %lld", \
-    long long int *:                       "LHS: %lld\n" \
-                                           "RHS: %lld", \
-    const long long int *:                 "LHS: %lld\n" \
-                                           "RHS: %lld", \
-    _Atomic long long int:                 "LHS: %lld\n" \
-                                           "RHS: %lld", \
-    _Atomic long long int *:               "LHS: %p\n" \
-                                           "RHS: %p", \
-    unsigned long long int:                "LHS: %llu\n" \
-                                           "RHS: %llu", \
-    const unsigned long long int:          "LHS: %llu\n" \
-                                           "RHS: %llu", \
-    unsigned long long int *:              "LHS: %llu\n" \
-                                           "RHS: %llu", \
-    const unsigned long long int *:        "LHS: %llu\n" \
-                                           "RHS: %llu", \
-    _Atomic unsigned long long int:        "LHS: %llu\n" \
-                                           "RHS: %llu", \
-    _Atomic unsigned long long int *:      "LHS: %p\n" \
-                                           "RHS: %p", \
-    float:                                 "LHS: %f\n" \
-                                           "RHS: %f", \
-    const float:                           "LHS: %f\n" \
-                                           "RHS: %f", \
-    float *:                               "LHS: %f\n" \
-                                           "RHS: %f", \
-    const float *:                         "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic float:                         "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic float *:                       "LHS: %p\n" \
-                                           "RHS: %p", \
-    double:                                "LHS: %f\n" \
-                                           "RHS: %f", \
-    const double:                          "LHS: %f\n" \
-                                           "RHS: %f", \
-    double *:                              "LHS: %f\n" \
-                                           "RHS: %f", \
-    const double *:                        "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic double:                        "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic double *:                      "LHS: %p\n" \
-                                           "RHS: %p", \
-    long double:                           "LHS: %f\n" \
-                                           "RHS: %f", \
-    const long double:                     "LHS: %f\n" \
-                                           "RHS: %f", \
-    long double *:                         "LHS: %f\n" \
-                                           "RHS: %f", \
-    const long double *:                   "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic long double:                   "LHS: %f\n" \
-                                           "RHS: %f", \
-    _Atomic long double *:                 "LHS: %p\n" \
-                                           "RHS: %p", \
-    const void *:                          "LHS: %p\n" \
-                                           "RHS: %p", \
-    void *:                                "LHS: %p\n" \
-                                           "RHS: %p" \
-    )
+/*
+ * Capture an operand by value with its kind. Qualifiers are dropped by lvalue
+ * conversion, and anything that is not an arithmetic type is a pointer, object
+ * or function, passed as an integer.
+ */
+#define _XASSERT_OPERAND(x) _Generic((x), \
+    char:                                  _xassert_op_char, \
+    signed char:                           _xassert_op_int, \
+    signed short:                          _xassert_op_int, \
+    signed int:                            _xassert_op_int, \
+    long int:                              _xassert_op_int, \
+    long long int:                         _xassert_op_int, \
+    _Bool:                                 _xassert_op_uint, \
+    unsigned char:                         _xassert_op_uint, \
+    unsigned short:                        _xassert_op_uint, \
+    unsigned int:                          _xassert_op_uint, \
+    unsigned long int:                     _xassert_op_uint, \
+    unsigned long long int:                _xassert_op_uint, \
+    float:                                 _xassert_op_float, \
+    double:                                _xassert_op_float, \
+    long double:                           _xassert_op_float, \
+    default:                               _xassert_op_addr \
+    )(_Generic((x), \
+    char:                                  (x), \
+    signed char:                           (x), \
+    signed short:                          (x), \
+    signed int:                            (x), \
+    long int:                              (x), \
+    long long int:                         (x), \
+    _Bool:                                 (x), \
+    unsigned char:                         (x), \
+    unsigned short:                        (x), \
+    unsigned int:                          (x), \
+    unsigned long int:                     (x), \
+    unsigned long long int:                (x), \
+    float:                                 (x), \
+    double:                                (x), \
+    long double:                           (x), \
+    default:                               (uintptr_t) (x) \
+    ))
 
 #define _XASSERT_GENERIC(expr, x, y) \
     _XASSERT_SKELETON(expr, \
-        _xassert_log_fmt(#expr, __FILE__, __LINE__, __func__, _XFMT(x), x, y));
+        _xassert_fail_ops(&_xassert_site, _XASSERT_OPERAND(x), _XASSERT_OPERAND(y)));
 
 #define _XASSERT_OP_GENERIC(op, x, y) _XASSERT_GENERIC((x) op (y), x, y)
 
@@ -348,14 +372,8 @@ void _xassert_log_formatted_msg_cpp(
 
 #ifdef __cplusplus
 /* For C++, we implement these using a template function. */
-#define _XASSERT_CXX(expr, x, y) _XASSERT_SKELETON(expr, \
-    _xassert_log_formatted_msg_cpp(\
-        x, \
-        y, \
-        #expr, \
-        __FILE__, \
-        __LINE__, \
-        __func__))
+#define _XASSERT_CXX(expr, x, y) \
+    _XASSERT_SKELETON(expr, _xassert_fail_cpp(&_xassert_site, x, y))
 
 #define _XASSERT_OP_CXX(op, x, y) _XASSERT_CXX((x) op (y), x, y)
 
@@ -386,20 +404,108 @@ void _xassert_log_formatted_msg_cpp(
     __builtin_unreachable(); \
     } while (0);
 
+/* These format their operands without printf, as the comparisons do. */
+#define _XASSERT_FLOATS(expr, x, y) \
+    _XASSERT_SKELETON(expr, \
+        _xassert_fail_ops(&_xassert_site, _xassert_op_float(x), _xassert_op_float(y)));
+
 #define XASSERT_FLTEQ_THRESH(x, y, thresh) \
-    _XASSERT_FMT(fabsf((x) - (y)) < (thresh), "%f", x, y)
+    _XASSERT_FLOATS(fabsf((x) - (y)) < (thresh), x, y)
 #define XASSERT_DBLEQ_THRESH(x, y, thresh) \
-    _XASSERT_FMT(fabs((x) - (y)) < (thresh), "%f", x, y)
+    _XASSERT_FLOATS(fabs((x) - (y)) < (thresh), x, y)
 #define XASSERT_LDBLEQ_THRESH(x, y, thresh) \
-    _XASSERT_FMT(fabsl((x) - (y)) < (thresh), "%f", x, y)
+    _XASSERT_FLOATS(fabsl((x) - (y)) < (thresh), (double) (x), (double) (y))
 
 #define XASSERT_FLTEQ(x, y) XASSERT_FLTEQ_THRESH(x, y, DBL_EPSILON)
 #define XASSERT_DBLEQ(x, y) XASSERT_DBLEQ_THRESH(x, y, DBL_EPSILON)
 #define XASSERT_LDBLEQ(x, y) XASSERT_LDBLEQ_THRESH(x, y, DBL_EPSILON)
 
-#define XASSERT_STREQ(s, t) _XASSERT_FMT(strcmp(s, t) == 0, "%s", s, t)
+#define XASSERT_STREQ(s, t) \
+    _XASSERT_SKELETON(strcmp(s, t) == 0, \
+        _xassert_fail_ops(&_xassert_site, _xassert_op_str(s), _xassert_op_str(t)));
 
+/* Error strings are still formatted with printf, so this one is C only. */
 #define _XASSERT_ERRCODE(x, y, strerror_func) \
     _XASSERT_FMT((x) == (y), "%d (%s)", x, strerror_func(x), y, strerror_func(y))
 
+/*
+ * Assertion tiers. XASSERT* checks are always compiled in. XASSERT_DEBUG*
+ * checks, meant for invariants too costly for hot release paths, are compiled
+ * in when XASSERT_LEVEL is at least XASSERT_LEVEL_DEBUG, the default unless
+ * NDEBUG is defined. XASSERT_PARANOID* checks, e.g. full consistency walks of a
+ * data structure, need XASSERT_LEVEL_PARANOID.
+ *
+ * Disabled checks cost nothing: the expression is type-checked but never
+ * evaluated. Define XASSERT_ASSUME to instead let the compiler assume that
+ * disabled expressions hold, which can help optimization but makes a false
+ * assumption undefined behavior. With GCC, which has no __builtin_assume,
+ * expressions with side effects are then still evaluated.
+ */
+#define XASSERT_LEVEL_ALWAYS 0
+#define XASSERT_LEVEL_DEBUG 1
+#define XASSERT_LEVEL_PARANOID 2
+
+#ifndef XASSERT_LEVEL
+#ifdef NDEBUG
+#define XASSERT_LEVEL XASSERT_LEVEL_ALWAYS
+#else
+#define XASSERT_LEVEL XASSERT_LEVEL_DEBUG
+#endif
+#endif
+
+#if defined(XASSERT_ASSUME) && defined(__clang__)
+#define _XASSERT_DISABLED(expr) \
+    do { \
+        __builtin_assume(expr); \
+    } while (0);
+#elif defined(XASSERT_ASSUME)
+#define _XASSERT_DISABLED(expr) \
+    do { \
+        if (!(expr)) { \
+            __builtin_unreachable(); \
+        } \
+    } while (0);
+#else
+#define _XASSERT_DISABLED(expr) \
+    do { \
+        (void) sizeof(!(expr)); \
+    } while (0);
+#endif
+
+#if XASSERT_LEVEL >= XASSERT_LEVEL_DEBUG
+#define XASSERT_DEBUG(expr) XASSERT(expr)
+#define XASSERT_DEBUG_LT(x, y) XASSERT_LT(x, y)
+#define XASSERT_DEBUG_LTE(x, y) XASSERT_LTE(x, y)
+#define XASSERT_DEBUG_EQ(x, y) XASSERT_EQ(x, y)
+#define XASSERT_DEBUG_NEQ(x, y) XASSERT_NEQ(x, y)
+#define XASSERT_DEBUG_GT(x, y) XASSERT_GT(x, y)
+#define XASSERT_DEBUG_GTE(x, y) XASSERT_GTE(x, y)
+#else
+#define XASSERT_DEBUG(expr) _XASSERT_DISABLED(expr)
+#define XASSERT_DEBUG_LT(x, y) _XASSERT_DISABLED((x) < (y))
+#define XASSERT_DEBUG_LTE(x, y) _XASSERT_DISABLED((x) <= (y))
+#define XASSERT_DEBUG_EQ(x, y) _XASSERT_DISABLED((x) == (y))
+#define XASSERT_DEBUG_NEQ(x, y) _XASSERT_DISABLED((x) != (y))
+#define XASSERT_DEBUG_GT(x, y) _XASSERT_DISABLED((x) > (y))
+#define XASSERT_DEBUG_GTE(x, y) _XASSERT_DISABLED((x) >= (y))
+#endif
+
+#if XASSERT_LEVEL >= XASSERT_LEVEL_PARANOID
+#define XASSERT_PARANOID(expr) XASSERT(expr)
+#define XASSERT_PARANOID_LT(x, y) XASSERT_LT(x, y)
+#define XASSERT_PARANOID_LTE(x, y) XASSERT_LTE(x, y)
+#define XASSERT_PARANOID_EQ(x, y) XASSERT_EQ(x, y)
+#define XASSERT_PARANOID_NEQ(x, y) XASSERT_NEQ(x, y)
+#define XASSERT_PARANOID_GT(x, y) XASSERT_GT(x, y)
+#define XASSERT_PARANOID_GTE(x, y) XASSERT_GTE(x, y)
+#else
+#define XASSERT_PARANOID(expr) _XASSERT_DISABLED(expr)
+#define XASSERT_PARANOID_LT(x, y) _XASSERT_DISABLED((x) < (y))
+#define XASSERT_PARANOID_LTE(x, y) _XASSERT_DISABLED((x) <= (y))
+#define XASSERT_PARANOID_EQ(x, y) _XASSERT_DISABLED((x) == (y))
+#define XASSERT_PARANOID_NEQ(x, y) _XASSERT_DISABLED((x) != (y))
+#define XASSERT_PARANOID_GT(x, y) _XASSERT_DISABLED((x) > (y))
+#define XASSERT_PARANOID_GTE(x, y) _XASSERT_DISABLED((x) >= (y))
+#endif
+
 #endif /* XLIB_XASSERT_H_ */
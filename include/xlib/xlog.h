@@ -16,7 +16,9 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 /* Forward declarations of logging functionality needed for assertions. */
 typedef enum {
@@ -65,6 +67,19 @@ typedef void (*XlogFunc)(
     const char *fmt,
     va_list args);
 
+/*
+ * The default log function. It writes to stderr (XLOG_WARNING and more urgent)
+ * or stdout, in the format set by xlog_set_log_format.
+ */
+void xlog_default_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
 /**
  * Set the global log priority.
  *
@@ -79,6 +94,62 @@ void xlog_set_log_priority(XlogPriority priority);
  */
 void xlog_set_log_func(XlogFunc func);
 
+/**
+ * Get the global log function.
+ *
+ * @return the log function
+ */
+XlogFunc xlog_get_log_func(void);
+
+/* When a message was logged. */
+typedef struct {
+    /* CLOCK_MONOTONIC, for measuring intervals. */
+    struct timespec mono;
+    /* CLOCK_REALTIME, for display. */
+    struct timespec real;
+} XlogTime;
+
+/**
+ * Get the time of the message being logged by the calling thread. The clocks
+ * are read on the first call for each message only, so log functions and
+ * sinks can all use it instead of reading the clocks, and messages that do not
+ * print a time do not pay for it. Outside of a log function, this is the
+ * current time.
+ *
+ * @return the time, valid until the thread logs its next message or calls
+ *         xlog_time outside of a log function
+ */
+const XlogTime *xlog_time(void);
+
+/**
+ * Capture the time with the coarse clocks (CLOCK_*_COARSE, a few milliseconds
+ * of resolution) where available, which are cheaper to read.
+ *
+ * @param coarse whether to use the coarse clocks
+ */
+void xlog_set_coarse_clock(bool coarse);
+
+/* Length of the text written by xlog_time_prefix, without the NUL. */
+#define XLOG_TIME_PREFIX_LEN 26
+
+/**
+ * Format the local date and time of t as "YYYY-MM-DD HH:MM:SS.uuuuuu". The
+ * date and time are formatted only once per second per thread; other calls
+ * copy them and format the microseconds.
+ *
+ * @param t a time, usually xlog_time()
+ * @param buf a buffer of at least XLOG_TIME_PREFIX_LEN + 1 bytes
+ * @return XLOG_TIME_PREFIX_LEN
+ */
+size_t xlog_time_prefix(const XlogTime *t, char *buf);
+
+/*
+ * Start and end a message in the logging entry points: the first xlog_time
+ * call in between reads the clocks, later ones reuse that reading.
+ */
+void _xlog_begin(void);
+void _xlog_end(void);
+
 /**
  * Check if logging is enabled. Useful for skipping code that builds up logging
  * information and thus incurs non-negligible overhead.
@@ -87,6 +158,29 @@ void xlog_set_log_func(XlogFunc func);
  */
 bool xlog_enabled(XlogPriority priority);
 
+/*
+ * Messages less urgent than XLOG_COMPILE_LEVEL are compiled out of the xlog
+ * macros entirely: their arguments are type-checked but never evaluated. Define
+ * it (e.g. -DXLOG_COMPILE_LEVEL=XLOG_INFO) before including this header.
+ */
+#ifndef XLOG_COMPILE_LEVEL
+#define XLOG_COMPILE_LEVEL XLOG_DEBUG
+#endif
+
+/*
+ * The global log priority. Use xlog_set_log_priority to change it. It is read
+ * and written atomically, so it may be changed while other threads log.
+ */
+extern int _xlog_priority;
+
+/*
+ * Inline version of xlog_enabled, used by the xlog macros so that disabled
+ * messages cost a load and a compare, without a call or argument evaluation.
+ */
+#define _xlog_on(priority) \
+    ((priority) <= XLOG_COMPILE_LEVEL && \
+     (int) (priority) <= __atomic_load_n(&_xlog_priority, __ATOMIC_RELAXED))
+
 /**
  * Log a message. If the globally-configured priority is lower than the priority
  * given, nothing will be logged.
@@ -95,22 +189,27 @@ bool xlog_enabled(XlogPriority priority);
  * @param fmt a printf-style formatting message
  * @param ... additional formatting arguments
  */
-#define xlog(priority, fmt, ...) _xlog( \
+#ifndef XLOG_RATE_LIMIT
+#define xlog(priority, fmt, ...) (_xlog_on(priority) ? _xlog( \
     priority, \
     true, \
     __FILE__, \
     __LINE__, \
     __func__, \
     fmt, \
-    __VA_ARGS__)
+    __VA_ARGS__) : (void) 0)
 
-#define xlog_nofmt(priority, fmt) _xlog( \
+#define xlog_nofmt(priority, fmt) (_xlog_on(priority) ? _xlog( \
     priority, \
     true, \
     __FILE__, \
     __LINE__, \
     __func__, \
-    fmt)
+    fmt) : (void) 0)
+#else
+#define xlog(priority, fmt, ...) xlog_rl(priority, fmt, __VA_ARGS__)
+#define xlog_nofmt(priority, fmt) xlog_rl_nofmt(priority, fmt)
+#endif
 
 void _xlog(
     XlogPriority priority,
@@ -128,8 +227,10 @@ void _xlog(
  * @param fmt a printf-style formatting message
  * @param args a var-args va_list
  */
-#define xlog_va(priority, fmt, ...) _xlog_va(priority, true, __FILE__, __LINE__, __func__, fmt, __VA_ARGS__)
-#define xlog_va_nofmt(priority, fmt) _xlog_va(priority, true, __FILE__, __LINE__, __func__, fmt)
+#define xlog_va(priority, fmt, ...) (_xlog_on(priority) ? \
+    _xlog_va(priority, true, __FILE__, __LINE__, __func__, fmt, __VA_ARGS__) : (void) 0)
+#define xlog_va_nofmt(priority, fmt) (_xlog_on(priority) ? \
+    _xlog_va(priority, true, __FILE__, __LINE__, __func__, fmt) : (void) 0)
 
 void _xlog_va(
     XlogPriority priority,
@@ -140,6 +241,568 @@ void _xlog_va(
     const char *fmt,
     va_list args);
 
+/*
+ * Per-call-site rate limiting. Each xlog_rl call site has its own token
+ * bucket, so a site firing in a tight loop is throttled without silencing the
+ * rest of the process. When a throttled site logs again, the number of
+ * messages it dropped is reported first; counts still pending are reported by
+ * xlog_rl_flush, which xlog_flush calls and which runs at exit. Define
+ * XLOG_RATE_LIMIT before including this header to make xlog and xlog_nofmt
+ * rate limited too.
+ *
+ * Under the limit, a rate-limited message costs a coarse clock read and a
+ * compare-and-swap more than a plain one.
+ */
+typedef struct XlogSite {
+    /* Theoretical arrival time of the next message, in nanoseconds. */
+    uint64_t tat;
+    /* Messages dropped since the last one logged. */
+    size_t suppressed;
+    /* Set when the site first drops a message, to report it later. */
+    bool listed;
+    XlogPriority priority;
+    bool print_loc;
+    int line;
+    const char *file;
+    const char *func;
+    struct XlogSite *next;
+} XlogSite;
+
+/**
+ * Set the rate limit of xlog_rl call sites. By default each site may log 100
+ * messages per second, with bursts of up to 100 messages.
+ *
+ * @param rate the number of messages per second each site may log, or 0 to
+ *        disable rate limiting
+ * @param burst the number of messages a site may log at once; at least 1
+ */
+void xlog_set_rate_limit(unsigned int rate, unsigned int burst);
+
+/**
+ * Log a message, subject to the per-call-site rate limit.
+ *
+ * @param priority a log priority
+ * @param fmt a printf-style formatting message
+ * @param ... additional formatting arguments
+ */
+#define xlog_rl(priority, fmt, ...) __extension__ ({ \
+    static XlogSite _xlog_site; \
+    if (_xlog_on(priority)) { \
+        _xlog_rl(&_xlog_site, priority, true, __FILE__, __LINE__, __func__, fmt, __VA_ARGS__); \
+    } \
+})
+#define xlog_rl_nofmt(priority, fmt) __extension__ ({ \
+    static XlogSite _xlog_site; \
+    if (_xlog_on(priority)) { \
+        _xlog_rl(&_xlog_site, priority, true, __FILE__, __LINE__, __func__, fmt); \
+    } \
+})
+
+/**
+ * Report the messages dropped by each rate-limited call site since it last
+ * logged, with the site's location and priority.
+ */
+void xlog_rl_flush(void);
+
+void _xlog_rl(
+    XlogSite *site,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    ...);
+
+/*
+ * A log category, letting one subsystem log at a different priority than the
+ * rest of the process. Define categories with XLOG_CATEGORY_DEFINE, which
+ * registers them at startup, and log to them with xlog_cat:
+ *
+ *     XLOG_CATEGORY_DEFINE(net_log, "net");
+ *     xlog_cat(&net_log, XLOG_DEBUG, "sent %zu bytes", n);
+ *
+ * Levels can then be changed at runtime by name, see xlog_config_apply.
+ */
+typedef struct XlogCategory {
+    const char *name;
+    /* Priority of the category, or -1 to follow the global priority. */
+    int priority;
+    struct XlogCategory *next;
+} XlogCategory;
+
+/* Ends with the definition of var, so that uses can end with a semicolon. */
+#define XLOG_CATEGORY_DEFINE(var, cat_name) \
+    extern XlogCategory var; \
+    static __attribute__ ((constructor)) void _xlog_register_##var(void) \
+    { \
+        xlog_category_register(&var); \
+    } \
+    XlogCategory var = { cat_name, -1, NULL }
+
+/**
+ * Register a category, so that its priority can be set by name. Any priority
+ * set for its name by a previous xlog_config_apply is applied to it.
+ *
+ * @param cat a category, which must stay valid for the life of the process
+ */
+void xlog_category_register(XlogCategory *cat);
+
+/**
+ * Set the priority of the categories with the given name.
+ *
+ * @param name a category name
+ * @param priority a log priority, or -1 to follow the global priority
+ * @return 0 on success, or ENOENT if no such category is registered
+ */
+int xlog_set_category_priority(const char *name, int priority);
+
+static inline __attribute__ ((__unused__))
+int _xlog_cat_priority(const XlogCategory *cat)
+{
+    int priority = __atomic_load_n(&cat->priority, __ATOMIC_RELAXED);
+
+    return (priority >= 0) ? priority : __atomic_load_n(&_xlog_priority, __ATOMIC_RELAXED);
+}
+
+#define _xlog_cat_on(cat, priority) \
+    ((priority) <= XLOG_COMPILE_LEVEL && (int) (priority) <= _xlog_cat_priority(cat))
+
+/**
+ * Log a message to a category. This is the same as xlog, but the category's
+ * priority is used instead of the global one.
+ *
+ * @param cat a category
+ * @param priority a log priority
+ * @param fmt a printf-style formatting message
+ * @param ... additional formatting arguments
+ */
+#define xlog_cat(cat, priority, fmt, ...) (_xlog_cat_on(cat, priority) ? \
+    _xlog_cat(cat, priority, true, __FILE__, __LINE__, __func__, fmt, __VA_ARGS__) : (void) 0)
+#define xlog_cat_nofmt(cat, priority, fmt) (_xlog_cat_on(cat, priority) ? \
+    _xlog_cat(cat, priority, true, __FILE__, __LINE__, __func__, fmt) : (void) 0)
+
+void _xlog_cat(
+    const XlogCategory *cat,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    ...);
+
+/**
+ * Apply a log level configuration. The configuration is a list of entries
+ * separated by commas, whitespace or newlines; '#' starts a comment. Each
+ * entry is either a priority, which sets the global priority, or
+ * name=priority, which sets the priority of a category. Priorities are
+ * syslog-style names (emerg, alert, crit, err, warning, notice, info, debug),
+ * numbers, or "default" to make a category follow the global priority.
+ * Category entries are remembered and applied to categories registered later.
+ *
+ *     "warning, net=debug, db=info"
+ *
+ * @param config a configuration
+ * @return 0 on success, or EINVAL if an entry could not be parsed (valid
+ *         entries are still applied)
+ */
+int xlog_config_apply(const char *config);
+
+/**
+ * Read a configuration file in the format of xlog_config_apply and apply it.
+ *
+ * @param path a file path
+ * @return 0 on success, or an errno value
+ */
+int xlog_config_load(const char *path);
+
+/**
+ * Reload a configuration file whenever the process receives a signal (e.g.
+ * SIGHUP), so that levels can be changed without a restart. The file is read
+ * by a helper thread, not in the signal handler.
+ *
+ * @param sig a signal number
+ * @param path a file path, copied
+ * @return 0 on success, or an errno value
+ */
+int xlog_config_reload_on_signal(int sig, const char *path);
+
+/**
+ * Get the syslog-style name of a priority, e.g. "warning".
+ *
+ * @param priority a log priority
+ * @return the name
+ */
+const char *xlog_priority_name(XlogPriority priority);
+
+/* Output format of the default log function. */
+typedef enum {
+    /* Free-form text, with an optional "file:line [func]:" line. */
+    XLOG_FORMAT_TEXT = 0,
+    /* One JSON object per line. */
+    XLOG_FORMAT_JSON = 1,
+    /* One line of space-separated key=value pairs. */
+    XLOG_FORMAT_LOGFMT = 2
+} XlogFormat;
+
+/**
+ * Set the output format of the default log function. In the structured
+ * formats, every line carries a UTC timestamp with microseconds, the priority,
+ * the thread id, the location and the message, followed by any xlog_kv fields:
+ *
+ *     {"ts":"2020-06-01T12:00:00.123456Z","level":"info","tid":1234,
+ *      "file":"main.c","line":42,"func":"main","msg":"done","status":200}
+ *
+ * Bytes of strings that are not valid UTF-8 are replaced with U+FFFD. Lines are
+ * at most 1024 bytes; fields past that are dropped whole.
+ *
+ * @param format an output format
+ */
+void xlog_set_log_format(XlogFormat format);
+
+/**
+ * Get the output format of the default log function.
+ *
+ * @return the output format
+ */
+XlogFormat xlog_get_log_format(void);
+
+/*
+ * The log function used by the default one in the structured formats. Lines
+ * are encoded without allocating or calling printf (except to expand fmt) and
+ * written with a single write(2), so lines from several threads do not mix.
+ */
+void xlog_structured_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+typedef enum {
+    XLOG_KV_STR,
+    XLOG_KV_INT,
+    XLOG_KV_UINT,
+    XLOG_KV_DOUBLE,
+    XLOG_KV_BOOL
+} XlogKvType;
+
+/* A typed key-value field of a structured message. */
+typedef struct {
+    const char *key;
+    XlogKvType type;
+    union {
+        const char *s;
+        long long i;
+        unsigned long long u;
+        double d;
+        bool b;
+    } v;
+} XlogKv;
+
+#define xlog_kv_str(key, x) ((XlogKv) { (key), XLOG_KV_STR, { .s = (x) } })
+#define xlog_kv_int(key, x) ((XlogKv) { (key), XLOG_KV_INT, { .i = (x) } })
+#define xlog_kv_uint(key, x) ((XlogKv) { (key), XLOG_KV_UINT, { .u = (x) } })
+#define xlog_kv_double(key, x) ((XlogKv) { (key), XLOG_KV_DOUBLE, { .d = (x) } })
+#define xlog_kv_bool(key, x) ((XlogKv) { (key), XLOG_KV_BOOL, { .b = (x) } })
+
+/**
+ * Log a message with typed key-value fields:
+ *
+ *     xlog_kv(XLOG_INFO, "request done",
+ *             xlog_kv_str("path", path), xlog_kv_int("status", 200));
+ *
+ * In the structured formats the fields are encoded as JSON members or logfmt
+ * pairs. Otherwise, or when a custom log function is set, they are appended to
+ * the message as logfmt pairs.
+ *
+ * @param priority a log priority
+ * @param msg a message, not a format
+ * @param ... one or more fields made with the xlog_kv_* macros
+ */
+#define xlog_kv(priority, msg, ...) (_xlog_on(priority) ? _xlog_kv( \
+    priority, \
+    __FILE__, \
+    __LINE__, \
+    __func__, \
+    msg, \
+    (const XlogKv[]) { __VA_ARGS__ }, \
+    sizeof((const XlogKv[]) { __VA_ARGS__ }) / sizeof(XlogKv)) : (void) 0)
+
+void _xlog_kv(
+    XlogPriority priority,
+    const char *file,
+    int line,
+    const char *func,
+    const char *msg,
+    const XlogKv *kv,
+    size_t nkv);
+
+typedef struct {
+    /* Path of the current log file; rotated files get a ".1", ".2", ... suffix. */
+    const char *path;
+    /* Rotate before the file would grow past this many bytes; 0 for no limit. */
+    size_t max_size;
+    /* Rotate files older than this many seconds; 0 for no limit. */
+    unsigned int max_age_s;
+    /* Number of rotated files to keep; older ones are deleted. */
+    unsigned int max_files;
+    /* Reserve max_size bytes of disk for each file when it is created. */
+    bool preallocate;
+} XlogFileSinkConfig;
+
+/**
+ * Open the rotating file sink. Install xlog_file_sink_func with
+ * xlog_set_log_func (or wrap it in a custom log function) to log to it.
+ * Rotation happens under the sink's lock, so no line is lost or split across
+ * files.
+ *
+ * @param config a configuration; the path is copied
+ * @return 0 on success, EBUSY if the sink is already open, or an errno value
+ */
+int xlog_file_sink_open(const XlogFileSinkConfig *config);
+
+/**
+ * Close the rotating file sink. Later messages to it are dropped.
+ */
+void xlog_file_sink_close(void);
+
+/* The log function of the rotating file sink. */
+void xlog_file_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+/**
+ * Open the flight recorder sink: a circular buffer in memory keeping the most
+ * recent size bytes of logs, overwritten oldest first. Logging to it costs a
+ * formatting pass and a memcpy, with no lock and no system call. The buffer
+ * starts with the string "XLOGRING", so it can be found in a core dump; when a
+ * path is given, it is a shared mapping of that file and also survives the
+ * process.
+ *
+ * @param size the buffer size, rounded up to a power of two
+ * @param path a file to map, or NULL for anonymous memory
+ * @return 0 on success, EBUSY if the sink is already open, or an errno value
+ */
+int xlog_ring_sink_open(size_t size, const char *path);
+
+/**
+ * Close the flight recorder sink. No thread may be logging to it while this
+ * runs.
+ */
+void xlog_ring_sink_close(void);
+
+/* The log function of the flight recorder sink. */
+void xlog_ring_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+/**
+ * Copy the most recent contents of the flight recorder, oldest first. Lines
+ * being written concurrently may appear partially.
+ *
+ * @param buf a buffer
+ * @param size the size of buf
+ * @return the number of bytes copied
+ */
+size_t xlog_ring_sink_read(char *buf, size_t size);
+
+/**
+ * Write the most recent contents of the flight recorder, oldest first, to a
+ * file descriptor. This only uses async-signal-safe functions, so it may be
+ * called from a crash handler.
+ *
+ * @param fd a file descriptor
+ */
+void xlog_ring_sink_dump(int fd);
+
+/**
+ * Open the syslog sink, which sends messages to the local syslog daemon's
+ * datagram socket in the RFC 3164 format that syslog(3) uses,
+ * "<PRI>Mmm dd hh:mm:ss ident[pid]: msg", with the location before msg when
+ * the message has one. Sends never block: while the socket is full, messages
+ * are queued (up to a small limit, then dropped) and sent in a batch once it
+ * drains.
+ *
+ * @param path the socket path, or NULL for /dev/log
+ * @param ident the identifier of the messages, or NULL for the program name
+ * @param facility a syslog facility such as LOG_DAEMON, or 0 for LOG_USER
+ * @return 0 on success, EBUSY if the sink is already open, or an errno value
+ */
+int xlog_syslog_sink_open(const char *path, const char *ident, int facility);
+
+/**
+ * Close the syslog sink, first sending the queued messages, waiting briefly
+ * for the socket to drain if need be. Later messages to it are dropped.
+ */
+void xlog_syslog_sink_close(void);
+
+/**
+ * Try to send the messages the syslog sink queued while its socket was full,
+ * without blocking. They are otherwise sent with the next message.
+ */
+void xlog_syslog_sink_flush(void);
+
+/**
+ * Get the number of messages the syslog sink dropped.
+ */
+size_t xlog_syslog_sink_dropped(void);
+
+/* The log function of the syslog sink. */
+void xlog_syslog_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+/**
+ * Open the journald sink, which sends messages with the journal's native
+ * protocol: PRIORITY, SYSLOG_IDENTIFIER, CODE_FILE, CODE_LINE, CODE_FUNC and
+ * MESSAGE fields, in one datagram per message. Sends never block, as with the
+ * syslog sink.
+ *
+ * @param path the socket path, or NULL for /run/systemd/journal/socket
+ * @param ident the identifier of the messages, or NULL for the program name
+ * @return 0 on success, EBUSY if the sink is already open, or an errno value
+ */
+int xlog_journald_sink_open(const char *path, const char *ident);
+
+/**
+ * Close the journald sink, first sending the queued messages as the syslog
+ * sink does. Later messages to it are dropped.
+ */
+void xlog_journald_sink_close(void);
+
+/**
+ * Try to send the messages the journald sink queued, without blocking.
+ */
+void xlog_journald_sink_flush(void);
+
+/**
+ * Get the number of messages the journald sink dropped.
+ */
+size_t xlog_journald_sink_dropped(void);
+
+/* The log function of the journald sink. */
+void xlog_journald_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+/* What to do when a message is logged while the async queue is full. */
+typedef enum {
+    /* Drop the message; the number of dropped messages is reported later. */
+    XLOG_ASYNC_DROP = 0,
+    /* Wake the writer thread up and wait for it to make room. */
+    XLOG_ASYNC_BLOCK = 1
+} XlogAsyncPolicy;
+
+typedef struct {
+    /* Number of messages the queue holds; 0 for a default. */
+    size_t queue_len;
+    XlogAsyncPolicy overflow;
+    /* How long the writer thread sleeps when the queue is empty; 0 for a
+     * default. */
+    unsigned int idle_ms;
+    /* Flush the queue when the process crashes (SIGSEGV, SIGABRT, ...). The
+     * handler runs on the thread's alternate signal stack, if it has one; see
+     * xassert_thread_init. */
+    bool flush_on_crash;
+    /* Defer formatting to the writer thread; see xlog_deferred_func. */
+    bool deferred_format;
+} XlogAsyncConfig;
+
+/**
+ * Switch to asynchronous logging: messages are formatted in the calling
+ * thread into a lock-free queue, and a writer thread writes them in batches to
+ * stderr (priority XLOG_WARNING and more urgent) or stdout. This installs
+ * xlog_async_func as the log function.
+ *
+ * Lines are text in the format of the file sink, prefixed with the local time
+ * of the message. The log function set before, the format set by
+ * xlog_set_log_format and the sinks are bypassed until xlog_async_stop.
+ *
+ * @param config a configuration, or NULL for the defaults
+ * @return 0 on success, or an errno value
+ */
+int xlog_async_start(const XlogAsyncConfig *config);
+
+/**
+ * Wake the writer thread up, write out the queued messages, stop the writer
+ * thread and restore the log function that was set before xlog_async_start.
+ * No other thread may be logging while this runs.
+ */
+void xlog_async_stop(void);
+
+/**
+ * Write out the queued messages from the calling thread, including those the
+ * socket sinks queued, after reporting rate-limited messages (xlog_rl_flush). Messages keep their queue order, also relative to those
+ * the writer thread is writing. This formats deferred messages, so it must not
+ * be called from a signal handler; use xlog_flush_signal_safe there.
+ */
+void xlog_flush(void);
+
+/**
+ * Write out the queued messages from the calling thread using only
+ * async-signal-safe functions and little stack, e.g. from a crash handler.
+ * Deferred messages cannot be formatted safely, so they are written without
+ * their time and with their format string unexpanded.
+ */
+void xlog_flush_signal_safe(void);
+
+/**
+ * Get the number of messages dropped because the async queue was full.
+ */
+size_t xlog_async_dropped(void);
+
+/* The log function installed by xlog_async_start. */
+void xlog_async_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
+/*
+ * The log function installed by xlog_async_start when deferred_format is set.
+ * The caller only records the format string pointer, the location, a
+ * timestamp and the raw argument bytes (copying strings); the writer thread
+ * formats the message later and prefixes it with the capture time. Format
+ * strings must therefore outlive the process's logging, as string literals do.
+ * Messages that cannot be deferred (%n, %ls, or too large) are formatted
+ * immediately.
+ */
+void xlog_deferred_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,79 @@
+/*
+ * @file      xpool.h
+ * @brief     Fixed-size object pool (slab allocator).
+ * @copyright Copyright (C) 2020 Xevo Inc. All Rights Reserved.
+ *
+ * A pool hands out objects of a single size, carved from large slabs. Each
+ * thread keeps a small cache of free objects per pool, so allocation and free
+ * usually touch only thread-local state; the pool lock is taken once per batch
+ * of objects.
+ *
+ * Pool objects are meant to back the elements of other containers, e.g. the
+ * values of an xhash map of pointers or the entries of an xring queue:
+ *
+ *     XHASH_MAP_INIT_INT(node, struct node *)
+ *     xpool *pool = xpool_create(sizeof(struct node), 0);
+ *     xh_value(h, k) = xpool_alloc(pool);
+ *     ...
+ *     xpool_release(pool); // frees every node at once
+ */
+
+#ifndef XLIB_XPOOL_H_
+#define XLIB_XPOOL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct xpool xpool;
+
+/**
+ * Create a pool.
+ *
+ * @param obj_size size of each object, in bytes
+ * @param slab_objs number of objects per slab, or 0 for a default
+ * @return the pool, or NULL on allocation failure
+ */
+xpool *xpool_create(size_t obj_size, size_t slab_objs);
+
+/**
+ * Destroy a pool, freeing all of its objects.
+ *
+ * @param pool a pool
+ */
+void xpool_destroy(xpool *pool);
+
+/**
+ * Allocate an object. The object is aligned for any type and its contents are
+ * undefined.
+ *
+ * @param pool a pool
+ * @return the object, or NULL on allocation failure
+ */
+void *xpool_alloc(xpool *pool);
+
+/**
+ * Return an object to the pool it was allocated from. Objects may be freed
+ * from any thread.
+ *
+ * @param pool a pool
+ * @param obj an object allocated from pool, or NULL
+ */
+void xpool_free(xpool *pool, void *obj);
+
+/**
+ * Return every object of the pool at once, keeping the first slab for reuse.
+ * All objects previously allocated become invalid. This must not run
+ * concurrently with any other operation on the pool.
+ *
+ * @param pool a pool
+ */
+void xpool_release(xpool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XLIB_XPOOL_H_ */
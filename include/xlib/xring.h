@@ -0,0 +1,314 @@
+/*
+Copyright 2020 Xevo Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+<http://www.apache.org/licenses/LICENSE-2.0>
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+  An example:
+
+#include <xlib/xring.h>
+XRING_INIT(job, struct job *)
+int main() {
+	struct job *j;
+	xring_mpmc_t(job) *q = xr_mpmc_init(job, 1024);
+	if (xr_mpmc_push(job, q, make_job()) < 0)
+		... // full
+	if (xr_mpmc_pop(job, q, &j) == 0)
+		run(j);
+	xr_mpmc_destroy(job, q);
+	return 0;
+}
+*/
+
+#ifndef XLIB_XRING_H_
+#define XLIB_XRING_H_
+
+/*!
+  @header
+
+  Generic, bounded, lock-free ring queues.
+
+  Two flavors are instantiated for each element type:
+  - spsc: exactly one producer thread and one consumer thread.
+  - mpmc: any number of producer and consumer threads (based on Dmitry
+    Vyukov's bounded MPMC queue, with a sequence number per cell).
+
+  The capacity is rounded up to a power of two. Push and pop never block;
+  they return -1 if the queue is full or empty respectively.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xlib/alloc.h>
+
+#ifndef XRING_CACHELINE
+#define XRING_CACHELINE 64
+#endif
+
+#ifndef xr_inline
+#define xr_inline static inline __attribute__ ((__unused__))
+#endif
+
+/*
+ * The queue structs are over-aligned to keep the indices on separate cache
+ * lines, which malloc does not guarantee, so they come from aligned_alloc and
+ * go back to free rather than through the alloc.h macros. The element buffers
+ * are allocated normally.
+ */
+#define __xr_alloc_aligned(size) aligned_alloc(XRING_CACHELINE, size)
+#define __xr_free_aligned(p) free(p)
+
+#define __xr_roundup(x) ((x) < 2? (size_t)2 : (size_t)1 << (sizeof(size_t) * 8 - __builtin_clzl((x) - 1)))
+
+#define __XRING_SPSC(name, type)											\
+	typedef struct xr_spsc_##name##_s {									\
+		/* Consumer side. */												\
+		_Alignas(XRING_CACHELINE) atomic_size_t head;						\
+		size_t tail_cache;													\
+		/* Producer side. */												\
+		_Alignas(XRING_CACHELINE) atomic_size_t tail;						\
+		size_t head_cache;													\
+		/* Read-only after init. */											\
+		_Alignas(XRING_CACHELINE) size_t mask;								\
+		type *buf;															\
+	} xr_spsc_##name##_t;													\
+	xr_inline xr_spsc_##name##_t *xr_spsc_init_##name(size_t capacity)	\
+	{																		\
+		xr_spsc_##name##_t *r;												\
+		r = (xr_spsc_##name##_t*)__xr_alloc_aligned(sizeof(*r));			\
+		if (!r) return NULL;												\
+		memset(r, 0, sizeof(*r));											\
+		r->mask = __xr_roundup(capacity) - 1;								\
+		r->buf = (type*)xmalloc(sizeof(type) * (r->mask + 1));				\
+		if (!r->buf) { __xr_free_aligned(r); return NULL; }					\
+		atomic_init(&r->head, 0);											\
+		atomic_init(&r->tail, 0);											\
+		return r;															\
+	}																		\
+	xr_inline void xr_spsc_destroy_##name(xr_spsc_##name##_t *r)			\
+	{																		\
+		if (r) {															\
+			xfree(r->buf);													\
+			__xr_free_aligned(r);											\
+		}																	\
+	}																		\
+	/* Push up to n elements; returns the number pushed. Producer only. */ \
+	xr_inline size_t xr_spsc_push_n_##name(xr_spsc_##name##_t *r,		\
+			const type *src, size_t n)										\
+	{																		\
+		size_t tail, room, i;												\
+		tail = atomic_load_explicit(&r->tail, memory_order_relaxed);		\
+		room = r->mask + 1 - (tail - r->head_cache);						\
+		if (room < n) {														\
+			r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire); \
+			room = r->mask + 1 - (tail - r->head_cache);					\
+			if (room < n) n = room;											\
+		}																	\
+		for (i = 0; i < n; ++i)												\
+			r->buf[(tail + i) & r->mask] = src[i];							\
+		atomic_store_explicit(&r->tail, tail + n, memory_order_release);	\
+		return n;															\
+	}																		\
+	/* Pop up to n elements; returns the number popped. Consumer only. */	\
+	xr_inline size_t xr_spsc_pop_n_##name(xr_spsc_##name##_t *r,			\
+			type *dst, size_t n)											\
+	{																		\
+		size_t head, avail, i;												\
+		head = atomic_load_explicit(&r->head, memory_order_relaxed);		\
+		avail = r->tail_cache - head;										\
+		if (avail < n) {													\
+			r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire); \
+			avail = r->tail_cache - head;									\
+			if (avail < n) n = avail;										\
+		}																	\
+		for (i = 0; i < n; ++i)												\
+			dst[i] = r->buf[(head + i) & r->mask];							\
+		atomic_store_explicit(&r->head, head + n, memory_order_release);	\
+		return n;															\
+	}																		\
+	xr_inline int xr_spsc_push_##name(xr_spsc_##name##_t *r, type x)		\
+	{																		\
+		return xr_spsc_push_n_##name(r, &x, 1) == 1? 0 : -1;				\
+	}																		\
+	xr_inline int xr_spsc_pop_##name(xr_spsc_##name##_t *r, type *x)		\
+	{																		\
+		return xr_spsc_pop_n_##name(r, x, 1) == 1? 0 : -1;					\
+	}
+
+#define __XRING_MPMC(name, type)											\
+	typedef struct xr_mpmc_cell_##name##_s {								\
+		atomic_size_t seq;													\
+		type val;															\
+	} xr_mpmc_cell_##name##_t;												\
+	typedef struct xr_mpmc_##name##_s {									\
+		_Alignas(XRING_CACHELINE) atomic_size_t head;						\
+		_Alignas(XRING_CACHELINE) atomic_size_t tail;						\
+		_Alignas(XRING_CACHELINE) size_t mask;								\
+		xr_mpmc_cell_##name##_t *cells;										\
+	} xr_mpmc_##name##_t;													\
+	xr_inline xr_mpmc_##name##_t *xr_mpmc_init_##name(size_t capacity)	\
+	{																		\
+		xr_mpmc_##name##_t *r;												\
+		size_t i;															\
+		r = (xr_mpmc_##name##_t*)__xr_alloc_aligned(sizeof(*r));			\
+		if (!r) return NULL;												\
+		memset(r, 0, sizeof(*r));											\
+		r->mask = __xr_roundup(capacity) - 1;								\
+		r->cells = (xr_mpmc_cell_##name##_t*)xmalloc(sizeof(*r->cells) * (r->mask + 1)); \
+		if (!r->cells) { __xr_free_aligned(r); return NULL; }				\
+		for (i = 0; i <= r->mask; ++i)										\
+			atomic_init(&r->cells[i].seq, i);								\
+		atomic_init(&r->head, 0);											\
+		atomic_init(&r->tail, 0);											\
+		return r;															\
+	}																		\
+	xr_inline void xr_mpmc_destroy_##name(xr_mpmc_##name##_t *r)			\
+	{																		\
+		if (r) {															\
+			xfree(r->cells);												\
+			__xr_free_aligned(r);											\
+		}																	\
+	}																		\
+	/*																		\
+	 * Push up to n elements, claiming all the free slots found with a	\
+	 * single CAS. Returns the number pushed.								\
+	 */																		\
+	xr_inline size_t xr_mpmc_push_n_##name(xr_mpmc_##name##_t *r,		\
+			const type *src, size_t n)										\
+	{																		\
+		size_t pos, seq, k, i;												\
+		if (n == 0) return 0;												\
+		pos = atomic_load_explicit(&r->tail, memory_order_relaxed);		\
+		for (;;) {															\
+			for (k = 0; k < n; ++k) {										\
+				seq = atomic_load_explicit(&r->cells[(pos + k) & r->mask].seq, \
+										   memory_order_acquire);			\
+				if (seq != pos + k) break;									\
+			}																\
+			if (k == 0) {													\
+				/* Full, unless another producer moved on meanwhile. */	\
+				seq = atomic_load_explicit(&r->cells[pos & r->mask].seq,	\
+										   memory_order_acquire);			\
+				if ((intptr_t)(seq - pos) < 0) return 0;					\
+				pos = atomic_load_explicit(&r->tail, memory_order_relaxed);	\
+				continue;													\
+			}																\
+			if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + k, \
+					memory_order_relaxed, memory_order_relaxed))			\
+				break;														\
+		}																	\
+		for (i = 0; i < k; ++i) {											\
+			r->cells[(pos + i) & r->mask].val = src[i];						\
+			atomic_store_explicit(&r->cells[(pos + i) & r->mask].seq,		\
+								  pos + i + 1, memory_order_release);		\
+		}																	\
+		return k;															\
+	}																		\
+	/*																		\
+	 * Pop up to n elements, claiming all the filled slots found with a	\
+	 * single CAS. Returns the number popped.								\
+	 */																		\
+	xr_inline size_t xr_mpmc_pop_n_##name(xr_mpmc_##name##_t *r,			\
+			type *dst, size_t n)											\
+	{																		\
+		size_t pos, seq, k, i;												\
+		if (n == 0) return 0;												\
+		pos = atomic_load_explicit(&r->head, memory_order_relaxed);		\
+		for (;;) {															\
+			for (k = 0; k < n; ++k) {										\
+				seq = atomic_load_explicit(&r->cells[(pos + k) & r->mask].seq, \
+										   memory_order_acquire);			\
+				if (seq != pos + k + 1) break;								\
+			}																\
+			if (k == 0) {													\
+				/* Empty, unless another consumer moved on meanwhile. */	\
+				seq = atomic_load_explicit(&r->cells[pos & r->mask].seq,	\
+										   memory_order_acquire);			\
+				if ((intptr_t)(seq - (pos + 1)) < 0) return 0;				\
+				pos = atomic_load_explicit(&r->head, memory_order_relaxed);	\
+				continue;													\
+			}																\
+			if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + k, \
+					memory_order_relaxed, memory_order_relaxed))			\
+				break;														\
+		}																	\
+		for (i = 0; i < k; ++i) {											\
+			dst[i] = r->cells[(pos + i) & r->mask].val;						\
+			atomic_store_explicit(&r->cells[(pos + i) & r->mask].seq,		\
+								  pos + i + r->mask + 1, memory_order_release); \
+		}																	\
+		return k;															\
+	}																		\
+	xr_inline int xr_mpmc_push_##name(xr_mpmc_##name##_t *r, type x)		\
+	{																		\
+		return xr_mpmc_push_n_##name(r, &x, 1) == 1? 0 : -1;				\
+	}																		\
+	xr_inline int xr_mpmc_pop_##name(xr_mpmc_##name##_t *r, type *x)		\
+	{																		\
+		return xr_mpmc_pop_n_##name(r, x, 1) == 1? 0 : -1;					\
+	}
+
+/*! @function
+  @abstract     Instantiate the spsc and mpmc ring queues for a type
+  @param  name  Name of the ring queue [symbol]
+  @param  type  Type of the elements [type]
+ */
+#define XRING_INIT(name, type)												\
+	__XRING_SPSC(name, type)												\
+	__XRING_MPMC(name, type)
+
+/* Other convenient macros... */
+
+#define xring_spsc_t(name) xr_spsc_##name##_t
+#define xring_mpmc_t(name) xr_mpmc_##name##_t
+
+/*! @function
+  @abstract     Create a ring queue holding at least capacity elements.
+  @return       Pointer to the ring queue, or NULL on allocation failure
+ */
+#define xr_spsc_init(name, capacity) xr_spsc_init_##name(capacity)
+#define xr_mpmc_init(name, capacity) xr_mpmc_init_##name(capacity)
+
+#define xr_spsc_destroy(name, r) xr_spsc_destroy_##name(r)
+#define xr_mpmc_destroy(name, r) xr_mpmc_destroy_##name(r)
+
+/*! @function
+  @abstract     Push one element; returns 0 on success, -1 if full.
+ */
+#define xr_spsc_push(name, r, x) xr_spsc_push_##name(r, x)
+#define xr_mpmc_push(name, r, x) xr_mpmc_push_##name(r, x)
+
+/*! @function
+  @abstract     Pop one element into *x; returns 0 on success, -1 if empty.
+ */
+#define xr_spsc_pop(name, r, x) xr_spsc_pop_##name(r, x)
+#define xr_mpmc_pop(name, r, x) xr_mpmc_pop_##name(r, x)
+
+/*! @function
+  @abstract     Push/pop up to n elements; returns the number transferred.
+ */
+#define xr_spsc_push_n(name, r, src, n) xr_spsc_push_n_##name(r, src, n)
+#define xr_mpmc_push_n(name, r, src, n) xr_mpmc_push_n_##name(r, src, n)
+#define xr_spsc_pop_n(name, r, dst, n) xr_spsc_pop_n_##name(r, dst, n)
+#define xr_mpmc_pop_n(name, r, dst, n) xr_mpmc_pop_n_##name(r, dst, n)
+
+/*! @function
+  @abstract     Capacity of the ring queue.
+ */
+#define xr_capacity(r) ((r)->mask + 1)
+
+#endif /* XLIB_XRING_H_ */
@@ -54,6 +54,14 @@ int main() {
 	xv_destroy(array);
 	return 0;
 }
+
+  Small vectors can keep their first N elements inline and only spill to the
+  heap once they grow beyond that:
+
+	xvec_sbo_t(int, 8) small;
+	xv_sbo_init(small);
+	xv_push(int, small, 10); // no allocation until the 9th element
+	xv_destroy(small);
 */
 
 /*
@@ -66,23 +74,60 @@ int main() {
 #ifndef XLIB_XVEC_H_
 #define XLIB_XVEC_H_
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <xlib/alloc.h>
 
 #define xv_roundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 
 #define XVEC_DEFINE(name, type) typedef xvec_t(type) name
+#define XVEC_SBO_DEFINE(name, type, N) typedef xvec_sbo_t(type, N) name
 
 #define xvec_t(type) struct { size_t n, m; type *a; }
+
+/*
+ * A vector with small-buffer optimization: the first N elements live inline in
+ * the struct, and the storage only spills to the heap once the vector grows
+ * beyond N. All xv_* macros work on it, but it must be initialized with
+ * xv_sbo_init and, since it may point into itself, must not be copied by
+ * assignment while the elements are inline.
+ */
+#define xvec_sbo_t(type, N) struct { size_t n, m; type *a; type sbo[N]; }
+#define xv_sbo_init(v) ((v).n = 0, (v).m = sizeof((v).sbo) / sizeof((v).sbo[0]), (v).a = (v).sbo)
+
+/* True if the elements are stored inline (only possible for xvec_sbo_t). */
+#define xv_is_inline(v) ((uintptr_t) (v).a - (uintptr_t) &(v) < sizeof(v))
+
+/*
+ * Reallocate the storage of a vector, moving inline storage to the heap if
+ * needed. Inline storage is kept as is when shrinking, and so is its capacity.
+ */
+static inline __attribute__ ((__unused__))
+void *_xv_realloc(void *a, int is_inline, size_t old_size, size_t new_size)
+{
+	void *p;
+
+	if (!is_inline) return xrealloc(a, new_size);
+	if (new_size <= old_size) return a;
+	p = xmalloc(new_size);
+	if (p) memcpy(p, a, old_size);
+	return p;
+}
+
+#define _xv_grow(type, v, s) \
+	((v).a = (type*)_xv_realloc((v).a, xv_is_inline(v), sizeof(type) * (v).m, sizeof(type) * (s)), \
+	 (v).m = (xv_is_inline(v) && (v).m > (s)) ? (v).m : (s))
+
 #define xv_init(v) ((v).n = (v).m = 0, (v).a = 0)
-#define xv_destroy(v) free((v).a)
+#define xv_destroy(v) (xv_is_inline(v) ? (void) 0 : (void) xfree((v).a))
 #define xv_A(v, i) ((v).a[(i)])
 #define xv_pop(v) ((v).a[--(v).n])
 #define xv_size(v) ((v).n)
 #define xv_max(v) ((v).m)
 #define xv_data(v) ((v).a)
 
-#define xv_resize(type, v, s)  ((v).m = (s), (v).a = (type*)xrealloc((v).a, sizeof(type) * (v).m))
+#define xv_resize(type, v, s)  _xv_grow(type, v, s)
 #define xv_trim(type, v) (xv_resize(type, v, xv_size(v)))
 
 #define xv_copy(type, v1, v0) do {							\
@@ -93,23 +138,76 @@ int main() {
 
 #define xv_push(type, v, x) do {									\
 		if ((v).n == (v).m) {										\
-			(v).m = (v).m? (v).m<<1 : 2;							\
-			(v).a = (type*)xrealloc((v).a, sizeof(type) * (v).m);	\
+			_xv_grow(type, v, (v).m? (v).m<<1 : 2);					\
 		}															\
 		(v).a[(v).n++] = (x);										\
 	} while (0)
 
 #define xv_pushp(type, v) ((((v).n == (v).m)?							\
-						   ((v).m = ((v).m? (v).m<<1 : 2),				\
-							(v).a = (type*)xrealloc((v).a, sizeof(type) * (v).m), 0)	\
+						   (_xv_grow(type, v, (v).m? (v).m<<1 : 2), 0)	\
 						   : 0), ((v).a + ((v).n++)))
 
 #define xv_a(type, v, i) (((v).m <= (size_t)(i)? \
-						  ((v).m = (v).n = (i) + 1, xv_roundup32((v).m), \
-						   (v).a = (type*)xrealloc((v).a, sizeof(type) * (v).m), 0) \
+						  ((v).n = (i) + 1, xv_roundup32((v).n), _xv_grow(type, v, (v).n), \
+						   (v).n = (i) + 1, 0) \
 						  : (v).n <= (size_t)(i)? (v).n = (i) + 1 \
 						  : 0), (v).a[(i)])
 
+/*
+ * Make sure the vector can hold at least s elements without reallocating.
+ */
+#define xv_reserve(type, v, s) do {									\
+		size_t _xv_m = (s);											\
+		if ((v).m < _xv_m) {										\
+			xv_roundup32(_xv_m);									\
+			_xv_grow(type, v, _xv_m);								\
+		}															\
+	} while (0)
+
+/*
+ * Replace the del elements starting at index i with the cnt elements at src,
+ * preserving the order of the rest of the array. The tail is moved once and
+ * the storage grows at most once. src must not point into v.
+ */
+#define xv_splice(type, v, i, del, src, cnt) do {					\
+		size_t _xv_i = (i), _xv_d = (del), _xv_c = (cnt);			\
+		xv_reserve(type, v, (v).n - _xv_d + _xv_c);					\
+		if (_xv_d != _xv_c)											\
+			memmove((v).a + _xv_i + _xv_c, (v).a + _xv_i + _xv_d,	\
+					sizeof(type) * ((v).n - _xv_i - _xv_d));		\
+		memcpy((v).a + _xv_i, (src), sizeof(type) * _xv_c);		\
+		(v).n = (v).n - _xv_d + _xv_c;								\
+	} while (0)
+
+/*
+ * Insert the cnt elements at src before index i, preserving order.
+ */
+#define xv_insert_n(type, v, i, src, cnt) xv_splice(type, v, i, 0, src, cnt)
+
+/*
+ * Delete the elements in the index range [i, j), preserving order.
+ */
+#define xv_erase_range(v, i, j) do {								\
+		size_t _xv_i = (i), _xv_j = (j);							\
+		memmove((v).a + _xv_i, (v).a + _xv_j,						\
+				sizeof(*(v).a) * ((v).n - _xv_j));					\
+		(v).n -= _xv_j - _xv_i;										\
+	} while (0)
+
+/*
+ * Delete every element x for which pred(x) is true in a single pass,
+ * preserving the order of the remaining elements.
+ */
+#define xv_remove_if(v, pred) do {									\
+		size_t _xv_i, _xv_j;										\
+		for (_xv_i = _xv_j = 0; _xv_i < (v).n; ++_xv_i) {			\
+			if (pred((v).a[_xv_i])) continue;						\
+			if (_xv_i != _xv_j) (v).a[_xv_j] = (v).a[_xv_i];		\
+			++_xv_j;												\
+		}															\
+		(v).n = _xv_j;												\
+	} while (0)
+
 /*
  * Quickly delete an item at the given index, by copying the item at the end of
  * the array to the index and then popping. Thus, this does *not* preserve the
@@ -0,0 +1,289 @@
+/**
+ * @file      xarena.c
+ * @brief     Region (arena) allocator with bulk reset.
+ * @copyright Copyright (C) 2020 Xevo Inc. All Rights Reserved.
+ *
+ */
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/alloc.h>
+#include <xlib/xarena.h>
+
+/* Size of the first chunk when none is given. */
+#define XARENA_CHUNK_SIZE (16 * 1024)
+
+/* Chunks stop doubling in size beyond this. */
+#define XARENA_CHUNK_MAX (16 * 1024 * 1024)
+
+struct xarena_chunk {
+    xarena_chunk *prev;
+    char *end;
+    alignas(max_align_t) char data[];
+};
+
+static _Thread_local xarena *s_bound;
+
+void xarena_init(xarena *a, size_t chunk_size)
+{
+    a->chunk = NULL;
+    a->ptr = NULL;
+    a->end = NULL;
+    a->chunk_size = (chunk_size != 0) ? chunk_size : XARENA_CHUNK_SIZE;
+    a->last = NULL;
+}
+
+/* Free chunks from the most recent one until stop (excluded). */
+static void free_chunks(xarena_chunk *chunk, xarena_chunk *stop)
+{
+    xarena_chunk *prev;
+
+    for (; chunk != stop; chunk = prev) {
+        prev = chunk->prev;
+        xfree(chunk);
+    }
+}
+
+void xarena_destroy(xarena *a)
+{
+    free_chunks(a->chunk, NULL);
+    a->chunk = NULL;
+    a->ptr = NULL;
+    a->end = NULL;
+    a->last = NULL;
+}
+
+void xarena_reset(xarena *a)
+{
+    if (a->chunk == NULL) {
+        return;
+    }
+
+    free_chunks(a->chunk->prev, NULL);
+    a->chunk->prev = NULL;
+    a->ptr = a->chunk->data;
+    a->end = a->chunk->end;
+    a->last = NULL;
+}
+
+xarena_mark xarena_get_mark(const xarena *a)
+{
+    xarena_mark mark = { a->chunk, a->ptr };
+
+    return mark;
+}
+
+void xarena_rewind(xarena *a, xarena_mark mark)
+{
+    free_chunks(a->chunk, mark.chunk);
+    a->chunk = mark.chunk;
+    a->ptr = mark.ptr;
+    a->end = (mark.chunk != NULL) ? mark.chunk->end : NULL;
+    a->last = NULL;
+}
+
+void *_xarena_alloc_slow(xarena *a, size_t size, size_t align)
+{
+    xarena_chunk *chunk;
+    size_t chunk_size = a->chunk_size;
+
+    /* Oversized requests get a chunk of their own. */
+    if (chunk_size < size + align) {
+        chunk_size = size + align;
+    }
+    else if (a->chunk_size < XARENA_CHUNK_MAX) {
+        a->chunk_size *= 2;
+    }
+
+    chunk = xmalloc(sizeof(*chunk) + chunk_size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->prev = a->chunk;
+    chunk->end = chunk->data + chunk_size;
+    a->chunk = chunk;
+    a->ptr = chunk->data;
+    a->end = chunk->end;
+
+    return xarena_alloc_align(a, size, align);
+}
+
+xarena *xarena_bind(xarena *a)
+{
+    xarena *prev = s_bound;
+
+    s_bound = a;
+
+    return prev;
+}
+
+xarena *xarena_bound(void)
+{
+    return s_bound;
+}
+
+/*
+ * Memory handed out through the bound functions is preceded by a header
+ * telling which arena it comes from, or that it comes from libc, and its
+ * size. Frees and reallocations follow the header rather than the arena bound
+ * at the time, so a container can be grown or destroyed after its arena was
+ * unbound or another one was bound.
+ */
+#define MAGIC_ARENA ((uint32_t) 0x78617265)
+#define MAGIC_LIBC ((uint32_t) 0x786c6962)
+
+typedef struct bound_hdr {
+    xarena *arena;
+    size_t size;
+    uint32_t magic;
+} bound_hdr;
+
+#define HDR_SIZE ((sizeof(bound_hdr) + XARENA_ALIGN - 1) & ~(XARENA_ALIGN - 1))
+#define HDR(p) ((bound_hdr *) ((char *) (p) - HDR_SIZE))
+
+static bound_hdr *get_hdr(void *p)
+{
+    bound_hdr *hdr = HDR(p);
+
+    /* Memory not from the bound functions cannot be told apart safely. */
+    if (hdr->magic != MAGIC_ARENA && hdr->magic != MAGIC_LIBC) {
+        abort();
+    }
+
+    return hdr;
+}
+
+static void *arena_malloc(xarena *a, size_t size)
+{
+    bound_hdr *hdr;
+
+    if (size > SIZE_MAX - HDR_SIZE) {
+        return NULL;
+    }
+    hdr = xarena_alloc(a, HDR_SIZE + size);
+    if (hdr == NULL) {
+        return NULL;
+    }
+    hdr->arena = a;
+    hdr->size = size;
+    hdr->magic = MAGIC_ARENA;
+
+    return (char *) hdr + HDR_SIZE;
+}
+
+static void *libc_malloc(size_t size, bool zero)
+{
+    bound_hdr *hdr;
+
+    if (size > SIZE_MAX - HDR_SIZE) {
+        return NULL;
+    }
+    hdr = zero ? calloc(1, HDR_SIZE + size) : malloc(HDR_SIZE + size);
+    if (hdr == NULL) {
+        return NULL;
+    }
+    hdr->arena = NULL;
+    hdr->size = size;
+    hdr->magic = MAGIC_LIBC;
+
+    return (char *) hdr + HDR_SIZE;
+}
+
+void *xarena_bound_malloc(size_t size)
+{
+    xarena *a = s_bound;
+
+    return (a != NULL) ? arena_malloc(a, size) : libc_malloc(size, false);
+}
+
+void *xarena_bound_calloc(size_t n, size_t size)
+{
+    void *p;
+
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    if (s_bound == NULL) {
+        return libc_malloc(n * size, true);
+    }
+
+    p = arena_malloc(s_bound, n * size);
+    if (p != NULL) {
+        memset(p, 0, n * size);
+    }
+
+    return p;
+}
+
+void *xarena_bound_realloc(void *p, size_t size)
+{
+    bound_hdr *hdr;
+    xarena *a;
+    void *q;
+
+    if (p == NULL) {
+        return xarena_bound_malloc(size);
+    }
+
+    hdr = get_hdr(p);
+    if (hdr->magic == MAGIC_LIBC) {
+        if (size > SIZE_MAX - HDR_SIZE) {
+            return NULL;
+        }
+        hdr = realloc(hdr, HDR_SIZE + size);
+        if (hdr == NULL) {
+            return NULL;
+        }
+        hdr->size = size;
+        return (char *) hdr + HDR_SIZE;
+    }
+
+    /* Arena memory stays in its arena, whichever one is bound. */
+    a = hdr->arena;
+    if (size <= hdr->size) {
+        return p;
+    }
+
+    /* Grow the most recent allocation in place if the chunk has room. */
+    if ((void *) hdr == a->last && size <= (size_t) (a->end - (char *) p)) {
+        hdr->size = size;
+        a->ptr = (char *) p + size;
+        return p;
+    }
+
+    q = arena_malloc(a, size);
+    if (q != NULL) {
+        memcpy(q, p, hdr->size);
+    }
+
+    return q;
+}
+
+void xarena_bound_free(void *p)
+{
+    bound_hdr *hdr;
+    xarena *a;
+
+    if (p == NULL) {
+        return;
+    }
+
+    hdr = get_hdr(p);
+    if (hdr->magic == MAGIC_LIBC) {
+        hdr->magic = 0;
+        free(hdr);
+        return;
+    }
+
+    /* Only the most recent allocation of an arena can be given back. */
+    a = hdr->arena;
+    if ((void *) hdr == a->last) {
+        a->ptr = a->last;
+        a->last = NULL;
+    }
+}
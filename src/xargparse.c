@@ -2,8 +2,17 @@
  * @file      xargparse.c
  * @brief     Command line argument parser a la Python
  *  Restrictions:
- *      - not reentrant
- *      - not entirely safe wrt caller passed formats CR
+ *      - reentrant per instance: the argp description, version and bug
+ *        address are built once by xargparse_new and argp's globals are
+ *        left alone, so separate instances may parse in parallel
+ *      - values are converted by the strict parsers of xargparse_value.c
+ *        according to the entry type; the format of an entry is unused
+ *
+ *  Options are looked up through an index built at init: a table by short
+ *  key and a hash by long name. Command lines made only of known options and
+ *  positional arguments are parsed natively; anything else (help, usage,
+ *  version, abbreviated or unknown options, errors) is parsed again by argp,
+ *  so messages and exit behavior are argp's.
  *
  * @author    Vlad Sadovsky <vsadovsky at xevo.com>
  * @copyright Copyright (C) 2017 Xevo Inc. All Rights Reserved.
@@ -13,15 +22,22 @@
 #define     _POSIX_C_SOURCE     200810L
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <xlib/xargparse.h>
 #include <xlib/xassert.h>
+#include <xlib/xhash.h>
+#include <xlib/xvec.h>
 
 /* Maximum length of description strings. */
 #define MAX_STRING  100
@@ -36,88 +52,421 @@
 
 typedef unsigned int uint;
 
-/* argp globals per:
- * http://www.gnu.org/software/libc/manual/html_node/Argp-Global-Variables.html#Argp-Global-Variables
- * */
-const char *argp_program_version = NULL;
-const char *argp_program_bug_address = NULL;
-error_t argp_err_exit_status = 0;
-
 static const char program_default_doc[] = "generic xargparse program";
 static const char args_default_docs[] = "ARG1...";
+static const char commands_default_docs[] = "COMMAND [ARG...]";
 
 /*
-*  From argp.h
-*  long-name, key, descriptive-name,flags,doc-string,group
-*  End is marked with NULL long-name
-*/
-static struct argp_option *argp_l0pt_options = NULL;
+ * Key of the built-in version option when -V is taken by a caller entry;
+ * keys outside the char range have no short option.
+ */
+#define XARG_KEY_VERSION    0x100
+
+/* Too many positional arguments; E2BIG means ARGP_ERR_UNKNOWN to argp. */
+#define XARG_ETOOMANY       EINVAL
+
+/* parse_native result when argp has to parse the command line instead. */
+#define NATIVE_FALLBACK     (-1)
+
+/* Longest "--name=value" option name looked up without going through argp. */
+#define MAX_LONG_NAME       64
+
+XHASH_MAP_INIT_STR(xarg_name, const xargparse_entry *)
+
+/* Entry lookup, first entry wins as with argp. */
+struct xargparse_index {
+    const xargparse_entry *by_key[UCHAR_MAX + 1];
+    xh_xarg_name_t *by_name;
+};
+
+/* A subcommand, with its parser built the first time it is selected. */
+typedef struct xargparse_command {
+    const char *name;
+    const char *doc;
+    const char *args_doc;
+    const xargparse_entry *entries;
+    xargparse *parser;
+    /* "prog name", the program name of the command in argp messages. */
+    char *prog_name;
+} xargparse_command;
+
+XHASH_MAP_INIT_STR(xarg_cmd, size_t)
+
+struct xargparse_commands {
+    xvec_t(xargparse_command) list;
+    xh_xarg_cmd_t *by_name;
+    /* Index of the command selected by the last parse, or SIZE_MAX. */
+    size_t selected;
+};
+
+/* Parsing context. */
+struct xargparse
+{
+    /* Provided by the caller */
+    const xargparse_entry *arguments;
+    unsigned int ent_count;
+    /* Positional arguments; no maximum unless max_pos_args is lowered. */
+    unsigned int max_pos_args, min_pos_args;
+    unsigned int npos_args;
+    xvec_t(char *) pos_args;
+    xargparse_pos_cb *pos_cb;
+    void *pos_cb_ctx;
+    bool response_files;
+    /* Positional arguments handed out before argp took over, and response
+     * files the stored arguments point into. */
+    unsigned int npos_skip;
+    xvec_t(char *) pos_buffers;
+    /* Standard fields */
+    bool verbose;
+    /* argp description built once by parser_init. */
+    struct argp_option *options;
+    struct argp argp;
+    char *version;
+    int version_key;
+    char *doc;
+    /* Short key and long name lookup of the entries. */
+    struct xargparse_index *index;
+    /* Subcommands, NULL until one is added. */
+    struct xargparse_commands *commands;
+};
 
 /*
  * Use xargparse as a context to communicate with parsing callback from longopt.
  */
 typedef xargparse argp_l0pt_ctx;
 
-static argp_l0pt_ctx *argp_context;
-
 static error_t argp_l0pt_cb(int key, char *arg, struct argp_state *state);
+static void parser_destroy(xargparse *self);
 
-/* Program descriptor for argp_longopt. */
-static struct argp argp_l0pt_desc;
+static const xargparse_entry *
+find_key(const xargparse *self, int key)
+{
+    if (key < CHAR_MIN || key > UCHAR_MAX || key == 0) {
+        return NULL;
+    }
+    return self->index->by_key[(unsigned char)key];
+}
+
+static const xargparse_entry *
+find_name(const xargparse *self, const char *name)
+{
+    xhint_t it = xh_get(xarg_name, self->index->by_name, name);
+
+    return (it != xh_end(self->index->by_name)) ?
+        xh_value(self->index->by_name, it) : NULL;
+}
 
 /* extended (described by the caller) argument parsing. */
 static error_t
-parse_xargument(xargparse *self, int key, char *arg)
+parse_xargument(xargparse *self, const xargparse_entry *ent_cur, const char *arg)
 {
-    const xargparse_entry *ent_cur = self->arguments;
-    while ((ent_cur->type != 0) && (ent_cur->key != key)) {
-        ent_cur++;
+    /* -q and -v entries only toggle verbosity. */
+    if (ent_cur->key == 'q') {
+        self->verbose = false;
+        return EOK;
+    } else if (ent_cur->key == 'v') {
+        self->verbose = true;
+        return EOK;
     }
 
-    if (ent_cur->type == 0) {
-        /* Entry hadn't been found for the key given, so bail. */
-        return ENOENT;
+    if (arg == NULL) {
+        return EINVAL;
     }
 
-    /* Treat bool specially. */
-    if (ent_cur->type == XARGPARSE_TYPE_BOOL) {
-        if (arg == NULL) {
-            return EINVAL;
+    switch (ent_cur->type) {
+    case XARGPARSE_TYPE_BOOL:
+        return xargparse_parse_bool(arg, ent_cur->field);
+    case XARGPARSE_TYPE_INT:
+        return xargparse_parse_int(arg, ent_cur->field);
+    case XARGPARSE_TYPE_UINT:
+        return xargparse_parse_uint(arg, ent_cur->field);
+    case XARGPARSE_TYPE_INT64:
+        return xargparse_parse_int64(arg, ent_cur->field);
+    case XARGPARSE_TYPE_DOUBLE:
+        return xargparse_parse_double(arg, ent_cur->field);
+    case XARGPARSE_TYPE_SIZE:
+        return xargparse_parse_size(arg, ent_cur->field);
+    case XARGPARSE_TYPE_DURATION:
+        return xargparse_parse_duration(arg, ent_cur->field);
+    case XARGPARSE_TYPE_ENUM:
+        return xargparse_parse_enum(arg, ent_cur->choices, ent_cur->field);
+    case XARGPARSE_TYPE_STRING:
+        /* Truncate to the field, always terminated. */
+        if (ent_cur->field_size > 0) {
+            size_t len = strnlen(arg, ent_cur->field_size - 1);
+            memcpy(ent_cur->field, arg, len);
+            ((char *)ent_cur->field)[len] = '\0';
         }
-        if (!strcasecmp(arg, "false") || !strcmp(arg, "0")) {
-            *((bool *)ent_cur->field) = false;
-            return EOK;
-        } else if (!strcasecmp(arg, "true") || !strcmp(arg, "1")) {
-            *((bool *)ent_cur->field) = true;
-            return EOK;
+        return EOK;
+    default:
+        return EINVAL;
+    }
+}
+
+/* Tell the user why the value of an option was rejected. */
+static void
+report_value_error(const struct argp_state *state, const xargparse_entry *ent,
+                   const char *arg, error_t rc)
+{
+    static const char *const type_names[] = {
+        [XARGPARSE_TYPE_BOOL] = "boolean",
+        [XARGPARSE_TYPE_INT] = "integer",
+        [XARGPARSE_TYPE_UINT] = "unsigned integer",
+        [XARGPARSE_TYPE_STRING] = "string",
+        [XARGPARSE_TYPE_DOUBLE] = "number",
+        [XARGPARSE_TYPE_INT64] = "integer",
+        [XARGPARSE_TYPE_SIZE] = "size",
+        [XARGPARSE_TYPE_DURATION] = "duration",
+        [XARGPARSE_TYPE_ENUM] = "choice",
+    };
+    const char *name = (ent->long_name != NULL) ? ent->long_name : "";
+    char choices[MAX_STRING] = "";
+    size_t len = 0;
+
+    if (arg == NULL) {
+        argp_error(state, "option '--%s' requires a value", name);
+    } else if (rc == ERANGE) {
+        argp_error(state, "value '%s' of option '--%s' is out of range",
+                   arg, name);
+    } else if (ent->type == XARGPARSE_TYPE_ENUM && ent->choices != NULL) {
+        for (uint i = 0; ent->choices[i] != NULL && len < sizeof(choices); i++) {
+            len += snprintf(choices + len, sizeof(choices) - len, "%s%s",
+                            (i > 0) ? ", " : "", ent->choices[i]);
+        }
+        argp_error(state, "invalid choice '%s' for option '--%s' (choose from %s)",
+                   arg, name, choices);
+    } else {
+        argp_error(state, "invalid %s '%s' for option '--%s'",
+                   ((uint)ent->type < NUM_ELEMS(type_names) &&
+                    type_names[ent->type] != NULL) ? type_names[ent->type] : "value",
+                   arg, name);
+    }
+}
+
+/*
+ * Take the argument of an option: the rest of the word if any, else the next
+ * word unless the argument is optional.
+ */
+static bool
+take_arg(const xargparse_entry *ent, char *rest, int argc, char **argv,
+         int *i, char **arg)
+{
+    if (rest != NULL) {
+        *arg = rest;
+    } else if (ent->flags & OPTION_ARG_OPTIONAL) {
+        *arg = NULL;
+    } else if (*i + 1 < argc) {
+        *arg = argv[++*i];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Hand a positional argument to the callback, or store it. Arguments already
+ * handed out by the native pass are only counted when argp parses again.
+ */
+static int
+deliver_positional(xargparse *self, char *arg, bool *aborted)
+{
+    int rc;
+
+    if (self->npos_args < self->npos_skip) {
+        self->npos_args++;
+        return 0;
+    }
+    if (self->npos_args >= self->max_pos_args) {
+        return XARG_ETOOMANY;
+    }
+    self->npos_args++;
+
+    if (self->pos_cb != NULL) {
+        rc = self->pos_cb(self, arg, self->pos_cb_ctx);
+        *aborted = (rc != 0);
+        return rc;
+    }
+    xv_push(char *, self->pos_args, arg);
+    return 0;
+}
+
+/* Read a whole file, NUL terminated. */
+static int
+read_file(const char *path, char **data, size_t *size)
+{
+    struct stat st;
+    size_t off = 0;
+    ssize_t n;
+    int fd, rc = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, &st) != 0) {
+        rc = errno;
+    } else if ((*data = malloc(st.st_size + 1)) == NULL) {
+        rc = ENOMEM;
+    } else {
+        for (; off < (size_t)st.st_size; off += n) {
+            n = read(fd, *data + off, st.st_size - off);
+            if (n <= 0) {
+                break;
+            }
+        }
+        (*data)[off] = '\0';
+        *size = off;
+    }
+    close(fd);
+
+    return rc;
+}
+
+/*
+ * Add a positional argument, replacing @file by the lines of file when
+ * response files are enabled. Errors are reported through argp when state is
+ * given; aborted tells errors of the positional callback apart.
+ */
+static int
+add_positional(xargparse *self, char *arg, struct argp_state *state,
+               bool *aborted)
+{
+    char *data, *line, *eol;
+    size_t size;
+    int rc;
+
+    if (!self->response_files || arg[0] != '@') {
+        rc = deliver_positional(self, arg, aborted);
+        if (rc == XARG_ETOOMANY && !*aborted && state != NULL) {
+            argp_error(state, "too many arguments");
+        }
+        return rc;
+    }
+
+    rc = read_file(arg + 1, &data, &size);
+    if (rc != 0) {
+        if (state != NULL) {
+            argp_failure(state, 0, rc, "%s", arg + 1);
         }
+        return rc;
     }
 
-    if (ent_cur->format == NULL) {
-        if (ent_cur->field_size > 1) {
-            strncpy(ent_cur->field, arg, ent_cur->field_size - 1);
+    /* One argument per line, terminated in place. */
+    for (line = data; line < data + size && rc == 0; line = eol + 1) {
+        eol = memchr(line, '\n', data + size - line);
+        if (eol == NULL) {
+            eol = data + size;
         }
+        *eol = '\0';
+        if (eol > line && eol[-1] == '\r') {
+            eol[-1] = '\0';
+        }
+        if (*line != '\0') {
+            rc = deliver_positional(self, line, aborted);
+        }
+    }
+    if (rc == XARG_ETOOMANY && !*aborted && state != NULL) {
+        argp_error(state, "too many arguments");
+    }
+
+    /* Stored arguments point into the file until the next parse. */
+    if (self->pos_cb == NULL) {
+        xv_push(char *, self->pos_buffers, data);
     } else {
-        /* Format the given string. */
-        if (arg != NULL) {
-            sscanf(arg, ent_cur->format, ent_cur->field);
+        free(data);
+    }
+
+    return rc;
+}
+
+/*
+ * Parse the command line without argp, in argp's default (permuting) order.
+ * Returns NATIVE_FALLBACK on anything this path leaves to argp; the fields
+ * already set are then set again by argp to the same values, and the
+ * positional arguments already handed out are skipped. Errors of the
+ * positional callback are returned as is.
+ */
+static int
+parse_native(xargparse *self, int argc, char **argv)
+{
+    const xargparse_entry *ent;
+    char name[MAX_LONG_NAME];
+    bool opts_done = false, aborted = false;
+    char *word, *eq, *arg;
+    size_t len;
+    int rc;
+
+    /*
+     * Stop at the first non-option, which argp does too in that case. The
+     * XARGPARSE_ARGP_ONLY variable turns this path off, to tell its problems
+     * from argp's and to compare the two in tests.
+     */
+    if (getenv("POSIXLY_CORRECT") != NULL || getenv("XARGPARSE_ARGP_ONLY") != NULL) {
+        return NATIVE_FALLBACK;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        word = argv[i];
+
+        if (opts_done || word[0] != '-' || word[1] == '\0') {
+            rc = add_positional(self, word, NULL, &aborted);
+            if (rc != 0) {
+                return aborted ? rc : NATIVE_FALLBACK;
+            }
+        } else if (word[1] == '-') {
+            if (word[2] == '\0') {
+                opts_done = true;
+                continue;
+            }
+            eq = strchr(word + 2, '=');
+            if (eq != NULL) {
+                len = eq - (word + 2);
+                if (len >= sizeof(name)) {
+                    return NATIVE_FALLBACK;
+                }
+                memcpy(name, word + 2, len);
+                name[len] = '\0';
+                ent = find_name(self, name);
+                eq++;
+            } else {
+                ent = find_name(self, word + 2);
+            }
+            if (ent == NULL || !take_arg(ent, eq, argc, argv, &i, &arg) ||
+                parse_xargument(self, ent, arg) != EOK) {
+                return NATIVE_FALLBACK;
+            }
         } else {
-            return EINVAL;
+            /* Every option takes an argument, so the rest of the word
+             * after a short option is its argument. */
+            ent = find_key(self, (unsigned char)word[1]);
+            if (ent == NULL ||
+                !take_arg(ent, (word[2] != '\0') ? word + 2 : NULL,
+                          argc, argv, &i, &arg) ||
+                parse_xargument(self, ent, arg) != EOK) {
+                return NATIVE_FALLBACK;
+            }
         }
     }
 
-    return 0;
+    return (self->npos_args >= self->min_pos_args) ? 0 : NATIVE_FALLBACK;
 }
 
-
 /* Callback for argp_longopt. */
 static error_t
 argp_l0pt_cb(int key, char *arg, struct argp_state *state)
 {
     /* Get the input context from argp_parse. */
     argp_l0pt_ctx *ctx = state->input;
+    const xargparse_entry *ent;
+    bool aborted = false;
     error_t rc = EOK;
 
+    if (ctx->version != NULL && key == ctx->version_key) {
+        /* Replaces argp_program_version, which is process-wide. */
+        fprintf(state->out_stream, "%s\n", ctx->version);
+        return 0;
+    }
+
     switch (key) {
     case 'q':
         ctx->verbose = false;
@@ -138,18 +487,11 @@ argp_l0pt_cb(int key, char *arg, struct argp_state *state)
         break;
 
     case ARGP_KEY_ARG:
-        if (state->arg_num >= ctx->max_pos_args) {
-            argp_usage(state);
-        }
-
         /* Received next positional argument. */
-        ctx->npos_args += 1;
-        ctx->pos_args[state->arg_num] = arg;
-
-        break;
+        return add_positional(ctx, arg, state, &aborted);
 
     case ARGP_KEY_END:
-        if (state->arg_num < ctx->min_pos_args) {
+        if (ctx->npos_args < ctx->min_pos_args) {
             fprintf(stderr, " ERROR: not enough positional arguments \n");
             argp_usage(state);
         }
@@ -160,9 +502,16 @@ argp_l0pt_cb(int key, char *arg, struct argp_state *state)
          * Not an apriori known type - match to the entries table passed to us
          * to decipher.
          */
-        rc = parse_xargument((xargparse *)ctx, key, arg);
+        ent = find_key(ctx, key);
+        if (ent == NULL) {
+            return ARGP_ERR_UNKNOWN;
+        }
+        rc = parse_xargument(ctx, ent, arg);
+        if (rc != EOK) {
+            report_value_error(state, ent, arg, rc);
+        }
     }
-    return (rc == EOK) ? 0 : ARGP_ERR_UNKNOWN;
+    return rc;
 }
 
 /* Initialize longopt context. */
@@ -171,120 +520,557 @@ argp_l0pt_init(argp_l0pt_ctx *ctx)
 {
     ctx->verbose = false;
     ctx->min_pos_args = 0;
-    ctx->max_pos_args = sizeof(ctx->pos_args) / sizeof(ctx->pos_args[0]);
+    ctx->max_pos_args = UINT_MAX;
     ctx->npos_args = 0;
-    /* Allocate room for a single positional argument by default. */
+    xv_init(ctx->pos_args);
+    xv_init(ctx->pos_buffers);
+}
+
+static void
+free_pos_buffers(xargparse *self)
+{
+    for (size_t i = 0; i < xv_size(self->pos_buffers); i++) {
+        free(xv_A(self->pos_buffers, i));
+    }
+    self->pos_buffers.n = 0;
 }
 
 
-/* API implementation */
-xargparse_err xargparse_init(xargparse *self, xargparse_entry *entries,
-                             const char *prg_version, const char *bug_addr,
-                             const char *prg_doc, const char *args_doc)
+static bool
+has_key(const xargparse *self, int key)
+{
+    for (uint i = 0; i < self->ent_count; i++) {
+        if (self->arguments[i].key == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Build the argp description of an instance: the option table mirroring the
+ * caller's entries plus a version option, and the doc string carrying the bug
+ * address after the \v separator, where argp prints it below the options.
+ */
+static xargparse_err
+argp_l0pt_build(xargparse *self, const char *prg_version, const char *bug_addr,
+                const char *prg_doc, const char *args_doc)
+{
+    struct argp_option *cur_option;
+    const xargparse_entry *cur_entry;
+    size_t doc_len;
+
+    /* Entries, version and the terminating one (key = 0, name = NULL). */
+    self->options = calloc(self->ent_count + 2, sizeof(*self->options));
+    if (self->options == NULL) {
+        return ENOMEM;
+    }
+
+    /* Replicate our entries. */
+    cur_option = self->options;
+    cur_entry = self->arguments;
+    for (uint i = 0; i < self->ent_count; i++, cur_option++, cur_entry++) {
+        cur_option->key = cur_entry->key;
+        cur_option->name = cur_entry->long_name;
+        cur_option->arg = cur_entry->long_name;
+        /* Do we need OPTION_ flags beyond OPTION_ARG_OPTIONAL. */
+        cur_option->flags = cur_entry->flags;
+    }
+
+    if (prg_version != NULL) {
+        self->version = strdup(prg_version);
+        if (self->version == NULL) {
+            return ENOMEM;
+        }
+        self->version_key = has_key(self, 'V') ? XARG_KEY_VERSION : 'V';
+        cur_option->key = self->version_key;
+        cur_option->name = "version";
+        cur_option->doc = "Print program version";
+        cur_option->group = -1;
+    }
+
+    if (prg_doc == NULL) {
+        prg_doc = program_default_doc;
+    }
+    if (bug_addr != NULL) {
+        doc_len = strlen(prg_doc) + strlen(bug_addr) + sizeof("\vReport bugs to .");
+        self->doc = malloc(doc_len);
+        if (self->doc == NULL) {
+            return ENOMEM;
+        }
+        snprintf(self->doc, doc_len, "%s\vReport bugs to %s.", prg_doc, bug_addr);
+        prg_doc = self->doc;
+    }
+
+    /* Program descriptor for argp_parse. */
+    self->argp.options = self->options;
+    self->argp.parser = argp_l0pt_cb;
+    self->argp.doc = prg_doc;
+    self->argp.args_doc = (args_doc != NULL) ? args_doc : args_default_docs;
+
+    return 0;
+}
+
+/* Index the entries by short key and long name. */
+static xargparse_err
+index_build(xargparse *self)
+{
+    const xargparse_entry *ent = self->arguments;
+    int ret;
+
+    self->index = calloc(1, sizeof(*self->index));
+    if (self->index == NULL) {
+        return ENOMEM;
+    }
+    self->index->by_name = xh_init(xarg_name);
+    if (self->index->by_name == NULL) {
+        return ENOMEM;
+    }
+
+    for (uint i = 0; i < self->ent_count; i++, ent++) {
+        if (ent->key != 0 && self->index->by_key[(unsigned char)ent->key] == NULL) {
+            self->index->by_key[(unsigned char)ent->key] = ent;
+        }
+        if (ent->long_name != NULL) {
+            xhint_t it = xh_put(xarg_name, self->index->by_name, ent->long_name, &ret);
+            if (ret < 0) {
+                return ENOMEM;
+            }
+            if (ret > 0) {
+                xh_value(self->index->by_name, it) = ent;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static xargparse_err
+parser_init(xargparse *self, const xargparse_entry *entries,
+            const char *prg_version, const char *bug_addr,
+            const char *prg_doc, const char *args_doc)
 {
     const xargparse_entry *ent_cur;
+    xargparse_err rc;
 
     /* Initialize xargparse context .*/
-    /* ZERO_MEM(self); is somewhat debatable. */
+    ZERO_MEM(self);
     self->arguments = entries;
-    self->max_pos_args = NUM_ELEMS(self->pos_args);
-    self->min_pos_args = 0;
-    self->verbose = false;
+    argp_l0pt_init(self);
+
+    /* Preserve counter of entries passed from the caller. */
+    for (ent_cur = self->arguments; ent_cur->type != 0; ent_cur++) {
+        self->ent_count += 1;
+    }
 
-    for (size_t i = 0; i < self->max_pos_args; i++) {
-        self->pos_args[0] = NULL;
+    rc = argp_l0pt_build(self, prg_version, bug_addr, prg_doc, args_doc);
+    if (rc == 0) {
+        rc = index_build(self);
+    }
+    if (rc != 0) {
+        parser_destroy(self);
     }
 
-    /* Preserve counter of entries passed from the caller. */
-    self->ent_count = 0;
+    return rc;
+}
 
-    ent_cur = self->arguments;
-    for (size_t i = 0; ent_cur->type != 0; i++, ent_cur++) {
-        self->ent_count += 1;
+static xargparse_err
+parse_args(xargparse *self, int argc, char **argv)
+{
+    /* |  ARGP_SILENT | ARGP_IN_ORDER  | ARGP_NO_ERRS */
+    unsigned argp_flags = ARGP_NO_EXIT;
+
+    xargparse_err rc;
+
+    /* Positional arguments are those of the latest parse only. */
+    free_pos_buffers(self);
+    self->pos_args.n = 0;
+    self->npos_args = 0;
+    self->npos_skip = 0;
+
+    rc = parse_native(self, argc, argv);
+    if (rc != NATIVE_FALLBACK) {
+        return rc;
     }
+    self->npos_skip = self->npos_args;
+    self->npos_args = 0;
 
-    ZERO_MEM(&argp_l0pt_desc);
-    argp_l0pt_desc.options = NULL;
-    argp_l0pt_desc.parser = argp_l0pt_cb;
-    argp_l0pt_desc.doc = (prg_doc != NULL) ? prg_doc : program_default_doc;
-    argp_l0pt_desc.args_doc = (args_doc != NULL) ? args_doc : args_default_docs;
-    argp_l0pt_desc.children = NULL;
+    return argp_parse(&self->argp, argc, argv, argp_flags, 0, self);
+}
 
-    if (prg_version != NULL) {
-        argp_program_version = strdup(prg_version);
+/* Count argp's own long options named name, or starting with it if !exact. */
+static int
+count_builtin_names(const xargparse *self, const char *name, size_t len,
+                    bool exact)
+{
+    const char *const builtins[] = {
+        "help", "usage", (self->version != NULL) ? "version" : NULL
+    };
+    int count = 0;
+
+    for (size_t i = 0; i < NUM_ELEMS(builtins); i++) {
+        if (builtins[i] != NULL && strncmp(builtins[i], name, len) == 0 &&
+            (!exact || builtins[i][len] == '\0')) {
+            count++;
+        }
     }
+    return count;
+}
+
+/*
+ * Find the entry of a long option given by its name or, as argp allows, by an
+ * unambiguous prefix of it. Sets *known to whether the option is one at all,
+ * since argp's own options have no entry.
+ */
+static const xargparse_entry *
+find_long_option(const xargparse *self, const char *name, size_t len,
+                 bool *known)
+{
+    const xargparse_entry *ent, *found = NULL;
+    char buf[MAX_LONG_NAME];
+    int count;
 
-    if (bug_addr) {
-        argp_program_bug_address = strdup(bug_addr);
+    *known = false;
+    if (len < sizeof(buf)) {
+        memcpy(buf, name, len);
+        buf[len] = '\0';
+        found = find_name(self, buf);
+        if (found != NULL || count_builtin_names(self, name, len, true) > 0) {
+            *known = true;
+            return found;
+        }
     }
 
-    /* use xargp descriptor as a callback context. */
-    argp_context = (argp_l0pt_ctx *)self;
+    count = count_builtin_names(self, name, len, false);
+    for (uint i = 0; i < self->ent_count; i++) {
+        ent = &self->arguments[i];
+        if (ent->long_name != NULL && strncmp(ent->long_name, name, len) == 0) {
+            /* Entries sharing a name are one option to argp. */
+            if (found == NULL) {
+                found = find_name(self, ent->long_name);
+                count++;
+            } else if (found != find_name(self, ent->long_name)) {
+                count++;
+            }
+        }
+    }
+    *known = (count == 1);
 
-    argp_l0pt_init(argp_context);
+    return *known ? found : NULL;
+}
 
-    return 0;
+/*
+ * Find the command word: the first word that is neither an option nor the
+ * argument of one. Returns argc if there is none, or if an unknown option
+ * comes first: whether it takes an argument cannot be told, and the parse of
+ * the global options reports it anyway.
+ */
+static int
+find_command_word(const xargparse *self, int argc, char **argv)
+{
+    const xargparse_entry *ent;
+    char *word, *eq;
+    bool known;
+
+    for (int i = 1; i < argc; i++) {
+        word = argv[i];
+        if (word[0] != '-' || word[1] == '\0') {
+            return i;
+        }
+        if (word[1] == '-') {
+            if (word[2] == '\0') {
+                return i + 1;
+            }
+            eq = strchr(word + 2, '=');
+            ent = find_long_option(self, word + 2,
+                                   (eq != NULL) ? (size_t)(eq - (word + 2)) : strlen(word + 2),
+                                   &known);
+            if (!known) {
+                return argc;
+            }
+            if (eq != NULL) {
+                continue;
+            }
+        } else {
+            ent = find_key(self, (unsigned char)word[1]);
+            if (ent == NULL && word[1] != '?' &&
+                !(self->version != NULL && word[1] == self->version_key)) {
+                return argc;
+            }
+            if (word[2] != '\0') {
+                continue;
+            }
+        }
+        /* argp's own options take no argument. */
+        if (ent != NULL && !(ent->flags & OPTION_ARG_OPTIONAL)) {
+            i++;
+        }
+    }
+
+    return argc;
 }
 
+/* API implementation */
 xargparse_err xargparse_parse(xargparse *self, int argc, char **argv)
 {
+    struct xargparse_commands *cmds = self->commands;
+    xargparse_command *cmd;
+    char **sub_argv;
+    xhint_t it;
+    int k;
     xargparse_err rc;
-    unsigned argp_flags;
-    unsigned int argp_opt_size;
-    struct argp_option *cur_option;
-    const xargparse_entry *cur_entry;
 
-    /* Create and initialize argp_argp longoptions table. */
-    if (self->ent_count > 0) {
-        argp_opt_size = (self->ent_count + 1) * sizeof(*argp_l0pt_options);
-        argp_l0pt_options = malloc(argp_opt_size);
-        if (argp_l0pt_options == NULL) {
+    if (cmds == NULL) {
+        return parse_args(self, argc, argv);
+    }
+
+    /* Global options up to the command word, then the command's own. */
+    cmds->selected = SIZE_MAX;
+    k = find_command_word(self, argc, argv);
+    rc = parse_args(self, k, argv);
+    if (rc != 0 || k >= argc) {
+        return rc;
+    }
+
+    it = xh_get(xarg_cmd, cmds->by_name, argv[k]);
+    if (it == xh_end(cmds->by_name)) {
+        fprintf(stderr, "%s: unknown command '%s'\n", argv[0], argv[k]);
+        argp_help(&self->argp, stderr, ARGP_HELP_SEE, argv[0]);
+        return EINVAL;
+    }
+
+    cmd = &xv_A(cmds->list, xh_value(cmds->by_name, it));
+    if (cmd->parser == NULL) {
+        const char *prog = strrchr(argv[0], '/');
+        size_t size;
+
+        prog = (prog != NULL) ? prog + 1 : argv[0];
+        size = strlen(prog) + strlen(cmd->name) + 2;
+        cmd->prog_name = malloc(size);
+        cmd->parser = xargparse_new(cmd->entries, NULL, NULL, cmd->doc, cmd->args_doc);
+        if (cmd->prog_name == NULL || cmd->parser == NULL) {
+            SAFE_FREE(cmd->prog_name);
+            xargparse_free(cmd->parser);
+            cmd->parser = NULL;
             return ENOMEM;
         }
-        memset(argp_l0pt_options,0,argp_opt_size);
-
-        /* Replicate our entries. */
-        cur_option = argp_l0pt_options;
-        cur_entry = self->arguments;
-        for (size_t i = 0; i < self->ent_count; i++, cur_option++, cur_entry++) {
-            cur_option->key = cur_entry->key;
-            cur_option->name = cur_entry->long_name;
-            cur_option->arg = cur_entry->long_name;
-            /* Do we need OPTION_ flags beyond OPTION_ARG_OPTIONAL. */
-            cur_option->flags = cur_entry->flags;
-            cur_option->doc = NULL;
-            cur_option->group = 0;
-        }
-        /* Final entry must be terminating one (key = 0, name=''). */
-        cur_option->key = 0;
-        cur_option->name = NULL;
+        snprintf(cmd->prog_name, size, "%s %s", prog, cmd->name);
     }
-    /* Link options descriptor to the options table*/
-    argp_l0pt_desc.options = argp_l0pt_options;
-    /* |  ARGP_SILENT | ARGP_IN_ORDER  | ARGP_NO_ERRS */
-    argp_flags = ARGP_NO_EXIT;
-
-    rc = argp_parse(&argp_l0pt_desc, argc, argv, argp_flags, 0, argp_context);
+    /* The callback and settings may have changed since the last parse. */
+    xargparse_set_pos_callback(cmd->parser, self->pos_cb, self->pos_cb_ctx);
+    xargparse_set_response_files(cmd->parser, self->response_files);
+    cmds->selected = xh_value(cmds->by_name, it);
 
-    /* Free up options table*/
-    if (argp_l0pt_options != NULL) {
-        free(argp_l0pt_options);
-        argp_l0pt_options = NULL;
+    /*
+     * argp names the program after argv[0] and permutes the words it parses,
+     * so the command gets a copy of its part of the command line.
+     */
+    sub_argv = malloc((argc - k + 1) * sizeof(*sub_argv));
+    if (sub_argv == NULL) {
+        return ENOMEM;
     }
+    sub_argv[0] = cmd->prog_name;
+    memcpy(sub_argv + 1, argv + k + 1, (argc - k - 1) * sizeof(*sub_argv));
+    sub_argv[argc - k] = NULL;
+    rc = parse_args(cmd->parser, argc - k, sub_argv);
+    free(sub_argv);
 
     return rc;
 }
 
-xargparse_err xargparse_destroy(xargparse *self)
+/* List the commands after the program doc in --help. */
+static char *
+help_filter(int key, const char *text, void *input)
 {
-    /* Free argp table. */
-    for (uint i = 0; i < self->npos_args; i++) {
-        self->pos_args[i] = NULL;
+    const xargparse *self = input;
+    const xargparse_command *cmd;
+    char *doc;
+    size_t len, size;
+
+    if (key != ARGP_KEY_HELP_PRE_DOC || self == NULL || self->commands == NULL) {
+        return (char *)text;
+    }
+
+    size = strlen(text) + sizeof("\n\nCommands:");
+    for (size_t i = 0; i < xv_size(self->commands->list); i++) {
+        cmd = &xv_A(self->commands->list, i);
+        size += strlen(cmd->name) + ((cmd->doc != NULL) ? strlen(cmd->doc) : 0) + 24;
+    }
+    doc = malloc(size);
+    if (doc == NULL) {
+        return (char *)text;
+    }
+
+    len = snprintf(doc, size, "%s\n\nCommands:", text);
+    for (size_t i = 0; i < xv_size(self->commands->list); i++) {
+        cmd = &xv_A(self->commands->list, i);
+        len += snprintf(doc + len, size - len, "\n  %-20s %s", cmd->name,
+                        (cmd->doc != NULL) ? cmd->doc : "");
+    }
+
+    return doc;
+}
+
+xargparse_err xargparse_add_command(xargparse *self, const char *name,
+                                    const xargparse_entry *entries,
+                                    const char *doc, const char *args_doc)
+{
+    struct xargparse_commands *cmds = self->commands;
+    xargparse_command *cmd;
+    xhint_t it;
+    int ret;
+
+    if (cmds == NULL) {
+        cmds = calloc(1, sizeof(*cmds));
+        if (cmds == NULL) {
+            return ENOMEM;
+        }
+        cmds->by_name = xh_init(xarg_cmd);
+        if (cmds->by_name == NULL) {
+            free(cmds);
+            return ENOMEM;
+        }
+        cmds->selected = SIZE_MAX;
+        self->commands = cmds;
+        self->argp.help_filter = help_filter;
+        if (self->argp.args_doc == args_default_docs) {
+            self->argp.args_doc = commands_default_docs;
+        }
     }
-    self->npos_args = 0;
 
-    SAFE_FREE(argp_program_version);
-    SAFE_FREE(argp_program_bug_address);
+    it = xh_put(xarg_cmd, cmds->by_name, name, &ret);
+    if (ret < 0) {
+        return ENOMEM;
+    }
+    if (ret == 0) {
+        return EEXIST;
+    }
+    xh_value(cmds->by_name, it) = xv_size(cmds->list);
+
+    cmd = xv_pushp(xargparse_command, cmds->list);
+    cmd->name = name;
+    cmd->doc = doc;
+    cmd->args_doc = args_doc;
+    cmd->entries = entries;
+    cmd->parser = NULL;
+    cmd->prog_name = NULL;
 
     return 0;
 }
+
+const char *xargparse_command_name(const xargparse *self)
+{
+    const struct xargparse_commands *cmds = self->commands;
+
+    if (cmds == NULL || cmds->selected == SIZE_MAX) {
+        return NULL;
+    }
+    return xv_A(cmds->list, cmds->selected).name;
+}
+
+xargparse *xargparse_command_parser(const xargparse *self)
+{
+    const struct xargparse_commands *cmds = self->commands;
+
+    if (cmds == NULL || cmds->selected == SIZE_MAX) {
+        return NULL;
+    }
+    return xv_A(cmds->list, cmds->selected).parser;
+}
+
+static void
+parser_destroy(xargparse *self)
+{
+    free_pos_buffers(self);
+    xv_destroy(self->pos_args);
+    xv_destroy(self->pos_buffers);
+    xv_init(self->pos_args);
+    xv_init(self->pos_buffers);
+    self->npos_args = 0;
+
+    /* Free argp description. */
+    SAFE_FREE(self->options);
+    SAFE_FREE(self->version);
+    SAFE_FREE(self->doc);
+    ZERO_MEM(&self->argp);
+    if (self->index != NULL) {
+        xh_destroy(xarg_name, self->index->by_name);
+        SAFE_FREE(self->index);
+    }
+    if (self->commands != NULL) {
+        for (size_t i = 0; i < xv_size(self->commands->list); i++) {
+            xargparse_free(xv_A(self->commands->list, i).parser);
+            free(xv_A(self->commands->list, i).prog_name);
+        }
+        xv_destroy(self->commands->list);
+        xh_destroy(xarg_cmd, self->commands->by_name);
+        SAFE_FREE(self->commands);
+    }
+}
+
+xargparse *xargparse_new(const xargparse_entry *entries,
+                         const char *prg_version, const char *bug_addr,
+                         const char *prg_doc, const char *args_doc)
+{
+    xargparse *self = malloc(sizeof(*self));
+
+    if (self == NULL) {
+        return NULL;
+    }
+    if (parser_init(self, entries, prg_version, bug_addr, prg_doc, args_doc) != 0) {
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void xargparse_free(xargparse *self)
+{
+    if (self != NULL) {
+        parser_destroy(self);
+        free(self);
+    }
+}
+
+xargparse_err xargparse_set(xargparse *self, const char *name, const char *value)
+{
+    const xargparse_entry *ent = find_name(self, name);
+
+    if (ent == NULL) {
+        return ENOENT;
+    }
+    return parse_xargument(self, ent, value);
+}
+
+unsigned int xargparse_npos(const xargparse *self)
+{
+    return self->npos_args;
+}
+
+const char *xargparse_pos(const xargparse *self, unsigned int i)
+{
+    return (i < xv_size(self->pos_args)) ? xv_A(self->pos_args, i) : NULL;
+}
+
+void xargparse_set_pos_limits(xargparse *self, unsigned int min, unsigned int max)
+{
+    self->min_pos_args = min;
+    self->max_pos_args = max;
+}
+
+bool xargparse_verbose(const xargparse *self)
+{
+    return self->verbose;
+}
+
+void xargparse_set_pos_callback(xargparse *self, xargparse_pos_cb *cb, void *ctx)
+{
+    self->pos_cb = cb;
+    self->pos_cb_ctx = ctx;
+}
+
+void xargparse_set_response_files(xargparse *self, bool enable)
+{
+    self->response_files = enable;
+}
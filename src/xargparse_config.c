@@ -0,0 +1,243 @@
+/**
+ * @file      xargparse_config.c
+ * @brief     Configuration file and environment sources of xargparse.
+ *
+ *  The file is mapped privately and parsed in one pass: lines are split with
+ *  memchr and values are terminated in place, so nothing is allocated per
+ *  line. Option names are looked up through the index of the parser.
+ *
+ * @copyright Copyright (C) 2017 Xevo Inc. All Rights Reserved.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <xlib/xargparse.h>
+
+/* Longest option name, including a section prefix. */
+#define MAX_NAME    128
+
+extern char **environ;
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void report(const char *source, size_t line, const char *name,
+                   const char *value, xargparse_err rc)
+{
+    if (rc == ENOENT) {
+        fprintf(stderr, "%s:%zu: unknown option '%s'\n", source, line, name);
+    }
+    else if (rc == ERANGE) {
+        fprintf(stderr, "%s:%zu: value '%s' of option '%s' is out of range\n",
+                source, line, value, name);
+    }
+    else {
+        fprintf(stderr, "%s:%zu: invalid value '%s' for option '%s'\n",
+                source, line, value, name);
+    }
+}
+
+/*
+ * Parse the configuration in data[0, size). Values are terminated in place,
+ * which needs data[size] to be writable when the last line has no newline.
+ */
+static xargparse_err parse_config(xargparse *self, const char *path,
+                                  char *data, size_t size)
+{
+    char *end = data + size;
+    char *p, *e, *next, *eq, *key_end, *value;
+    char name[MAX_NAME];
+    size_t section_len = 0, key_len, line = 0;
+    xargparse_err rc, first = 0;
+
+    for (p = data; p < end; p = next) {
+        line++;
+        e = memchr(p, '\n', end - p);
+        if (e == NULL) {
+            e = end;
+        }
+        next = e + 1;
+
+        while (p < e && is_blank(*p)) {
+            p++;
+        }
+        while (e > p && is_blank(e[-1])) {
+            e--;
+        }
+        if (p == e || *p == '#' || *p == ';') {
+            continue;
+        }
+
+        if (*p == '[') {
+            section_len = e - p - 2;
+            if (e - p < 2 || e[-1] != ']' || section_len + 1 >= sizeof(name)) {
+                fprintf(stderr, "%s:%zu: malformed section\n", path, line);
+                first = first ? first : EINVAL;
+                section_len = 0;
+                continue;
+            }
+            memcpy(name, p + 1, section_len);
+            if (section_len > 0) {
+                name[section_len++] = '-';
+            }
+            continue;
+        }
+
+        eq = memchr(p, '=', e - p);
+        if (eq == NULL) {
+            fprintf(stderr, "%s:%zu: expected 'name = value'\n", path, line);
+            first = first ? first : EINVAL;
+            continue;
+        }
+
+        for (key_end = eq; key_end > p && is_blank(key_end[-1]); key_end--) {
+        }
+        key_len = key_end - p;
+        if (key_len == 0 || section_len + key_len >= sizeof(name)) {
+            fprintf(stderr, "%s:%zu: bad option name\n", path, line);
+            first = first ? first : EINVAL;
+            continue;
+        }
+        memcpy(name + section_len, p, key_len);
+        name[section_len + key_len] = '\0';
+
+        for (value = eq + 1; value < e && is_blank(*value); value++) {
+        }
+        if (e - value >= 2 && (*value == '"' || *value == '\'') && e[-1] == *value) {
+            value++;
+            e--;
+        }
+        *e = '\0';
+
+        rc = xargparse_set(self, name, value);
+        if (rc != 0) {
+            report(path, line, name, value, rc);
+            first = first ? first : rc;
+        }
+    }
+
+    return first;
+}
+
+xargparse_err xargparse_load_file(xargparse *self, const char *path)
+{
+    struct stat st;
+    size_t size;
+    char *data;
+    bool mapped;
+    int fd;
+    xargparse_err rc;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, &st) != 0) {
+        rc = errno;
+        close(fd);
+        return rc;
+    }
+    size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    /*
+     * A private writable mapping lets values be terminated in place. The
+     * bytes after the end of the file up to the end of its last page are
+     * zero and writable, so the last line only needs a copy when the file
+     * fills that page exactly and does not end with a newline.
+     */
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    mapped = (data != MAP_FAILED);
+    if (mapped && size % (size_t) sysconf(_SC_PAGESIZE) == 0 && data[size - 1] != '\n') {
+        munmap(data, size);
+        mapped = false;
+    }
+
+    if (!mapped) {
+        data = malloc(size + 1);
+        if (data == NULL) {
+            close(fd);
+            return ENOMEM;
+        }
+        for (size_t off = 0; off < size; ) {
+            ssize_t n = pread(fd, data + off, size - off, off);
+            if (n <= 0) {
+                rc = (n < 0) ? errno : EIO;
+                free(data);
+                close(fd);
+                return rc;
+            }
+            off += n;
+        }
+        data[size] = '\0';
+    }
+    close(fd);
+
+    rc = parse_config(self, path, data, size);
+
+    if (mapped) {
+        munmap(data, size);
+    }
+    else {
+        free(data);
+    }
+
+    return rc;
+}
+
+xargparse_err xargparse_load_env(xargparse *self, const char *prefix)
+{
+    size_t prefix_len = strlen(prefix);
+    char name[MAX_NAME];
+    const char *var, *eq, *value;
+    size_t len;
+    xargparse_err rc, first = 0;
+
+    for (char **env = environ; *env != NULL; env++) {
+        var = *env;
+        if (strncmp(var, prefix, prefix_len) != 0 || var[prefix_len] != '_') {
+            continue;
+        }
+        var += prefix_len + 1;
+        eq = strchr(var, '=');
+        if (eq == NULL || (len = eq - var) == 0 || len >= sizeof(name)) {
+            continue;
+        }
+        value = eq + 1;
+
+        for (size_t i = 0; i < len; i++) {
+            char c = var[i];
+            name[i] = (c == '_') ? '-' : (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+        }
+        name[len] = '\0';
+
+        rc = xargparse_set(self, name, value);
+        if (rc == ENOENT) {
+            continue;
+        }
+        if (rc != 0) {
+            fprintf(stderr, "environment: %.*s: %s '%s'\n",
+                    (int) (eq - *env), *env,
+                    (rc == ERANGE) ? "value out of range" : "invalid value", value);
+            first = first ? first : rc;
+        }
+    }
+
+    return first;
+}
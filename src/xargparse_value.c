@@ -0,0 +1,401 @@
+/**
+ * @file      xargparse_value.c
+ * @brief     Strict value parsers of xargparse.
+ *
+ *  The parsers accept exactly one value spanning the whole string, check the
+ *  range of the destination type and do not depend on the locale. Integers
+ *  are accumulated by hand; doubles take a fast exact path when the decimal
+ *  mantissa and power of ten are both exactly representable, and otherwise
+ *  go through strtod_l in the C locale once the syntax has been checked.
+ *
+ * @copyright Copyright (C) 2017 Xevo Inc. All Rights Reserved.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <xlib/xargparse.h>
+
+/* Decimal digits that always fit an uint64_t. */
+#define MAX_FAST_DIGITS     19
+
+/* Exponents beyond this saturate; they overflow or underflow any double. */
+#define MAX_EXPONENT        100000
+
+/* Powers of ten exactly representable as doubles. */
+static const double s_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static pthread_once_t s_c_locale_once = PTHREAD_ONCE_INIT;
+static locale_t s_c_locale;
+
+static void c_locale_init(void)
+{
+    s_c_locale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+}
+
+static inline int digit_value(char c, unsigned int base)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+/*
+ * Scan decimal or 0x hexadecimal digits, advancing *sp past all of them.
+ * Returns EINVAL if there are none and ERANGE if the value exceeds max; the
+ * caller checks what follows first, so that trailing garbage is reported as
+ * EINVAL rather than ERANGE.
+ */
+static int scan_uint(const char **sp, uint64_t max, uint64_t *out)
+{
+    const char *s = *sp;
+    const char *start;
+    unsigned int base = 10;
+    uint64_t v = 0;
+    bool overflow = false;
+    int d;
+
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+
+    for (start = s; (d = digit_value(*s, base)) >= 0; s++) {
+        if (v > (max - d) / base) {
+            overflow = true;
+        }
+        else {
+            v = v * base + d;
+        }
+    }
+
+    *sp = s;
+    if (s == start) {
+        return EINVAL;
+    }
+    if (overflow) {
+        return ERANGE;
+    }
+    *out = v;
+    return 0;
+}
+
+static int parse_signed(const char *s, int64_t min, int64_t max, int64_t *out)
+{
+    bool neg = false;
+    uint64_t v = 0;
+    int rc;
+
+    if (*s == '+' || *s == '-') {
+        neg = (*s == '-');
+        s++;
+    }
+
+    rc = scan_uint(&s, neg ? (uint64_t) -(min + 1) + 1 : (uint64_t) max, &v);
+    if (rc == EINVAL || *s != '\0') {
+        return EINVAL;
+    }
+    if (rc != 0) {
+        return rc;
+    }
+
+    *out = (neg && v != 0) ? -(int64_t) (v - 1) - 1 : (int64_t) v;
+    return 0;
+}
+
+static int parse_unsigned(const char *s, uint64_t max, uint64_t *out)
+{
+    int rc;
+
+    if (*s == '+') {
+        s++;
+    }
+
+    rc = scan_uint(&s, max, out);
+    if (rc == EINVAL || *s != '\0') {
+        return EINVAL;
+    }
+    return rc;
+}
+
+int xargparse_parse_bool(const char *s, bool *out)
+{
+    if (!strcasecmp(s, "true") || !strcmp(s, "1") ||
+        !strcasecmp(s, "yes") || !strcasecmp(s, "on")) {
+        *out = true;
+    }
+    else if (!strcasecmp(s, "false") || !strcmp(s, "0") ||
+             !strcasecmp(s, "no") || !strcasecmp(s, "off")) {
+        *out = false;
+    }
+    else {
+        return EINVAL;
+    }
+    return 0;
+}
+
+int xargparse_parse_int(const char *s, int *out)
+{
+    int64_t v;
+    int rc = parse_signed(s, INT_MIN, INT_MAX, &v);
+
+    if (rc == 0) {
+        *out = (int) v;
+    }
+    return rc;
+}
+
+int xargparse_parse_uint(const char *s, unsigned int *out)
+{
+    uint64_t v;
+    int rc = parse_unsigned(s, UINT_MAX, &v);
+
+    if (rc == 0) {
+        *out = (unsigned int) v;
+    }
+    return rc;
+}
+
+int xargparse_parse_int64(const char *s, int64_t *out)
+{
+    return parse_signed(s, INT64_MIN, INT64_MAX, out);
+}
+
+int xargparse_parse_double(const char *s, double *out)
+{
+    const char *p = s;
+    bool neg = false, any = false, inexact = false, eneg = false;
+    uint64_t mant = 0;
+    int ndigits = 0;
+    long exp10 = 0, e = 0;
+    double v;
+
+    if (*p == '+' || *p == '-') {
+        neg = (*p == '-');
+        p++;
+    }
+
+    if (!strcasecmp(p, "inf") || !strcasecmp(p, "infinity")) {
+        *out = neg ? -INFINITY : INFINITY;
+        return 0;
+    }
+    if (!strcasecmp(p, "nan")) {
+        *out = neg ? -NAN : NAN;
+        return 0;
+    }
+
+    /* Keep the first significant digits; the others only scale or round. */
+    for (; *p >= '0' && *p <= '9'; p++) {
+        any = true;
+        if (ndigits < MAX_FAST_DIGITS) {
+            mant = mant * 10 + (*p - '0');
+            ndigits += (mant != 0);
+        }
+        else {
+            exp10++;
+            inexact |= (*p != '0');
+        }
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            if (ndigits < MAX_FAST_DIGITS) {
+                mant = mant * 10 + (*p - '0');
+                ndigits += (mant != 0);
+                exp10--;
+            }
+            else {
+                inexact |= (*p != '0');
+            }
+        }
+    }
+    if (!any) {
+        return EINVAL;
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') {
+            eneg = (*p == '-');
+            p++;
+        }
+        if (*p < '0' || *p > '9') {
+            return EINVAL;
+        }
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (e < MAX_EXPONENT) {
+                e = e * 10 + (*p - '0');
+            }
+        }
+        exp10 += eneg ? -e : e;
+    }
+    if (*p != '\0') {
+        return EINVAL;
+    }
+
+    if (mant == 0) {
+        v = 0.0;
+    }
+    else if (!inexact && mant <= (UINT64_C(1) << 53) &&
+             exp10 >= -22 && exp10 <= 22) {
+        /* Both operands are exact, so the single rounding is correct. */
+        v = (double) mant;
+        v = (exp10 < 0) ? v / s_pow10[-exp10] : v * s_pow10[exp10];
+    }
+    else {
+        pthread_once(&s_c_locale_once, c_locale_init);
+        if (s_c_locale == (locale_t) 0) {
+            return ENOMEM;
+        }
+        /* The syntax is checked, so strtod_l consumes the whole string. */
+        v = fabs(strtod_l(s, NULL, s_c_locale));
+        if (isinf(v) || v == 0.0) {
+            return ERANGE;
+        }
+    }
+
+    *out = neg ? -v : v;
+    return 0;
+}
+
+int xargparse_parse_size(const char *s, size_t *out)
+{
+    uint64_t v, mult = 1;
+    int rc;
+
+    if (*s == '+') {
+        s++;
+    }
+
+    rc = scan_uint(&s, SIZE_MAX, &v);
+    if (rc == EINVAL) {
+        return EINVAL;
+    }
+
+    switch (*s) {
+    case 'k': case 'K': mult = UINT64_C(1) << 10; break;
+    case 'm': case 'M': mult = UINT64_C(1) << 20; break;
+    case 'g': case 'G': mult = UINT64_C(1) << 30; break;
+    case 't': case 'T': mult = UINT64_C(1) << 40; break;
+    case 'p': case 'P': mult = UINT64_C(1) << 50; break;
+    default: break;
+    }
+    if (mult != 1) {
+        s++;
+        if (*s == 'i') {
+            s++;
+        }
+    }
+    if (*s == 'B') {
+        s++;
+    }
+    if (*s != '\0') {
+        return EINVAL;
+    }
+    if (rc != 0 || v > SIZE_MAX / mult) {
+        return ERANGE;
+    }
+
+    *out = (size_t) (v * mult);
+    return 0;
+}
+
+/* Nanoseconds per unit of a duration, 0 if the unit is not known. */
+static uint64_t duration_unit(const char *unit, size_t len)
+{
+    static const struct {
+        const char *name;
+        uint64_t ns;
+    } units[] = {
+        { "ns", UINT64_C(1) },
+        { "us", UINT64_C(1000) },
+        { "ms", UINT64_C(1000000) },
+        { "s", UINT64_C(1000000000) },
+        { "m", UINT64_C(60000000000) },
+        { "h", UINT64_C(3600000000000) },
+        { "d", UINT64_C(86400000000000) },
+    };
+
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        if (strlen(units[i].name) == len && !memcmp(units[i].name, unit, len)) {
+            return units[i].ns;
+        }
+    }
+    return 0;
+}
+
+int xargparse_parse_duration(const char *s, uint64_t *out_ns)
+{
+    const char *unit;
+    uint64_t total = 0, v, ns;
+    bool overflow = false, first = true;
+    int rc;
+
+    if (*s == '+') {
+        s++;
+    }
+
+    do {
+        rc = scan_uint(&s, UINT64_MAX, &v);
+        if (rc == EINVAL) {
+            return EINVAL;
+        }
+        overflow |= (rc != 0);
+
+        for (unit = s; (*s >= 'a' && *s <= 'z'); s++) {
+        }
+        if (s == unit) {
+            /* A plain number of seconds, only as the whole value. */
+            if (!first || *s != '\0') {
+                return EINVAL;
+            }
+            ns = UINT64_C(1000000000);
+        }
+        else if ((ns = duration_unit(unit, s - unit)) == 0) {
+            return EINVAL;
+        }
+
+        if (!overflow && v > (UINT64_MAX - total) / ns) {
+            overflow = true;
+        }
+        if (!overflow) {
+            total += v * ns;
+        }
+        first = false;
+    } while (*s != '\0');
+
+    if (overflow) {
+        return ERANGE;
+    }
+    *out_ns = total;
+    return 0;
+}
+
+int xargparse_parse_enum(const char *s, const char *const *choices, int *out)
+{
+    for (int i = 0; choices != NULL && choices[i] != NULL; i++) {
+        if (!strcmp(s, choices[i])) {
+            *out = i;
+            return 0;
+        }
+    }
+    return EINVAL;
+}
@@ -0,0 +1,499 @@
+/*
+ * Assertion failure handling and crash reports. Everything that runs after a
+ * failure sticks to async-signal-safe functions, so reports also work from
+ * signal handlers and with a corrupted heap.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <xlib/xassert.h>
+#include <xlib/xlog.h>
+
+/* Maximum number of frames in a backtrace. */
+#define XASSERT_BACKTRACE_MAX 64
+
+#define XASSERT_ALTSTACK_SIZE (64 * 1024)
+
+static const int s_crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+static struct sigaction s_prev_actions[sizeof(s_crash_signals) / sizeof(s_crash_signals[0])];
+static char s_crash_file[PATH_MAX];
+static atomic_flag s_reported = ATOMIC_FLAG_INIT;
+
+/* The alternate signal stack of each thread, freed when the thread exits. */
+static _Thread_local void *s_altstack;
+static pthread_key_t s_altstack_key;
+static pthread_once_t s_altstack_once = PTHREAD_ONCE_INIT;
+static int s_altstack_key_err;
+
+static void write_str(int fd, const char *s)
+{
+    size_t len = strlen(s);
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, s, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        s += n;
+        len -= (size_t) n;
+    }
+}
+
+static void write_long(int fd, long v)
+{
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    unsigned long u = (v < 0) ? -(unsigned long) v : (unsigned long) v;
+
+    *--p = '\0';
+    do {
+        *--p = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) {
+        *--p = '-';
+    }
+    write_str(fd, p);
+}
+
+/* Copy a file, e.g. /proc/self/maps, to fd. */
+static void copy_file(int fd, const char *path)
+{
+    char buf[4096];
+    ssize_t n;
+    int in;
+
+    in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return;
+    }
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write(fd, buf, (size_t) n) < 0) {
+            break;
+        }
+    }
+    close(in);
+}
+
+static void write_failure(int fd, const XassertSite *site, int sig)
+{
+    if (site != NULL) {
+        write_str(fd, "Assertion failed: ");
+        write_str(fd, site->expr);
+        write_str(fd, "\nLocation: ");
+        write_str(fd, site->file);
+        write_str(fd, ":");
+        write_long(fd, site->line);
+        write_str(fd, " [");
+        write_str(fd, site->func);
+        write_str(fd, "]\n");
+    }
+    else {
+        write_str(fd, "Fatal signal ");
+        write_long(fd, sig);
+        write_str(fd, " (");
+        write_str(fd, (sig == SIGSEGV) ? "SIGSEGV" :
+                      (sig == SIGBUS) ? "SIGBUS" :
+                      (sig == SIGILL) ? "SIGILL" :
+                      (sig == SIGFPE) ? "SIGFPE" :
+                      (sig == SIGABRT) ? "SIGABRT" : "?");
+        write_str(fd, ")\n");
+    }
+}
+
+/*
+ * Report a failure once: flush xlog, with the signal-safe variant since this
+ * may run in a crash handler, so that queued messages, including the
+ * assertion message, are not lost, then write a backtrace to stderr and the
+ * context report, if any, including detail about the failure if given.
+ */
+static void crash_report(const XassertSite *site, int sig, const char *detail)
+{
+    void *frames[XASSERT_BACKTRACE_MAX];
+    int nframes, fd;
+
+    if (atomic_flag_test_and_set(&s_reported)) {
+        return;
+    }
+
+    xlog_flush_signal_safe();
+
+    nframes = backtrace(frames, XASSERT_BACKTRACE_MAX);
+    if (site == NULL) {
+        write_failure(STDERR_FILENO, site, sig);
+    }
+    write_str(STDERR_FILENO, "Backtrace:\n");
+    backtrace_symbols_fd(frames, nframes, STDERR_FILENO);
+
+    if (s_crash_file[0] == '\0') {
+        return;
+    }
+    fd = open(s_crash_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+
+    write_failure(fd, site, sig);
+    if (detail != NULL) {
+        write_str(fd, detail);
+        write_str(fd, "\n");
+    }
+    write_str(fd, "Process: ");
+    write_long(fd, (long) getpid());
+    write_str(fd, "\nThread: ");
+    write_long(fd, (long) syscall(SYS_gettid));
+    write_str(fd, "\n\nBacktrace:\n");
+    backtrace_symbols_fd(frames, nframes, fd);
+    write_str(fd, "\nMemory map:\n");
+    copy_file(fd, "/proc/self/maps");
+    write_str(fd, "\nRecent log messages:\n");
+    xlog_ring_sink_dump(fd);
+    close(fd);
+}
+
+/* backtrace loads libgcc on first use, which is not safe in a crash. */
+static void preload_backtrace(void)
+{
+    void *frame;
+
+    backtrace(&frame, 1);
+}
+
+int xassert_set_crash_file(const char *path)
+{
+    if (path == NULL) {
+        s_crash_file[0] = '\0';
+        return 0;
+    }
+    if (strlen(path) >= sizeof(s_crash_file)) {
+        return ENAMETOOLONG;
+    }
+    strcpy(s_crash_file, path);
+    preload_backtrace();
+
+    return 0;
+}
+
+static void crash_handler(int sig)
+{
+    crash_report(NULL, sig, NULL);
+
+    /* Let the previous handler, or the default action, take over. */
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        if (s_crash_signals[i] == sig) {
+            sigaction(sig, &s_prev_actions[i], NULL);
+        }
+    }
+    raise(sig);
+}
+
+/* Runs as the thread exits: stop using the stack before unmapping it. */
+static void altstack_destructor(void *stack)
+{
+    stack_t ss;
+
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, NULL);
+    munmap(stack, XASSERT_ALTSTACK_SIZE);
+}
+
+static void create_altstack_key(void)
+{
+    s_altstack_key_err = pthread_key_create(&s_altstack_key, altstack_destructor);
+}
+
+int xassert_thread_init(void)
+{
+    stack_t ss, old;
+    void *stack;
+    int err;
+
+    if (s_altstack != NULL) {
+        return 0;
+    }
+    /* Keep a large enough stack the thread already has, e.g. a sanitizer's. */
+    if (sigaltstack(NULL, &old) == 0 && !(old.ss_flags & SS_DISABLE) &&
+        old.ss_size >= XASSERT_ALTSTACK_SIZE) {
+        return 0;
+    }
+
+    pthread_once(&s_altstack_once, create_altstack_key);
+    if (s_altstack_key_err != 0) {
+        return s_altstack_key_err;
+    }
+
+    /* Not from the heap, which may be what is corrupted when we crash. */
+    stack = mmap(NULL, XASSERT_ALTSTACK_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+        return errno;
+    }
+
+    ss.ss_sp = stack;
+    ss.ss_size = XASSERT_ALTSTACK_SIZE;
+    ss.ss_flags = 0;
+    if (sigaltstack(&ss, NULL) < 0) {
+        err = errno;
+        munmap(stack, XASSERT_ALTSTACK_SIZE);
+        return err;
+    }
+    err = pthread_setspecific(s_altstack_key, stack);
+    if (err != 0) {
+        altstack_destructor(stack);
+        return err;
+    }
+    s_altstack = stack;
+
+    return 0;
+}
+
+int xassert_install_crash_handlers(void)
+{
+    struct sigaction sa;
+    int err;
+
+    preload_backtrace();
+
+    err = xassert_thread_init();
+    if (err != 0) {
+        return err;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = crash_handler;
+    sa.sa_flags = SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        if (sigaction(s_crash_signals[i], &sa, &s_prev_actions[i]) < 0) {
+            return errno;
+        }
+    }
+
+    return 0;
+}
+
+/* Format v in decimal into the end of a buffer, returning the first digit. */
+static char *ull_to_dec(unsigned long long v, char *end)
+{
+    char *p = end;
+
+    do {
+        *--p = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    return p;
+}
+
+/* Append len bytes of s to buf, keeping room for the NUL. */
+static size_t append(char *buf, size_t size, size_t len, const char *s, size_t n)
+{
+    if (n > size - 1 - len) {
+        n = size - 1 - len;
+    }
+    memcpy(buf + len, s, n);
+
+    return len + n;
+}
+
+static size_t format_float(double f, char *buf, size_t size)
+{
+    char tmp[48];
+    char *end = tmp + sizeof(tmp), *p = end;
+    unsigned long long ipart, frac;
+    int exp10 = 0;
+    bool neg = signbit(f);
+
+    if (isnan(f)) {
+        return append(buf, size, 0, "nan", 3);
+    }
+    if (neg) {
+        f = -f;
+    }
+    if (isinf(f)) {
+        return append(buf, size, 0, neg ? "-inf" : "inf", neg ? 4 : 3);
+    }
+
+    /* Beyond 1e18, the integer part does not fit; use the e+N form. */
+    if (f >= 1e18) {
+        while (f >= 10) {
+            f /= 10;
+            ++exp10;
+        }
+    }
+
+    ipart = (unsigned long long) f;
+    frac = (unsigned long long) ((f - (double) ipart) * 1e6 + 0.5);
+    if (frac >= 1000000) {
+        frac -= 1000000;
+        ++ipart;
+    }
+
+    if (exp10 > 0) {
+        p = ull_to_dec((unsigned long long) exp10, p);
+        *--p = '+';
+        *--p = 'e';
+    }
+    for (int i = 0; i < 6; ++i) {
+        *--p = (char) ('0' + frac % 10);
+        frac /= 10;
+    }
+    *--p = '.';
+    p = ull_to_dec(ipart, p);
+    if (neg) {
+        *--p = '-';
+    }
+
+    return append(buf, size, 0, p, (size_t) (end - p));
+}
+
+size_t xassert_format_operand(const XassertOperand *op, char *buf, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    char tmp[32];
+    char *end = tmp + sizeof(tmp), *p;
+    size_t len = 0;
+    uintptr_t addr;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    switch (op->kind) {
+    case XASSERT_OPERAND_INT:
+        p = ull_to_dec(
+            (op->v.i < 0) ? -(unsigned long long) op->v.i : (unsigned long long) op->v.i, end);
+        if (op->v.i < 0) {
+            *--p = '-';
+        }
+        len = append(buf, size, 0, p, (size_t) (end - p));
+        break;
+    case XASSERT_OPERAND_UINT:
+        p = ull_to_dec(op->v.u, end);
+        len = append(buf, size, 0, p, (size_t) (end - p));
+        break;
+    case XASSERT_OPERAND_CHAR:
+        tmp[0] = (char) op->v.i;
+        len = append(buf, size, 0, tmp, 1);
+        break;
+    case XASSERT_OPERAND_FLOAT:
+        len = format_float(op->v.f, buf, size);
+        break;
+    case XASSERT_OPERAND_PTR:
+        if (op->v.p == 0) {
+            len = append(buf, size, 0, "(nil)", 5);
+            break;
+        }
+        addr = op->v.p;
+        p = end;
+        do {
+            *--p = hex[addr & 0xf];
+            addr >>= 4;
+        } while (addr != 0);
+        *--p = 'x';
+        *--p = '0';
+        len = append(buf, size, 0, p, (size_t) (end - p));
+        break;
+    case XASSERT_OPERAND_STR:
+        if (op->v.s == NULL) {
+            len = append(buf, size, 0, "(null)", 6);
+            break;
+        }
+        len = append(buf, size, 0, op->v.s, strlen(op->v.s));
+        break;
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+static void log_failed_expr(const XassertSite *site)
+{
+    _xlog(
+        XLOG_CRIT,
+        true,
+        site->file,
+        site->line,
+        site->func,
+        "Assert: failed expression (%s)",
+        site->expr);
+}
+
+void _xassert_fail(const XassertSite *site)
+{
+    log_failed_expr(site);
+    crash_report(site, SIGABRT, NULL);
+    abort();
+}
+
+void _xassert_fail_fmt(const XassertSite *site, const char *fmt, ...)
+{
+    va_list args;
+
+    log_failed_expr(site);
+
+    va_start(args, fmt);
+    _xlog_va(XLOG_CRIT, false, site->file, site->line, site->func, fmt, args);
+    va_end(args);
+
+    crash_report(site, SIGABRT, NULL);
+    abort();
+}
+
+void _xassert_fail_ops(const XassertSite *site, XassertOperand x, XassertOperand y)
+{
+    char msg[512];
+    size_t len;
+
+    /* In C, character constants are ints; show them as characters too. */
+    if (x.kind == XASSERT_OPERAND_CHAR && y.kind == XASSERT_OPERAND_INT &&
+        y.v.i >= CHAR_MIN && y.v.i <= CHAR_MAX) {
+        y.kind = XASSERT_OPERAND_CHAR;
+    }
+    else if (y.kind == XASSERT_OPERAND_CHAR && x.kind == XASSERT_OPERAND_INT &&
+             x.v.i >= CHAR_MIN && x.v.i <= CHAR_MAX) {
+        x.kind = XASSERT_OPERAND_CHAR;
+    }
+
+    len = append(msg, sizeof(msg), 0, "LHS: ", 5);
+    /* Leave room for the right operand after a long string. */
+    len += xassert_format_operand(&x, msg + len, sizeof(msg) / 2 - len);
+    len = append(msg, sizeof(msg), len, "\nRHS: ", 6);
+    len += xassert_format_operand(&y, msg + len, sizeof(msg) - len);
+    msg[len] = '\0';
+
+    log_failed_expr(site);
+    _xlog(XLOG_CRIT, false, site->file, site->line, site->func, "%s", msg);
+    crash_report(site, SIGABRT, msg);
+    abort();
+}
+
+void _xassert_fail_extra(const XassertSite *site, const char *extra)
+{
+    log_failed_expr(site);
+    _xlog(XLOG_CRIT, false, site->file, site->line, site->func, "%s", extra);
+    crash_report(site, SIGABRT, extra);
+    abort();
+}
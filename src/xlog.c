@@ -1,5 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 #include <xlib/xassert.h>
 #include <xlib/xlog.h>
+#include <xlib/xvec.h>
 
 void xlog_default_func(
     XlogPriority priority,
@@ -12,6 +23,11 @@ void xlog_default_func(
 {
     FILE *dst;
 
+    if (xlog_get_log_format() != XLOG_FORMAT_TEXT) {
+        xlog_structured_func(priority, print_loc, file, line, func, fmt, args);
+        return;
+    }
+
     if (priority <= XLOG_WARNING) {
         dst = stderr;
     }
@@ -26,7 +42,7 @@ void xlog_default_func(
     fputc('\n', dst);
 }
 
-static XlogPriority s_priority = XLOG_WARNING;
+int _xlog_priority = XLOG_WARNING;
 static XlogFunc s_log_func = xlog_default_func;
 
 void xlog_set_log_priority(XlogPriority priority)
@@ -34,17 +50,104 @@ void xlog_set_log_priority(XlogPriority priority)
     XASSERT_GTE(priority, XLOG_EMERG);
     XASSERT_LTE(priority, XLOG_DEBUG);
 
-    s_priority = priority;
+    __atomic_store_n(&_xlog_priority, priority, __ATOMIC_RELAXED);
 }
 
 void xlog_set_log_func(XlogFunc func)
 {
-    s_log_func = func;
+    __atomic_store_n(&s_log_func, func, __ATOMIC_RELEASE);
+}
+
+XlogFunc xlog_get_log_func(void)
+{
+    return __atomic_load_n(&s_log_func, __ATOMIC_ACQUIRE);
 }
 
 bool xlog_enabled(XlogPriority priority)
 {
-    return priority <= s_priority;
+    return (int) priority <= __atomic_load_n(&_xlog_priority, __ATOMIC_RELAXED);
+}
+
+/*
+ * Time of the message being logged by each thread. It is read from the clocks
+ * on the first xlog_time call of each message, so that messages whose log
+ * function does not print it cost no clock read, and sinks share one reading.
+ */
+static _Thread_local XlogTime s_time;
+static _Thread_local enum {
+    TIME_NO_MESSAGE,
+    TIME_UNREAD,
+    TIME_READ
+} s_time_state;
+static bool s_coarse_clock;
+
+/* Date and time of the last second formatted by this thread. */
+static _Thread_local struct {
+    time_t sec;
+    char text[20];
+} s_date_cache = { -1, "" };
+
+void xlog_set_coarse_clock(bool coarse)
+{
+    __atomic_store_n(&s_coarse_clock, coarse, __ATOMIC_RELAXED);
+}
+
+static void read_clocks(XlogTime *t)
+{
+#if defined(CLOCK_MONOTONIC_COARSE) && defined(CLOCK_REALTIME_COARSE)
+    if (__atomic_load_n(&s_coarse_clock, __ATOMIC_RELAXED)) {
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &t->mono);
+        clock_gettime(CLOCK_REALTIME_COARSE, &t->real);
+        return;
+    }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &t->mono);
+    clock_gettime(CLOCK_REALTIME, &t->real);
+}
+
+void _xlog_begin(void)
+{
+    s_time_state = TIME_UNREAD;
+}
+
+void _xlog_end(void)
+{
+    s_time_state = TIME_NO_MESSAGE;
+}
+
+const XlogTime *xlog_time(void)
+{
+    if (s_time_state != TIME_READ) {
+        read_clocks(&s_time);
+        if (s_time_state == TIME_UNREAD) {
+            s_time_state = TIME_READ;
+        }
+    }
+
+    return &s_time;
+}
+
+size_t xlog_time_prefix(const XlogTime *t, char *buf)
+{
+    struct tm tm;
+    long usec = t->real.tv_nsec / 1000;
+
+    if (t->real.tv_sec != s_date_cache.sec) {
+        localtime_r(&t->real.tv_sec, &tm);
+        strftime(s_date_cache.text, sizeof(s_date_cache.text), "%Y-%m-%d %H:%M:%S", &tm);
+        s_date_cache.sec = t->real.tv_sec;
+    }
+
+    memcpy(buf, s_date_cache.text, 19);
+    buf[19] = '.';
+    for (int i = 25; i > 19; --i) {
+        buf[i] = (char) ('0' + usec % 10);
+        usec /= 10;
+    }
+    buf[26] = '\0';
+
+    return XLOG_TIME_PREFIX_LEN;
 }
 
 /*
@@ -66,7 +169,9 @@ void _xlog_va(
         return;
     }
 
-    s_log_func(priority, print_loc, file, line, func, fmt, args);
+    _xlog_begin();
+    xlog_get_log_func()(priority, print_loc, file, line, func, fmt, args);
+    _xlog_end();
 }
 
 void _xlog(
@@ -84,7 +189,486 @@ void _xlog(
         return;
     }
 
+    _xlog_begin();
     va_start(args, fmt);
-    s_log_func(priority, print_loc, file, line, func, fmt, args);
+    xlog_get_log_func()(priority, print_loc, file, line, func, fmt, args);
     va_end(args);
+    _xlog_end();
+}
+
+void _xlog_cat(
+    const XlogCategory *cat,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    ...)
+{
+    va_list args;
+
+    if ((int) priority > _xlog_cat_priority(cat)) {
+        return;
+    }
+
+    _xlog_begin();
+    va_start(args, fmt);
+    xlog_get_log_func()(priority, print_loc, file, line, func, fmt, args);
+    va_end(args);
+    _xlog_end();
+}
+
+/*
+ * Per-site rate limiting uses GCRA, the token bucket expressed as the
+ * theoretical arrival time (TAT) of the next message: each message pushes the
+ * TAT one emission interval further, and a message is allowed as long as the
+ * TAT stays less than a burst of intervals ahead of now.
+ */
+static uint64_t s_rl_interval_ns = 1000000000 / 100;
+static uint64_t s_rl_burst = 100;
+
+/*
+ * Sites that dropped messages, for xlog_rl_flush. Sites are static, so they
+ * are only ever added, with a lock-free push.
+ */
+static XlogSite *s_rl_sites;
+static pthread_once_t s_rl_atexit_once = PTHREAD_ONCE_INIT;
+
+void xlog_set_rate_limit(unsigned int rate, unsigned int burst)
+{
+    XASSERT_GTE(burst, 1);
+
+    __atomic_store_n(&s_rl_interval_ns, (rate > 0) ? 1000000000 / rate : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s_rl_burst, burst, __ATOMIC_RELAXED);
+}
+
+static uint64_t coarse_now_ns(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static bool site_admit(XlogSite *site)
+{
+    uint64_t interval = __atomic_load_n(&s_rl_interval_ns, __ATOMIC_RELAXED);
+    uint64_t limit, now, tat, next;
+
+    if (interval == 0) {
+        return true;
+    }
+
+    limit = interval * __atomic_load_n(&s_rl_burst, __ATOMIC_RELAXED);
+    now = coarse_now_ns();
+    tat = __atomic_load_n(&site->tat, __ATOMIC_RELAXED);
+    do {
+        next = ((tat > now) ? tat : now) + interval;
+        if (next - now > limit) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(
+        &site->tat, &tat, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+void xlog_rl_flush(void)
+{
+    size_t suppressed;
+
+    for (XlogSite *site = __atomic_load_n(&s_rl_sites, __ATOMIC_ACQUIRE);
+         site != NULL; site = site->next) {
+        suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed > 0) {
+            _xlog(site->priority, site->print_loc, site->file, site->line, site->func,
+                  "message repeated %zu times (rate limited)", suppressed);
+        }
+    }
+}
+
+/* Also write out messages queued by the async backend and the sinks. */
+static void rl_flush_at_exit(void)
+{
+    xlog_flush();
+}
+
+static void register_rl_atexit(void)
+{
+    atexit(rl_flush_at_exit);
+}
+
+/* Count a dropped message, listing the site on its first one. */
+static void site_suppress(
+    XlogSite *site,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func)
+{
+    XlogSite *head;
+
+    __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&site->listed, __ATOMIC_RELAXED) ||
+        __atomic_exchange_n(&site->listed, true, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    site->priority = priority;
+    site->print_loc = print_loc;
+    site->file = file;
+    site->line = line;
+    site->func = func;
+    head = __atomic_load_n(&s_rl_sites, __ATOMIC_RELAXED);
+    do {
+        site->next = head;
+    } while (!__atomic_compare_exchange_n(
+        &s_rl_sites, &head, site, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    pthread_once(&s_rl_atexit_once, register_rl_atexit);
+}
+
+void _xlog_rl(
+    XlogSite *site,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    ...)
+{
+    va_list args;
+    size_t suppressed;
+
+    if (!xlog_enabled(priority)) {
+        return;
+    }
+    if (!site_admit(site)) {
+        site_suppress(site, priority, print_loc, file, line, func);
+        return;
+    }
+
+    suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+    if (suppressed > 0) {
+        _xlog(priority, print_loc, file, line, func,
+              "message repeated %zu times (rate limited)", suppressed);
+    }
+
+    _xlog_begin();
+    va_start(args, fmt);
+    xlog_get_log_func()(priority, print_loc, file, line, func, fmt, args);
+    va_end(args);
+    _xlog_end();
+}
+
+/*
+ * Categories and runtime configuration. The category list and the pending
+ * configuration are protected by s_config_lock; priorities themselves are
+ * read and written atomically, so logging never takes the lock.
+ */
+
+typedef struct {
+    char *name;
+    int priority;
+} XlogCategoryConfig;
+
+static pthread_mutex_t s_config_lock = PTHREAD_MUTEX_INITIALIZER;
+static XlogCategory *s_categories;
+static xvec_t(XlogCategoryConfig) s_category_config;
+
+static const char * const s_priority_names[] = {
+    "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+const char *xlog_priority_name(XlogPriority priority)
+{
+    XASSERT_GTE(priority, XLOG_EMERG);
+    XASSERT_LTE(priority, XLOG_DEBUG);
+
+    return s_priority_names[priority];
+}
+
+/* Parse a priority name or number; -1 means "default". */
+static bool parse_priority(const char *s, size_t len, int *priority)
+{
+    char *end;
+    long value;
+
+    if (len == 7 && strncmp(s, "default", len) == 0) {
+        *priority = -1;
+        return true;
+    }
+    if ((len == 5 && strncmp(s, "error", len) == 0) ||
+        (len == 4 && strncmp(s, "warn", len) == 0)) {
+        *priority = (s[0] == 'e') ? XLOG_ERR : XLOG_WARNING;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(s_priority_names) / sizeof(s_priority_names[0]); ++i) {
+        if (strlen(s_priority_names[i]) == len && strncmp(s, s_priority_names[i], len) == 0) {
+            *priority = (int) i;
+            return true;
+        }
+    }
+
+    /* strtol would skip whitespace and take an empty value as 0. */
+    if (len == 0 || s[0] < '0' || s[0] > '9') {
+        return false;
+    }
+    value = strtol(s, &end, 10);
+    if (end != s + len || value < XLOG_EMERG || value > XLOG_DEBUG) {
+        return false;
+    }
+    *priority = (int) value;
+
+    return true;
+}
+
+/* Apply a priority to the matching categories. Called with s_config_lock held. */
+static int set_category_priority(const char *name, size_t len, int priority)
+{
+    int err = ENOENT;
+
+    for (XlogCategory *cat = s_categories; cat != NULL; cat = cat->next) {
+        if (strlen(cat->name) == len && strncmp(cat->name, name, len) == 0) {
+            __atomic_store_n(&cat->priority, priority, __ATOMIC_RELAXED);
+            err = 0;
+        }
+    }
+
+    return err;
+}
+
+/* Remember a category priority for categories registered later. */
+static void remember_category_priority(const char *name, size_t len, int priority)
+{
+    XlogCategoryConfig *conf;
+    char *copy;
+
+    for (size_t i = 0; i < xv_size(s_category_config); ++i) {
+        conf = &xv_A(s_category_config, i);
+        if (strlen(conf->name) == len && strncmp(conf->name, name, len) == 0) {
+            conf->priority = priority;
+            return;
+        }
+    }
+
+    copy = malloc(len + 1);
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    conf = xv_pushp(XlogCategoryConfig, s_category_config);
+    conf->name = copy;
+    conf->priority = priority;
+}
+
+void xlog_category_register(XlogCategory *cat)
+{
+    XlogCategoryConfig *conf;
+
+    pthread_mutex_lock(&s_config_lock);
+    cat->next = s_categories;
+    s_categories = cat;
+    for (size_t i = 0; i < xv_size(s_category_config); ++i) {
+        conf = &xv_A(s_category_config, i);
+        if (strcmp(conf->name, cat->name) == 0) {
+            __atomic_store_n(&cat->priority, conf->priority, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&s_config_lock);
+}
+
+int xlog_set_category_priority(const char *name, int priority)
+{
+    int err;
+
+    XASSERT_GTE(priority, -1);
+    XASSERT_LTE(priority, XLOG_DEBUG);
+
+    pthread_mutex_lock(&s_config_lock);
+    err = set_category_priority(name, strlen(name), priority);
+    pthread_mutex_unlock(&s_config_lock);
+
+    return err;
+}
+
+int xlog_config_apply(const char *config)
+{
+    const char *p = config;
+    const char *entry, *eq;
+    size_t len;
+    int priority;
+    int err = 0;
+
+    pthread_mutex_lock(&s_config_lock);
+    while (*p != '\0') {
+        if (*p == '#') {
+            p += strcspn(p, "\n");
+            continue;
+        }
+        if (strchr(", \t\r\n", *p) != NULL) {
+            ++p;
+            continue;
+        }
+
+        entry = p;
+        len = strcspn(p, ", \t\r\n#");
+        p += len;
+
+        eq = memchr(entry, '=', len);
+        if (eq == NULL) {
+            if (parse_priority(entry, len, &priority) && priority >= 0) {
+                __atomic_store_n(&_xlog_priority, priority, __ATOMIC_RELAXED);
+            }
+            else {
+                err = EINVAL;
+            }
+        }
+        else if (eq != entry &&
+                 parse_priority(eq + 1, len - (size_t) (eq + 1 - entry), &priority)) {
+            set_category_priority(entry, (size_t) (eq - entry), priority);
+            remember_category_priority(entry, (size_t) (eq - entry), priority);
+        }
+        else {
+            err = EINVAL;
+        }
+    }
+    pthread_mutex_unlock(&s_config_lock);
+
+    return err;
+}
+
+int xlog_config_load(const char *path)
+{
+    FILE *f;
+    char *buf;
+    size_t len = 0, size = 4096, n;
+    int err;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return errno;
+    }
+
+    buf = malloc(size);
+    while (buf != NULL && (n = fread(buf + len, 1, size - len - 1, f)) > 0) {
+        len += n;
+        if (len == size - 1) {
+            char *bigger = realloc(buf, size * 2);
+            if (bigger == NULL) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = bigger;
+            size *= 2;
+        }
+    }
+    fclose(f);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    buf[len] = '\0';
+    err = xlog_config_apply(buf);
+    free(buf);
+
+    return err;
+}
+
+/* Self-pipe waking up the reload thread from the signal handler. */
+static int s_reload_pipe[2] = { -1, -1 };
+static char *s_reload_path;
+
+static void reload_signal_handler(int sig)
+{
+    int saved_errno = errno;
+    char c = (char) sig;
+    ssize_t ret;
+
+    ret = write(s_reload_pipe[1], &c, 1);
+    (void) ret;
+    errno = saved_errno;
+}
+
+static void *reload_thread_main(void *arg)
+{
+    ssize_t n;
+    char c;
+
+    (void) arg;
+
+    for (;;) {
+        n = read(s_reload_pipe[0], &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            /* The pipe was closed or broke. */
+            break;
+        }
+        xlog_config_load(s_reload_path);
+    }
+
+    return NULL;
+}
+
+int xlog_config_reload_on_signal(int sig, const char *path)
+{
+    struct sigaction sa;
+    pthread_t thread;
+    int err;
+
+    if (s_reload_path != NULL) {
+        return EBUSY;
+    }
+
+    s_reload_path = strdup(path);
+    if (s_reload_path == NULL) {
+        return ENOMEM;
+    }
+    if (pipe(s_reload_pipe) < 0) {
+        err = errno;
+        goto error;
+    }
+
+    err = pthread_create(&thread, NULL, reload_thread_main, NULL);
+    if (err != 0) {
+        goto close_pipe;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = reload_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(sig, &sa, NULL) < 0) {
+        err = errno;
+        /* Closing the write end makes the thread's read return 0. */
+        close(s_reload_pipe[1]);
+        pthread_join(thread, NULL);
+        close(s_reload_pipe[0]);
+        s_reload_pipe[0] = s_reload_pipe[1] = -1;
+        goto error;
+    }
+    pthread_detach(thread);
+
+    return 0;
+
+close_pipe:
+    close(s_reload_pipe[0]);
+    close(s_reload_pipe[1]);
+    s_reload_pipe[0] = s_reload_pipe[1] = -1;
+error:
+    free(s_reload_path);
+    s_reload_path = NULL;
+    return err;
 }
@@ -0,0 +1,806 @@
+/*
+ * Asynchronous logging: callers format messages into a lock-free queue and a
+ * writer thread drains it with writev.
+ *
+ * In deferred mode, callers do not format at all: they copy the format string
+ * pointer, the location, a timestamp and the raw argument bytes into the queue,
+ * and the writer thread does the formatting.
+ *
+ * Both modes write the lines of the file sink: the local time of the message,
+ * its location if requested, then the message.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+#include <xlib/xring.h>
+
+/* Maximum length of a formatted message, including the location prefix. */
+#define XLOG_ASYNC_LINE_MAX 512
+
+#define XLOG_ASYNC_QUEUE_LEN 4096
+#define XLOG_ASYNC_IDLE_MS 10
+
+/* Number of messages written with a single writev. */
+#define XLOG_ASYNC_BATCH 64
+
+typedef struct {
+    XlogPriority priority;
+    /* If set, data holds packed arguments for fmt rather than text. */
+    bool deferred;
+    bool print_loc;
+    int line;
+    const char *file;
+    const char *func;
+    const char *fmt;
+    struct timespec ts;
+    /* Number of bytes used in data. */
+    unsigned int len;
+    char data[XLOG_ASYNC_LINE_MAX];
+} XlogAsyncRecord;
+
+/* Size classes of printf arguments, after default promotions. */
+typedef enum {
+    ARG_NONE,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_STR,
+    ARG_PTR,
+    /* Conversions that cannot be deferred, such as %n or %ls. */
+    ARG_UNSUPPORTED
+} ArgType;
+
+/* A parsed printf conversion specification. */
+typedef struct {
+    const char *start;
+    size_t len;
+    /* Number of '*' widths/precisions, each taking an int argument. */
+    int stars;
+    /* The precision, or -1 if none; if precision_star, the last '*' gives it. */
+    int precision;
+    bool precision_star;
+    ArgType type;
+} ArgSpec;
+
+XRING_INIT(xlog_rec, XlogAsyncRecord)
+
+static xring_mpmc_t(xlog_rec) *s_queue;
+static XlogAsyncConfig s_config;
+static XlogFunc s_prev_func;
+static pthread_t s_writer;
+static atomic_bool s_stopping;
+/* Held while records are popped and written, so drains keep queue order. */
+static pthread_mutex_t s_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Wakes the writer thread early: on stop, or when blocked callers wait. */
+static pthread_mutex_t s_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_wake;
+static bool s_wake_pending;
+static atomic_size_t s_dropped;
+static size_t s_dropped_reported;
+
+static const int s_crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+static struct sigaction s_prev_actions[sizeof(s_crash_signals) / sizeof(s_crash_signals[0])];
+
+static int priority_fd(XlogPriority priority)
+{
+    return (priority <= XLOG_WARNING) ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+/* writev all of iov, retrying on partial writes and EINTR. */
+static void write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+    while (iovcnt > 0) {
+        n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+/*
+ * Parse the conversion specification starting at p, which points just past a
+ * '%'. Returns a pointer past the specification.
+ */
+static const char *parse_spec(const char *p, ArgSpec *spec)
+{
+    int longs = 0;
+    char length = '\0';
+
+    spec->start = p - 1;
+    spec->stars = 0;
+    spec->precision = -1;
+    spec->precision_star = false;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+        ++p;
+    }
+    if (*p == '*') {
+        ++spec->stars;
+        ++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (*p == '.') {
+        ++p;
+        spec->precision = 0;
+        if (*p == '*') {
+            ++spec->stars;
+            spec->precision_star = true;
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            if (spec->precision < INT_MAX / 10) {
+                spec->precision = spec->precision * 10 + (*p - '0');
+            }
+            ++p;
+        }
+    }
+    for (; *p != '\0' && strchr("hlLqjzt", *p) != NULL; ++p) {
+        if (*p == 'l') {
+            ++longs;
+        }
+        length = *p;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        switch (length) {
+        case 'l': spec->type = (longs > 1) ? ARG_LLONG : ARG_LONG; break;
+        case 'q': spec->type = ARG_LLONG; break;
+        case 'j': spec->type = ARG_INTMAX; break;
+        case 'z': spec->type = ARG_SIZE; break;
+        case 't': spec->type = ARG_PTRDIFF; break;
+        default: spec->type = ARG_INT; break;
+        }
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        spec->type = (length == 'L') ? ARG_LDOUBLE : ARG_DOUBLE;
+        break;
+    case 'c':
+        spec->type = ARG_INT;
+        break;
+    case 's':
+        spec->type = (length == 'l') ? ARG_UNSUPPORTED : ARG_STR;
+        break;
+    case 'p':
+        spec->type = ARG_PTR;
+        break;
+    case '%':
+        spec->type = ARG_NONE;
+        break;
+    default:
+        spec->type = ARG_UNSUPPORTED;
+        break;
+    }
+    if (*p != '\0') {
+        ++p;
+    }
+    spec->len = (size_t) (p - spec->start);
+
+    return p;
+}
+
+#define PACK(T, ap) do { \
+        T _v = va_arg(ap, T); \
+        if (len + sizeof(_v) > size) { \
+            return -1; \
+        } \
+        memcpy(buf + len, &_v, sizeof(_v)); \
+        len += sizeof(_v); \
+    } while (0)
+
+/*
+ * Copy the arguments of fmt into buf. Returns the number of bytes used, or -1
+ * if the arguments do not fit or cannot be deferred.
+ */
+static int pack_args(char *buf, size_t size, const char *fmt, va_list args)
+{
+    ArgSpec spec;
+    size_t len = 0, n;
+    const char *p = fmt, *str;
+    int star = 0, precision;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        p = parse_spec(p + 1, &spec);
+        for (int i = 0; i < spec.stars; ++i) {
+            PACK(int, args);
+            memcpy(&star, buf + len - sizeof(star), sizeof(star));
+        }
+        switch (spec.type) {
+        case ARG_NONE: break;
+        case ARG_INT: PACK(int, args); break;
+        case ARG_LONG: PACK(long, args); break;
+        case ARG_LLONG: PACK(long long, args); break;
+        case ARG_INTMAX: PACK(intmax_t, args); break;
+        case ARG_SIZE: PACK(size_t, args); break;
+        case ARG_PTRDIFF: PACK(ptrdiff_t, args); break;
+        case ARG_DOUBLE: PACK(double, args); break;
+        case ARG_LDOUBLE: PACK(long double, args); break;
+        case ARG_PTR: PACK(void *, args); break;
+        case ARG_STR:
+            /* The string may not outlive the call, so copy it. */
+            str = va_arg(args, const char *);
+            if (str == NULL) {
+                str = "(null)";
+            }
+            /* With a precision, the string need not be NUL-terminated. */
+            precision = spec.precision_star ? star : spec.precision;
+            n = (precision >= 0) ? strnlen(str, (size_t) precision) : strlen(str);
+            if (len + n + 1 > size) {
+                return -1;
+            }
+            memcpy(buf + len, str, n);
+            buf[len + n] = '\0';
+            len += n + 1;
+            break;
+        case ARG_UNSUPPORTED:
+            return -1;
+        }
+    }
+
+    return (int) len;
+}
+
+#undef PACK
+
+#define UNPACK(T, var) do { \
+        memcpy(&var, data, sizeof(var)); \
+        data += sizeof(T); \
+    } while (0)
+
+#define EMIT(...) do { \
+        int _n = snprintf(out + len, size - len, __VA_ARGS__); \
+        if (_n > 0) { \
+            len += ((size_t) _n < size - len) ? (size_t) _n : size - len - 1; \
+        } \
+    } while (0)
+
+#define EMIT_ARG(spec, stars, T, data) do { \
+        T _v; \
+        UNPACK(T, _v); \
+        if ((stars) == 0) { \
+            EMIT(spec, _v); \
+        } \
+        else if ((stars) == 1) { \
+            EMIT(spec, star[0], _v); \
+        } \
+        else { \
+            EMIT(spec, star[0], star[1], _v); \
+        } \
+    } while (0)
+
+/*
+ * Format fmt using arguments packed by pack_args into out, which must have
+ * room for at least one byte. Returns the length of the formatted text.
+ */
+static size_t format_packed(char *out, size_t size, const char *fmt, const char *data)
+{
+    char spec_buf[64];
+    ArgSpec spec;
+    int star[2];
+    size_t len = 0, n;
+    const char *p = fmt, *next;
+
+    out[0] = '\0';
+    while (*p != '\0' && len < size - 1) {
+        next = strchr(p, '%');
+        if (next == NULL) {
+            next = p + strlen(p);
+        }
+        /* Literal text. */
+        n = (size_t) (next - p);
+        if (n > size - 1 - len) {
+            n = size - 1 - len;
+        }
+        memcpy(out + len, p, n);
+        len += n;
+        out[len] = '\0';
+        if (*next == '\0') {
+            break;
+        }
+
+        p = parse_spec(next + 1, &spec);
+        if (spec.len >= sizeof(spec_buf)) {
+            break;
+        }
+        memcpy(spec_buf, spec.start, spec.len);
+        spec_buf[spec.len] = '\0';
+        for (int i = 0; i < spec.stars; ++i) {
+            UNPACK(int, star[i]);
+        }
+        switch (spec.type) {
+        case ARG_NONE: EMIT("%%"); break;
+        case ARG_INT: EMIT_ARG(spec_buf, spec.stars, int, data); break;
+        case ARG_LONG: EMIT_ARG(spec_buf, spec.stars, long, data); break;
+        case ARG_LLONG: EMIT_ARG(spec_buf, spec.stars, long long, data); break;
+        case ARG_INTMAX: EMIT_ARG(spec_buf, spec.stars, intmax_t, data); break;
+        case ARG_SIZE: EMIT_ARG(spec_buf, spec.stars, size_t, data); break;
+        case ARG_PTRDIFF: EMIT_ARG(spec_buf, spec.stars, ptrdiff_t, data); break;
+        case ARG_DOUBLE: EMIT_ARG(spec_buf, spec.stars, double, data); break;
+        case ARG_LDOUBLE: EMIT_ARG(spec_buf, spec.stars, long double, data); break;
+        case ARG_PTR: EMIT_ARG(spec_buf, spec.stars, void *, data); break;
+        case ARG_STR:
+            if (spec.stars == 0) {
+                EMIT(spec_buf, data);
+            }
+            else if (spec.stars == 1) {
+                EMIT(spec_buf, star[0], data);
+            }
+            else {
+                EMIT(spec_buf, star[0], star[1], data);
+            }
+            data += strlen(data) + 1;
+            break;
+        case ARG_UNSUPPORTED:
+            /* Never packed. */
+            break;
+        }
+    }
+
+    return len;
+}
+
+#undef EMIT_ARG
+#undef EMIT
+#undef UNPACK
+
+/*
+ * Format the time and, if print_loc is set, the location of a message into
+ * buf, which has room for at least XLOG_TIME_PREFIX_LEN + 2 bytes. Returns the
+ * length of the text.
+ */
+static size_t format_prefix(
+    char *buf,
+    size_t size,
+    const struct timespec *real,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func)
+{
+    XlogTime t;
+    size_t len;
+    int n;
+
+    t.real = *real;
+    len = xlog_time_prefix(&t, buf);
+    buf[len++] = ' ';
+    if (print_loc) {
+        n = snprintf(buf + len, size - len, "%s:%d [%s]:\n", file, line, func);
+        if (n > 0) {
+            len += ((size_t) n < size - len) ? (size_t) n : size - len - 1;
+        }
+    }
+
+    return len;
+}
+
+/* Turn a deferred record into text, in place. */
+static void format_deferred(XlogAsyncRecord *rec)
+{
+    char line[XLOG_ASYNC_LINE_MAX];
+    size_t max = sizeof(line) - 1;
+    size_t len;
+
+    len = format_prefix(
+        line, max, &rec->ts, rec->print_loc, rec->file, rec->line, rec->func);
+    len += format_packed(line + len, max - len, rec->fmt, rec->data);
+    line[len++] = '\n';
+
+    memcpy(rec->data, line, len);
+    rec->len = (unsigned int) len;
+    rec->deferred = false;
+}
+
+/* Write a batch of records, with one writev per run of records to the same fd. */
+static void write_batch(XlogAsyncRecord *recs, size_t n)
+{
+    struct iovec iov[XLOG_ASYNC_BATCH];
+    size_t start, i;
+    int fd;
+
+    for (start = 0; start < n; start = i) {
+        fd = priority_fd(recs[start].priority);
+        for (i = start; i < n && priority_fd(recs[i].priority) == fd; ++i) {
+            iov[i - start].iov_base = recs[i].data;
+            iov[i - start].iov_len = recs[i].len;
+        }
+        write_all(fd, iov, (int) (i - start));
+    }
+}
+
+static void report_dropped(void)
+{
+    char buf[64];
+    size_t dropped = atomic_load(&s_dropped);
+    struct iovec iov;
+    int len;
+
+    if (dropped == s_dropped_reported) {
+        return;
+    }
+
+    len = snprintf(buf, sizeof(buf), "xlog: dropped %zu messages\n",
+                   dropped - s_dropped_reported);
+    s_dropped_reported = dropped;
+    iov.iov_base = buf;
+    iov.iov_len = (size_t) len;
+    write_all(STDERR_FILENO, &iov, 1);
+}
+
+/* Drain the queue; returns the number of records written. */
+static size_t drain(void)
+{
+    XlogAsyncRecord batch[XLOG_ASYNC_BATCH];
+    size_t n, total = 0;
+
+    do {
+        pthread_mutex_lock(&s_drain_lock);
+        n = xr_mpmc_pop_n(xlog_rec, s_queue, batch, XLOG_ASYNC_BATCH);
+        for (size_t i = 0; i < n; ++i) {
+            if (batch[i].deferred) {
+                format_deferred(&batch[i]);
+            }
+        }
+        write_batch(batch, n);
+        pthread_mutex_unlock(&s_drain_lock);
+        total += n;
+    } while (n > 0);
+
+    return total;
+}
+
+static void wake_writer(void)
+{
+    pthread_mutex_lock(&s_wake_lock);
+    s_wake_pending = true;
+    pthread_cond_signal(&s_wake);
+    pthread_mutex_unlock(&s_wake_lock);
+}
+
+/* Sleep for idle_ms, unless woken up earlier. */
+static void writer_sleep(void)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += s_config.idle_ms / 1000;
+    deadline.tv_nsec += (long) (s_config.idle_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&s_wake_lock);
+    if (!s_wake_pending && !atomic_load(&s_stopping)) {
+        pthread_cond_timedwait(&s_wake, &s_wake_lock, &deadline);
+    }
+    s_wake_pending = false;
+    pthread_mutex_unlock(&s_wake_lock);
+}
+
+static void *writer_main(void *arg)
+{
+    (void) arg;
+
+    while (!atomic_load(&s_stopping)) {
+        if (drain() == 0) {
+            report_dropped();
+            writer_sleep();
+        }
+    }
+
+    return NULL;
+}
+
+void xlog_flush(void)
+{
+    xlog_rl_flush();
+    if (s_queue != NULL) {
+        drain();
+    }
+    xlog_syslog_sink_flush();
+    xlog_journald_sink_flush();
+}
+
+/* Format v in decimal into the end of a buffer, returning the first digit. */
+static char *int_to_dec(int v, char *end)
+{
+    unsigned int u = (v < 0) ? -(unsigned int) v : (unsigned int) v;
+    char *p = end;
+
+    do {
+        *--p = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) {
+        *--p = '-';
+    }
+
+    return p;
+}
+
+#define IOV_STR(s) do { \
+        iov[n].iov_base = (void *) (s); \
+        iov[n].iov_len = strlen(s); \
+        ++n; \
+    } while (0)
+
+void xlog_flush_signal_safe(void)
+{
+    XlogAsyncRecord rec;
+    struct iovec iov[8];
+    char num[16];
+    int n;
+
+    if (s_queue == NULL) {
+        return;
+    }
+
+    /*
+     * The drain lock is not taken, as the thread that crashed may hold it, so
+     * a batch the writer thread is writing may come out after these records.
+     * Records are popped one at a time to keep the stack small. Formatting a
+     * deferred record needs snprintf and localtime, so it is written with its
+     * location and format string only.
+     */
+    while (xr_mpmc_pop_n(xlog_rec, s_queue, &rec, 1) > 0) {
+        n = 0;
+        if (!rec.deferred) {
+            iov[n].iov_base = rec.data;
+            iov[n].iov_len = rec.len;
+            ++n;
+        }
+        else {
+            if (rec.print_loc) {
+                num[sizeof(num) - 1] = '\0';
+                IOV_STR(rec.file);
+                IOV_STR(":");
+                IOV_STR(int_to_dec(rec.line, num + sizeof(num) - 1));
+                IOV_STR(" [");
+                IOV_STR(rec.func);
+                IOV_STR("]:\n");
+            }
+            IOV_STR(rec.fmt);
+            IOV_STR("\n");
+        }
+        write_all(priority_fd(rec.priority), iov, n);
+    }
+}
+
+#undef IOV_STR
+
+size_t xlog_async_dropped(void)
+{
+    return atomic_load(&s_dropped);
+}
+
+static void push_record(XlogAsyncRecord *rec)
+{
+    while (xr_mpmc_push_n(xlog_rec, s_queue, rec, 1) == 0) {
+        if (s_config.overflow == XLOG_ASYNC_DROP) {
+            atomic_fetch_add(&s_dropped, 1);
+            return;
+        }
+        wake_writer();
+        sched_yield();
+    }
+}
+
+/* Format a message into a record. */
+static void format_record(
+    XlogAsyncRecord *rec,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    size_t max = sizeof(rec->data) - 1;
+    size_t len;
+    int n;
+
+    rec->deferred = false;
+    len = format_prefix(rec->data, max, &xlog_time()->real, print_loc, file, line, func);
+    n = vsnprintf(rec->data + len, max - len, fmt, args);
+    if (n > 0) {
+        len += ((size_t) n < max - len) ? (size_t) n : max - len - 1;
+    }
+    rec->data[len++] = '\n';
+    rec->len = (unsigned int) len;
+}
+
+void xlog_async_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    XlogAsyncRecord rec;
+
+    rec.priority = priority;
+    format_record(&rec, print_loc, file, line, func, fmt, args);
+    push_record(&rec);
+}
+
+void xlog_deferred_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    XlogAsyncRecord rec;
+    va_list args_copy;
+    int len;
+
+    rec.priority = priority;
+    va_copy(args_copy, args);
+    len = pack_args(rec.data, sizeof(rec.data), fmt, args_copy);
+    va_end(args_copy);
+
+    if (len < 0) {
+        /* Too large or not deferrable; format now instead. */
+        format_record(&rec, print_loc, file, line, func, fmt, args);
+    }
+    else {
+        rec.deferred = true;
+        rec.print_loc = print_loc;
+        rec.file = file;
+        rec.line = line;
+        rec.func = func;
+        rec.fmt = fmt;
+        rec.len = (unsigned int) len;
+        rec.ts = xlog_time()->real;
+    }
+    push_record(&rec);
+}
+
+static void crash_handler(int sig)
+{
+    xlog_flush_signal_safe();
+    /* The handler was installed with SA_RESETHAND, so this is fatal. */
+    raise(sig);
+}
+
+static void install_crash_handlers(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = crash_handler;
+    /* Use the thread's alternate stack, if any, to survive stack overflows. */
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        sigaction(s_crash_signals[i], &sa, &s_prev_actions[i]);
+    }
+}
+
+static void restore_crash_handlers(void)
+{
+    for (size_t i = 0; i < sizeof(s_crash_signals) / sizeof(s_crash_signals[0]); ++i) {
+        sigaction(s_crash_signals[i], &s_prev_actions[i], NULL);
+    }
+}
+
+int xlog_async_start(const XlogAsyncConfig *config)
+{
+    pthread_condattr_t attr;
+    int err;
+
+    if (s_queue != NULL) {
+        return EBUSY;
+    }
+
+    if (config != NULL) {
+        s_config = *config;
+    }
+    else {
+        memset(&s_config, 0, sizeof(s_config));
+    }
+    if (s_config.queue_len == 0) {
+        s_config.queue_len = XLOG_ASYNC_QUEUE_LEN;
+    }
+    if (s_config.idle_ms == 0) {
+        s_config.idle_ms = XLOG_ASYNC_IDLE_MS;
+    }
+
+    s_queue = xr_mpmc_init(xlog_rec, s_config.queue_len);
+    if (s_queue == NULL) {
+        return ENOMEM;
+    }
+
+    /* The writer sleeps against the monotonic clock. */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    err = pthread_cond_init(&s_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (err != 0) {
+        xr_mpmc_destroy(xlog_rec, s_queue);
+        s_queue = NULL;
+        return err;
+    }
+    s_wake_pending = false;
+
+    atomic_store(&s_stopping, false);
+    err = pthread_create(&s_writer, NULL, writer_main, NULL);
+    if (err != 0) {
+        pthread_cond_destroy(&s_wake);
+        xr_mpmc_destroy(xlog_rec, s_queue);
+        s_queue = NULL;
+        return err;
+    }
+
+    if (s_config.flush_on_crash) {
+        install_crash_handlers();
+    }
+
+    s_prev_func = xlog_get_log_func();
+    xlog_set_log_func(s_config.deferred_format ? xlog_deferred_func : xlog_async_func);
+
+    return 0;
+}
+
+void xlog_async_stop(void)
+{
+    if (s_queue == NULL) {
+        return;
+    }
+
+    xlog_set_log_func(s_prev_func);
+    atomic_store(&s_stopping, true);
+    wake_writer();
+    pthread_join(s_writer, NULL);
+    drain();
+    report_dropped();
+    pthread_cond_destroy(&s_wake);
+
+    if (s_config.flush_on_crash) {
+        restore_crash_handlers();
+    }
+
+    xr_mpmc_destroy(xlog_rec, s_queue);
+    s_queue = NULL;
+}
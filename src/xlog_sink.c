@@ -0,0 +1,818 @@
+/*
+ * Built-in xlog sinks: a rotating file sink, an mmap-backed circular "flight
+ * recorder" that keeps the most recent logs in memory, and native syslog and
+ * journald socket sinks.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+/* Maximum length of a formatted line, including the location prefix. */
+#define XLOG_SINK_LINE_MAX 1024
+
+#define XLOG_RING_MAGIC "XLOGRING"
+
+/* Number of datagrams a socket sink queues while the socket is full. */
+#define XLOG_SOCKET_SINK_PENDING 64
+
+/* Sizes of the syslog header and of the journald fields before the message. */
+#define XLOG_SYSLOG_HEADER_MAX 256
+#define XLOG_JOURNALD_FIELDS_MAX 512
+
+/*
+ * Largest datagram a socket sink builds: the journald fields, the MESSAGE key
+ * and the message length, then the message. Syslog datagrams are smaller.
+ */
+#define XLOG_SOCKET_DATAGRAM_MAX (XLOG_JOURNALD_FIELDS_MAX + 16 + XLOG_SINK_LINE_MAX)
+
+_Static_assert(XLOG_SYSLOG_HEADER_MAX + XLOG_SINK_LINE_MAX <= XLOG_SOCKET_DATAGRAM_MAX,
+               "syslog datagrams must fit in a socket sink queue slot");
+
+/* How many times, and how long, closing a socket sink waits for it to drain. */
+#define XLOG_SOCKET_SINK_CLOSE_TRIES 10
+#define XLOG_SOCKET_SINK_CLOSE_WAIT_MS 10
+
+#define XLOG_SYSLOG_PATH "/dev/log"
+#define XLOG_JOURNALD_PATH "/run/systemd/journal/socket"
+
+/* LOG_USER, without depending on <syslog.h>. */
+#define XLOG_SYSLOG_USER (1 << 3)
+
+/*
+ * Format a message the way xlog_default_func does in text format, prefixed
+ * with the time it was logged and always ending with a newline. Returns the
+ * length of the line.
+ */
+static size_t format_line(
+    char *buf,
+    size_t size,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    size_t len;
+    int n;
+
+    len = xlog_time_prefix(xlog_time(), buf);
+    buf[len++] = ' ';
+    if (print_loc) {
+        n = snprintf(buf + len, size - 1 - len, "%s:%d [%s]:\n", file, line, func);
+        if (n > 0) {
+            len += ((size_t) n < size - 1 - len) ? (size_t) n : size - 2 - len;
+        }
+    }
+    n = vsnprintf(buf + len, size - 1 - len, fmt, args);
+    if (n > 0) {
+        len += ((size_t) n < size - 1 - len) ? (size_t) n : size - 2 - len;
+    }
+    buf[len++] = '\n';
+
+    return len;
+}
+
+/*
+ * Rotating file sink. All writes and rotations happen under s_file.lock, so no
+ * line is lost or split while files are renamed.
+ */
+static struct {
+    pthread_mutex_t lock;
+    XlogFileSinkConfig config;
+    char *path;
+    int fd;
+    size_t size;
+    time_t opened;
+} s_file = { PTHREAD_MUTEX_INITIALIZER, { NULL, 0, 0, 0, false }, NULL, -1, 0, 0 };
+
+static time_t coarse_seconds(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+    return ts.tv_sec;
+}
+
+/* Open the current log file. Called with s_file.lock held. */
+static int file_sink_open_current(void)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(s_file.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return errno;
+    }
+    if (fstat(fd, &st) < 0) {
+        st.st_size = 0;
+    }
+
+    /*
+     * Reserve the blocks of the whole file up front, without changing its
+     * size, so appends do not allocate as the file grows.
+     */
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (s_file.config.preallocate && s_file.config.max_size > (size_t) st.st_size) {
+        (void) fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) s_file.config.max_size);
+    }
+#endif
+
+    s_file.fd = fd;
+    s_file.size = (size_t) st.st_size;
+    s_file.opened = coarse_seconds();
+
+    return 0;
+}
+
+/*
+ * Shift path.N-1 to path.N, ..., path to path.1 and start a new file. Called
+ * with s_file.lock held.
+ */
+static void file_sink_rotate(void)
+{
+    char from[PATH_MAX], to[PATH_MAX];
+    size_t len = sizeof(from);
+
+    if (s_file.fd >= 0) {
+        close(s_file.fd);
+        s_file.fd = -1;
+    }
+
+    for (unsigned int i = s_file.config.max_files; i > 1; --i) {
+        snprintf(from, len, "%s.%u", s_file.path, i - 1);
+        snprintf(to, len, "%s.%u", s_file.path, i);
+        rename(from, to);
+    }
+    if (s_file.config.max_files > 0) {
+        snprintf(to, len, "%s.1", s_file.path);
+        rename(s_file.path, to);
+    }
+    else {
+        unlink(s_file.path);
+    }
+
+    file_sink_open_current();
+}
+
+int xlog_file_sink_open(const XlogFileSinkConfig *config)
+{
+    int err;
+
+    pthread_mutex_lock(&s_file.lock);
+    if (s_file.path != NULL) {
+        pthread_mutex_unlock(&s_file.lock);
+        return EBUSY;
+    }
+
+    s_file.config = *config;
+    s_file.path = strdup(config->path);
+    if (s_file.path == NULL) {
+        pthread_mutex_unlock(&s_file.lock);
+        return ENOMEM;
+    }
+    s_file.config.path = s_file.path;
+
+    err = file_sink_open_current();
+    if (err != 0) {
+        free(s_file.path);
+        s_file.path = NULL;
+    }
+    pthread_mutex_unlock(&s_file.lock);
+
+    return err;
+}
+
+void xlog_file_sink_close(void)
+{
+    pthread_mutex_lock(&s_file.lock);
+    if (s_file.fd >= 0) {
+        close(s_file.fd);
+        s_file.fd = -1;
+    }
+    free(s_file.path);
+    s_file.path = NULL;
+    pthread_mutex_unlock(&s_file.lock);
+}
+
+void xlog_file_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    char buf[XLOG_SINK_LINE_MAX];
+    size_t len;
+    ssize_t n;
+    bool rotate;
+
+    (void) priority;
+
+    len = format_line(buf, sizeof(buf), print_loc, file, line, func, fmt, args);
+
+    pthread_mutex_lock(&s_file.lock);
+    if (s_file.path == NULL) {
+        pthread_mutex_unlock(&s_file.lock);
+        return;
+    }
+
+    rotate = (s_file.config.max_size > 0 && s_file.size > 0 &&
+              s_file.size + len > s_file.config.max_size) ||
+             (s_file.config.max_age_s > 0 &&
+              coarse_seconds() - s_file.opened >= (time_t) s_file.config.max_age_s);
+    if (rotate) {
+        file_sink_rotate();
+    }
+    else if (s_file.fd < 0) {
+        /* A previous rotation could not open the new file; try again. */
+        file_sink_open_current();
+    }
+
+    for (const char *p = buf; len > 0 && s_file.fd >= 0; ) {
+        n = write(s_file.fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += n;
+        len -= (size_t) n;
+        s_file.size += (size_t) n;
+    }
+    pthread_mutex_unlock(&s_file.lock);
+}
+
+/*
+ * Flight recorder. The mapping starts with a header followed by the data
+ * area, whose size is a power of two. Writers reserve space by atomically
+ * advancing head, the total number of bytes ever written, and copy their line
+ * into it modulo the size, so logging costs a formatting pass and a memcpy.
+ * The magic string lets the buffer be found in a core dump. A writer that
+ * falls a whole lap behind may interleave with a newer line; as in any flight
+ * recorder, the newest data wins and old lines are best effort.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    _Atomic uint64_t head;
+    char data[];
+} XlogRingHeader;
+
+static XlogRingHeader *s_ring;
+static size_t s_ring_map_size;
+
+int xlog_ring_sink_open(size_t size, const char *path)
+{
+    XlogRingHeader *ring;
+    size_t data_size = 4096;
+    size_t map_size;
+    void *map;
+    int fd = -1;
+
+    if (s_ring != NULL) {
+        return EBUSY;
+    }
+
+    while (data_size < size) {
+        data_size <<= 1;
+    }
+    map_size = sizeof(XlogRingHeader) + data_size;
+
+    if (path != NULL) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return errno;
+        }
+        if (ftruncate(fd, (off_t) map_size) < 0) {
+            int err = errno;
+            close(fd);
+            return err;
+        }
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    else {
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED) {
+        return errno;
+    }
+
+    ring = map;
+    memcpy(ring->magic, XLOG_RING_MAGIC, sizeof(ring->magic));
+    ring->size = data_size;
+    atomic_init(&ring->head, 0);
+
+    s_ring_map_size = map_size;
+    __atomic_store_n(&s_ring, ring, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void xlog_ring_sink_close(void)
+{
+    XlogRingHeader *ring = __atomic_exchange_n(&s_ring, NULL, __ATOMIC_ACQ_REL);
+
+    if (ring != NULL) {
+        munmap(ring, s_ring_map_size);
+    }
+}
+
+void xlog_ring_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    XlogRingHeader *ring = __atomic_load_n(&s_ring, __ATOMIC_ACQUIRE);
+    char buf[XLOG_SINK_LINE_MAX];
+    size_t len, off, first;
+
+    (void) priority;
+
+    if (ring == NULL) {
+        return;
+    }
+
+    len = format_line(buf, sizeof(buf), print_loc, file, line, func, fmt, args);
+    if (len > ring->size) {
+        len = (size_t) ring->size;
+    }
+
+    off = (size_t) (atomic_fetch_add_explicit(&ring->head, len, memory_order_relaxed) &
+                    (ring->size - 1));
+    first = (len < ring->size - off) ? len : (size_t) ring->size - off;
+    memcpy(ring->data + off, buf, first);
+    memcpy(ring->data, buf + first, len - first);
+}
+
+size_t xlog_ring_sink_read(char *buf, size_t size)
+{
+    XlogRingHeader *ring = __atomic_load_n(&s_ring, __ATOMIC_ACQUIRE);
+    uint64_t head;
+    size_t len, off, first;
+
+    if (ring == NULL) {
+        return 0;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    len = (head < ring->size) ? (size_t) head : (size_t) ring->size;
+    if (len > size) {
+        len = size;
+    }
+
+    off = (size_t) ((head - len) & (ring->size - 1));
+    first = (len < ring->size - off) ? len : (size_t) ring->size - off;
+    memcpy(buf, ring->data + off, first);
+    memcpy(buf + first, ring->data, len - first);
+
+    return len;
+}
+
+/*
+ * Socket sinks send one preformatted datagram per message with sendmsg, from
+ * iovecs pointing at the message pieces, on a nonblocking socket. When the
+ * socket is full, datagrams are copied to a small queue and sent in a batch
+ * with sendmmsg once the socket drains; when the queue is full too, they are
+ * dropped and counted.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int fd;
+    struct sockaddr_un addr;
+    char ident[64];
+    int facility;
+    /* Queued datagrams, a ring of XLOG_SOCKET_SINK_PENDING entries. */
+    char (*pending)[XLOG_SOCKET_DATAGRAM_MAX];
+    size_t pending_len[XLOG_SOCKET_SINK_PENDING];
+    size_t pending_head;
+    size_t npending;
+    size_t dropped;
+} SocketSink;
+
+#define SOCKET_SINK_INIT { PTHREAD_MUTEX_INITIALIZER, -1, { 0 }, "", 0, NULL, { 0 }, 0, 0, 0 }
+
+static SocketSink s_syslog = SOCKET_SINK_INIT;
+static SocketSink s_journald = SOCKET_SINK_INIT;
+
+static int socket_sink_connect(SocketSink *sink)
+{
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return errno;
+    }
+    if (connect(fd, (const struct sockaddr *) &sink->addr, sizeof(sink->addr)) < 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    sink->fd = fd;
+
+    return 0;
+}
+
+static int socket_sink_open(
+    SocketSink *sink,
+    const char *path,
+    const char *ident,
+    int facility)
+{
+    int err;
+
+    if (strlen(path) >= sizeof(sink->addr.sun_path)) {
+        return ENAMETOOLONG;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    if (sink->fd >= 0) {
+        pthread_mutex_unlock(&sink->lock);
+        return EBUSY;
+    }
+
+    sink->pending = malloc(sizeof(*sink->pending) * XLOG_SOCKET_SINK_PENDING);
+    if (sink->pending == NULL) {
+        pthread_mutex_unlock(&sink->lock);
+        return ENOMEM;
+    }
+    sink->pending_head = 0;
+    sink->npending = 0;
+    sink->dropped = 0;
+
+    memset(&sink->addr, 0, sizeof(sink->addr));
+    sink->addr.sun_family = AF_UNIX;
+    strcpy(sink->addr.sun_path, path);
+    snprintf(sink->ident, sizeof(sink->ident), "%s",
+             (ident != NULL) ? ident : program_invocation_short_name);
+    sink->facility = facility;
+
+    err = socket_sink_connect(sink);
+    if (err != 0) {
+        free(sink->pending);
+        sink->pending = NULL;
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    return err;
+}
+
+/* Send the queued datagrams in one batch. Called with the lock held. */
+static void socket_sink_flush_pending(SocketSink *sink)
+{
+    struct mmsghdr msgs[XLOG_SOCKET_SINK_PENDING];
+    struct iovec iov[XLOG_SOCKET_SINK_PENDING];
+    size_t idx;
+    int n;
+
+    if (sink->npending == 0) {
+        return;
+    }
+
+    memset(msgs, 0, sizeof(msgs[0]) * sink->npending);
+    for (size_t i = 0; i < sink->npending; ++i) {
+        idx = (sink->pending_head + i) % XLOG_SOCKET_SINK_PENDING;
+        iov[i].iov_base = sink->pending[idx];
+        iov[i].iov_len = sink->pending_len[idx];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = sendmmsg(sink->fd, msgs, (unsigned int) sink->npending, MSG_NOSIGNAL);
+    if (n > 0) {
+        sink->pending_head = (sink->pending_head + (size_t) n) % XLOG_SOCKET_SINK_PENDING;
+        sink->npending -= (size_t) n;
+    }
+}
+
+/*
+ * Send the queued datagrams, waiting a little for the socket to drain when it
+ * is full; what is left is dropped. Called with the lock held.
+ */
+static void socket_sink_drain(SocketSink *sink)
+{
+    struct pollfd pfd;
+    size_t before;
+    int tries = 0;
+
+    while (sink->npending > 0 && tries < XLOG_SOCKET_SINK_CLOSE_TRIES) {
+        before = sink->npending;
+        socket_sink_flush_pending(sink);
+        if (sink->npending == before) {
+            ++tries;
+            pfd.fd = sink->fd;
+            pfd.events = POLLOUT;
+            poll(&pfd, 1, XLOG_SOCKET_SINK_CLOSE_WAIT_MS);
+        }
+    }
+    sink->dropped += sink->npending;
+    sink->npending = 0;
+}
+
+static void socket_sink_close(SocketSink *sink)
+{
+    pthread_mutex_lock(&sink->lock);
+    if (sink->fd >= 0) {
+        socket_sink_drain(sink);
+        close(sink->fd);
+        sink->fd = -1;
+    }
+    free(sink->pending);
+    sink->pending = NULL;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static void socket_sink_flush(SocketSink *sink)
+{
+    pthread_mutex_lock(&sink->lock);
+    if (sink->fd >= 0) {
+        socket_sink_flush_pending(sink);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Copy a datagram to the queue, or drop it. Called with the lock held. */
+static void socket_sink_queue(SocketSink *sink, const struct iovec *iov, int iovcnt)
+{
+    size_t idx, len = 0, n;
+    char *dst;
+
+    if (sink->npending == XLOG_SOCKET_SINK_PENDING) {
+        ++sink->dropped;
+        return;
+    }
+
+    idx = (sink->pending_head + sink->npending) % XLOG_SOCKET_SINK_PENDING;
+    dst = sink->pending[idx];
+    for (int i = 0; i < iovcnt && len < XLOG_SOCKET_DATAGRAM_MAX; ++i) {
+        n = iov[i].iov_len;
+        if (n > XLOG_SOCKET_DATAGRAM_MAX - len) {
+            /* Not reached: slots fit the largest datagram the sinks build. */
+            n = XLOG_SOCKET_DATAGRAM_MAX - len;
+        }
+        memcpy(dst + len, iov[i].iov_base, n);
+        len += n;
+    }
+    sink->pending_len[idx] = len;
+    ++sink->npending;
+}
+
+static void socket_sink_send(SocketSink *sink, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t) iovcnt;
+
+    pthread_mutex_lock(&sink->lock);
+    if (sink->fd < 0) {
+        pthread_mutex_unlock(&sink->lock);
+        return;
+    }
+
+    if (sink->npending > 0) {
+        socket_sink_flush_pending(sink);
+    }
+    if (sink->npending > 0) {
+        /* Keep the order of messages. */
+        socket_sink_queue(sink, iov, iovcnt);
+    }
+    else if (sendmsg(sink->fd, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+            socket_sink_queue(sink, iov, iovcnt);
+        }
+        else if (errno == ECONNREFUSED || errno == ENOTCONN) {
+            /* The daemon restarted; reconnect and try once more. */
+            close(sink->fd);
+            sink->fd = -1;
+            if (socket_sink_connect(sink) != 0 || sendmsg(sink->fd, &msg, MSG_NOSIGNAL) < 0) {
+                ++sink->dropped;
+            }
+        }
+        else {
+            ++sink->dropped;
+        }
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static size_t socket_sink_dropped(SocketSink *sink)
+{
+    size_t dropped;
+
+    pthread_mutex_lock(&sink->lock);
+    dropped = sink->dropped;
+    pthread_mutex_unlock(&sink->lock);
+
+    return dropped;
+}
+
+/* Expand fmt into buf, returning the length of the text. */
+static size_t format_message(char *buf, size_t size, const char *fmt, va_list args)
+{
+    int n = vsnprintf(buf, size, fmt, args);
+
+    if (n < 0) {
+        return 0;
+    }
+
+    return ((size_t) n < size) ? (size_t) n : size - 1;
+}
+
+int xlog_syslog_sink_open(const char *path, const char *ident, int facility)
+{
+    return socket_sink_open(&s_syslog, (path != NULL) ? path : XLOG_SYSLOG_PATH, ident,
+                            (facility != 0) ? facility : XLOG_SYSLOG_USER);
+}
+
+void xlog_syslog_sink_close(void)
+{
+    socket_sink_close(&s_syslog);
+}
+
+void xlog_syslog_sink_flush(void)
+{
+    socket_sink_flush(&s_syslog);
+}
+
+size_t xlog_syslog_sink_dropped(void)
+{
+    return socket_sink_dropped(&s_syslog);
+}
+
+void xlog_syslog_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    static _Thread_local struct {
+        time_t sec;
+        char text[16];
+    } date_cache = { -1, "" };
+    char header[XLOG_SYSLOG_HEADER_MAX], msg[XLOG_SINK_LINE_MAX];
+    const XlogTime *t = xlog_time();
+    struct iovec iov[2];
+    struct tm tm;
+    int n;
+
+    /* RFC 3164 timestamps, e.g. "Jun  1 12:00:00", formatted once a second. */
+    if (t->real.tv_sec != date_cache.sec) {
+        localtime_r(&t->real.tv_sec, &tm);
+        strftime(date_cache.text, sizeof(date_cache.text), "%b %e %H:%M:%S", &tm);
+        date_cache.sec = t->real.tv_sec;
+    }
+
+    if (print_loc) {
+        n = snprintf(header, sizeof(header), "<%d>%s %s[%d]: %s:%d [%s]: ",
+                     s_syslog.facility | (int) priority, date_cache.text, s_syslog.ident,
+                     (int) getpid(), file, line, func);
+    }
+    else {
+        n = snprintf(header, sizeof(header), "<%d>%s %s[%d]: ",
+                     s_syslog.facility | (int) priority, date_cache.text, s_syslog.ident,
+                     (int) getpid());
+    }
+    if (n < 0) {
+        return;
+    }
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = ((size_t) n < sizeof(header)) ? (size_t) n : sizeof(header) - 1;
+    iov[1].iov_base = msg;
+    iov[1].iov_len = format_message(msg, sizeof(msg), fmt, args);
+
+    socket_sink_send(&s_syslog, iov, 2);
+}
+
+int xlog_journald_sink_open(const char *path, const char *ident)
+{
+    return socket_sink_open(&s_journald, (path != NULL) ? path : XLOG_JOURNALD_PATH,
+                            ident, 0);
+}
+
+void xlog_journald_sink_close(void)
+{
+    socket_sink_close(&s_journald);
+}
+
+void xlog_journald_sink_flush(void)
+{
+    socket_sink_flush(&s_journald);
+}
+
+size_t xlog_journald_sink_dropped(void)
+{
+    return socket_sink_dropped(&s_journald);
+}
+
+void xlog_journald_sink_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    char fields[XLOG_JOURNALD_FIELDS_MAX], msg[XLOG_SINK_LINE_MAX];
+    unsigned char msg_len[8];
+    struct iovec iov[4];
+    size_t len;
+    int n;
+
+    /* Fields without newlines use the KEY=value form. */
+    if (print_loc) {
+        n = snprintf(fields, sizeof(fields),
+                     "PRIORITY=%d\nSYSLOG_IDENTIFIER=%s\nCODE_FILE=%s\nCODE_LINE=%d\n"
+                     "CODE_FUNC=%s\n",
+                     (int) priority, s_journald.ident, file, line, func);
+    }
+    else {
+        n = snprintf(fields, sizeof(fields), "PRIORITY=%d\nSYSLOG_IDENTIFIER=%s\n",
+                     (int) priority, s_journald.ident);
+    }
+    if (n < 0 || (size_t) n >= sizeof(fields)) {
+        return;
+    }
+
+    /*
+     * The message may contain newlines, so it uses the binary form: the key, a
+     * newline, the value length as little-endian 64 bits, the value and a
+     * newline.
+     */
+    len = format_message(msg, sizeof(msg) - 1, fmt, args);
+    msg[len] = '\n';
+    for (int i = 0; i < 8; ++i) {
+        msg_len[i] = (unsigned char) ((uint64_t) len >> (8 * i));
+    }
+
+    iov[0].iov_base = fields;
+    iov[0].iov_len = (size_t) n;
+    iov[1].iov_base = "MESSAGE\n";
+    iov[1].iov_len = 8;
+    iov[2].iov_base = msg_len;
+    iov[2].iov_len = sizeof(msg_len);
+    iov[3].iov_base = msg;
+    iov[3].iov_len = len + 1;
+
+    socket_sink_send(&s_journald, iov, 4);
+}
+
+void xlog_ring_sink_dump(int fd)
+{
+    XlogRingHeader *ring = __atomic_load_n(&s_ring, __ATOMIC_ACQUIRE);
+    uint64_t head;
+    size_t len, off, first;
+    ssize_t ret;
+
+    if (ring == NULL) {
+        return;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    len = (head < ring->size) ? (size_t) head : (size_t) ring->size;
+    off = (size_t) ((head - len) & (ring->size - 1));
+    first = (len < ring->size - off) ? len : (size_t) ring->size - off;
+
+    ret = write(fd, ring->data + off, first);
+    if (ret >= 0 && len > first) {
+        ret = write(fd, ring->data, len - first);
+    }
+    (void) ret;
+}
@@ -0,0 +1,591 @@
+/*
+ * Structured (JSON lines and logfmt) output for xlog.
+ *
+ * Lines are encoded into a stack buffer by a small hand-rolled encoder and
+ * written with a single write(2). Only the caller's printf-style message goes
+ * through vsnprintf; timestamps, numbers and escaping are done here.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+/* Maximum length of an encoded line, including the newline. */
+#define XLOG_STRUCT_LINE_MAX 1024
+
+/* Maximum length of the message expanded from the caller's format. */
+#define XLOG_STRUCT_MSG_MAX 512
+
+static int s_format = XLOG_FORMAT_TEXT;
+
+typedef struct {
+    char *p;
+    /* End of the space for fields; the line terminator is written past it. */
+    char *end;
+    XlogFormat format;
+    bool first;
+    /* Set once a field did not fit; everything after it is dropped. */
+    bool full;
+    /* Start of the current field and of its value, to drop a field whose
+     * value does not fit at all rather than leave its key dangling. */
+    char *field;
+    char *value;
+    bool field_first;
+} Encoder;
+
+void xlog_set_log_format(XlogFormat format)
+{
+    __atomic_store_n(&s_format, format, __ATOMIC_RELAXED);
+}
+
+XlogFormat xlog_get_log_format(void)
+{
+    return __atomic_load_n(&s_format, __ATOMIC_RELAXED);
+}
+
+static long thread_id(void)
+{
+    static _Thread_local long tid;
+
+    if (tid == 0) {
+        tid = syscall(SYS_gettid);
+    }
+
+    return tid;
+}
+
+static void enc_init(Encoder *e, char *buf, size_t size, XlogFormat format)
+{
+    e->p = buf;
+    /* Keep room for "}\n". */
+    e->end = buf + size - 2;
+    e->format = format;
+    e->first = true;
+    e->full = false;
+    e->field = NULL;
+    e->value = NULL;
+    e->field_first = true;
+
+    if (format == XLOG_FORMAT_JSON) {
+        *e->p++ = '{';
+    }
+}
+
+static size_t enc_finish(Encoder *e, char *buf)
+{
+    if (e->format == XLOG_FORMAT_JSON) {
+        *e->p++ = '}';
+    }
+    *e->p++ = '\n';
+
+    return (size_t) (e->p - buf);
+}
+
+/* Stop encoding, rolling back to the start of the field if its value is empty. */
+static void enc_set_full(Encoder *e)
+{
+    e->full = true;
+    if (e->p == e->value) {
+        e->p = e->field;
+        e->first = e->field_first;
+    }
+}
+
+static void enc_raw(Encoder *e, const char *s, size_t len)
+{
+    if (e->full || (size_t) (e->end - e->p) < len) {
+        enc_set_full(e);
+        return;
+    }
+    memcpy(e->p, s, len);
+    e->p += len;
+}
+
+/*
+ * Get the escape sequence for c, if it needs one in a quoted string. Returns
+ * its length, or 0 if c can be copied as is.
+ */
+static size_t escape_char(unsigned char c, char *esc)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    switch (c) {
+    case '"': memcpy(esc, "\\\"", 2); return 2;
+    case '\\': memcpy(esc, "\\\\", 2); return 2;
+    case '\n': memcpy(esc, "\\n", 2); return 2;
+    case '\r': memcpy(esc, "\\r", 2); return 2;
+    case '\t': memcpy(esc, "\\t", 2); return 2;
+    default:
+        break;
+    }
+    if (c < 0x20 || c == 0x7f) {
+        memcpy(esc, "\\u00", 4);
+        esc[4] = hex[c >> 4];
+        esc[5] = hex[c & 0xf];
+        return 6;
+    }
+
+    return 0;
+}
+
+/*
+ * Get the length of the UTF-8 sequence starting at s, or 0 if it is invalid:
+ * a stray continuation byte, a truncated or overlong sequence, a surrogate or
+ * a code point past U+10FFFF.
+ */
+static size_t utf8_len(const unsigned char *s, size_t len)
+{
+    uint32_t cp;
+    size_t n;
+
+    if (s[0] < 0x80) {
+        return 1;
+    }
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        n = 2;
+        cp = s[0] & 0x1f;
+    }
+    else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        n = 3;
+        cp = s[0] & 0x0f;
+    }
+    else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        n = 4;
+        cp = s[0] & 0x07;
+    }
+    else {
+        return 0;
+    }
+    if (len < n) {
+        return 0;
+    }
+    for (size_t i = 1; i < n; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    if ((n == 3 && (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff))) ||
+        (n == 4 && (cp < 0x10000 || cp > 0x10ffff))) {
+        return 0;
+    }
+
+    return n;
+}
+
+/*
+ * Write a quoted string, truncating it if it does not fit. Bytes that are not
+ * valid UTF-8 are replaced with U+FFFD, one escape per byte, so that lines are
+ * always valid JSON.
+ */
+static void enc_quoted(Encoder *e, const char *s, size_t len)
+{
+    const unsigned char *u = (const unsigned char *) s;
+    char esc[6];
+    size_t n, step;
+
+    if (e->full || e->end - e->p < 2) {
+        enc_set_full(e);
+        return;
+    }
+
+    *e->p++ = '"';
+    for (size_t i = 0; i < len; i += step) {
+        step = (u[i] < 0x80) ? 1 : utf8_len(u + i, len - i);
+        if (step == 0) {
+            memcpy(esc, "\\ufffd", 6);
+            n = 6;
+            step = 1;
+        }
+        else {
+            n = (step == 1) ? escape_char(u[i], esc) : 0;
+        }
+        /* Keep one byte for the closing quote; sequences are never split. */
+        if ((size_t) (e->end - e->p) < ((n > 0) ? n : step) + 1) {
+            e->full = true;
+            break;
+        }
+        if (n > 0) {
+            memcpy(e->p, esc, n);
+            e->p += n;
+        }
+        else {
+            memcpy(e->p, s + i, step);
+            e->p += step;
+        }
+    }
+    *e->p++ = '"';
+}
+
+/* Whether a logfmt value must be quoted. */
+static bool logfmt_needs_quotes(const char *s, size_t len)
+{
+    const unsigned char *u = (const unsigned char *) s;
+    size_t step;
+
+    if (len == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < len; i += step) {
+        if (u[i] <= ' ' || u[i] == '=' || u[i] == '"' || u[i] == '\\' || u[i] == 0x7f) {
+            return true;
+        }
+        /* Invalid UTF-8 is replaced, which enc_quoted does. */
+        step = utf8_len(u + i, len - i);
+        if (step == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void enc_key(Encoder *e, const char *key)
+{
+    size_t len = strlen(key);
+
+    /* Start a field only if its key, escaped if need be, fits. */
+    if (e->full || (size_t) (e->end - e->p) < len * 6 + 4) {
+        e->full = true;
+        return;
+    }
+
+    e->field = e->p;
+    e->field_first = e->first;
+    e->value = NULL;
+    if (e->format == XLOG_FORMAT_JSON) {
+        if (!e->first) {
+            *e->p++ = ',';
+        }
+        enc_quoted(e, key, len);
+        *e->p++ = ':';
+    }
+    else {
+        if (!e->first) {
+            *e->p++ = ' ';
+        }
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char c = (unsigned char) key[i];
+            *e->p++ = (c <= ' ' || c == '=' || c == '"' || c == 0x7f) ? '_' : key[i];
+        }
+        *e->p++ = '=';
+    }
+    e->first = false;
+    e->value = e->p;
+}
+
+static void enc_str(Encoder *e, const char *s, size_t len)
+{
+    if (e->format == XLOG_FORMAT_JSON || logfmt_needs_quotes(s, len)) {
+        enc_quoted(e, s, len);
+    }
+    else {
+        enc_raw(e, s, len);
+    }
+}
+
+/* Format v in decimal into the end of buf, returning the first digit. */
+static char *u64_to_dec(uint64_t v, char *end)
+{
+    char *p = end;
+
+    do {
+        *--p = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    return p;
+}
+
+static void enc_u64(Encoder *e, uint64_t v)
+{
+    char buf[20];
+    char *p = u64_to_dec(v, buf + sizeof(buf));
+
+    enc_raw(e, p, (size_t) (buf + sizeof(buf) - p));
+}
+
+static void enc_i64(Encoder *e, int64_t v)
+{
+    char buf[21];
+    char *p;
+
+    p = u64_to_dec((v < 0) ? -(uint64_t) v : (uint64_t) v, buf + sizeof(buf));
+    if (v < 0) {
+        *--p = '-';
+    }
+    enc_raw(e, p, (size_t) (buf + sizeof(buf) - p));
+}
+
+/*
+ * Write a double with up to 6 decimals. Values too large or too small for that
+ * to be accurate fall back to %.17g, and non-finite values, which JSON cannot
+ * represent, are written as null (JSON) or NaN/+Inf/-Inf (logfmt).
+ */
+static void enc_double(Encoder *e, double d)
+{
+    char buf[32];
+    char *p;
+    uint64_t scaled, frac;
+    size_t len;
+    double mag = (d < 0) ? -d : d;
+
+    if (d != d || mag > DBL_MAX) {
+        if (e->format == XLOG_FORMAT_JSON) {
+            enc_raw(e, "null", 4);
+        }
+        else {
+            enc_raw(e, (d != d) ? "NaN" : (d < 0) ? "-Inf" : "+Inf", (d != d) ? 3 : 4);
+        }
+        return;
+    }
+
+    if (mag >= 1e12 || (mag != 0 && mag < 1e-6)) {
+        len = (size_t) snprintf(buf, sizeof(buf), "%.17g", d);
+        enc_raw(e, buf, len);
+        return;
+    }
+
+    scaled = (uint64_t) (mag * 1e6 + 0.5);
+    frac = scaled % 1000000;
+    p = buf + sizeof(buf);
+    if (frac != 0) {
+        int digits = 6;
+        while (frac % 10 == 0) {
+            frac /= 10;
+            --digits;
+        }
+        while (digits-- > 0) {
+            *--p = (char) ('0' + frac % 10);
+            frac /= 10;
+        }
+        *--p = '.';
+    }
+    p = u64_to_dec(scaled / 1000000, p);
+    if (d < 0 && scaled != 0) {
+        *--p = '-';
+    }
+    enc_raw(e, p, (size_t) (buf + sizeof(buf) - p));
+}
+
+static void put_2digits(char *p, unsigned int v)
+{
+    p[0] = (char) ('0' + v / 10);
+    p[1] = (char) ('0' + v % 10);
+}
+
+/*
+ * Format a realtime timestamp as RFC 3339 UTC with microseconds, converting
+ * days to a civil date arithmetically instead of calling gmtime_r.
+ */
+static size_t format_timestamp(const struct timespec *ts, char *buf)
+{
+    int64_t days = ts->tv_sec / 86400;
+    int64_t secs = ts->tv_sec % 86400;
+    int64_t era, z, doe, yoe, doy, mp, y;
+    unsigned int m, dd;
+    long usec = ts->tv_nsec / 1000;
+
+    if (secs < 0) {
+        secs += 86400;
+        --days;
+    }
+
+    /* From Howard Hinnant's civil_from_days. */
+    z = days + 719468;
+    era = ((z >= 0) ? z : z - 146096) / 146097;
+    doe = z - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    dd = (unsigned int) (doy - (153 * mp + 2) / 5 + 1);
+    m = (unsigned int) ((mp < 10) ? mp + 3 : mp - 9);
+    y = yoe + era * 400 + (m <= 2);
+
+    put_2digits(buf, (unsigned int) (y / 100 % 100));
+    put_2digits(buf + 2, (unsigned int) (y % 100));
+    buf[4] = '-';
+    put_2digits(buf + 5, m);
+    buf[7] = '-';
+    put_2digits(buf + 8, dd);
+    buf[10] = 'T';
+    put_2digits(buf + 11, (unsigned int) (secs / 3600));
+    buf[13] = ':';
+    put_2digits(buf + 14, (unsigned int) (secs / 60 % 60));
+    buf[16] = ':';
+    put_2digits(buf + 17, (unsigned int) (secs % 60));
+    buf[19] = '.';
+    for (int i = 25; i > 19; --i) {
+        buf[i] = (char) ('0' + usec % 10);
+        usec /= 10;
+    }
+    buf[26] = 'Z';
+
+    return 27;
+}
+
+static void enc_kv(Encoder *e, const XlogKv *kv)
+{
+    enc_key(e, kv->key);
+
+    switch (kv->type) {
+    case XLOG_KV_STR:
+        if (kv->v.s != NULL) {
+            enc_str(e, kv->v.s, strlen(kv->v.s));
+        }
+        else {
+            enc_raw(e, "null", 4);
+        }
+        break;
+    case XLOG_KV_INT:
+        enc_i64(e, kv->v.i);
+        break;
+    case XLOG_KV_UINT:
+        enc_u64(e, kv->v.u);
+        break;
+    case XLOG_KV_DOUBLE:
+        enc_double(e, kv->v.d);
+        break;
+    case XLOG_KV_BOOL:
+        enc_raw(e, kv->v.b ? "true" : "false", kv->v.b ? 4 : 5);
+        break;
+    }
+}
+
+static void write_line(XlogPriority priority, const char *buf, size_t len)
+{
+    int fd = (priority <= XLOG_WARNING) ? STDERR_FILENO : STDOUT_FILENO;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+}
+
+static void write_record(
+    XlogFormat format,
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *msg,
+    size_t msg_len,
+    const XlogKv *kv,
+    size_t nkv)
+{
+    char buf[XLOG_STRUCT_LINE_MAX];
+    char tsbuf[32];
+    Encoder e;
+    const char *level = xlog_priority_name(priority);
+
+    if (format != XLOG_FORMAT_LOGFMT) {
+        format = XLOG_FORMAT_JSON;
+    }
+
+    enc_init(&e, buf, sizeof(buf), format);
+    enc_key(&e, "ts");
+    enc_str(&e, tsbuf, format_timestamp(&xlog_time()->real, tsbuf));
+    enc_key(&e, "level");
+    enc_str(&e, level, strlen(level));
+    enc_key(&e, "tid");
+    enc_i64(&e, thread_id());
+    if (print_loc) {
+        enc_key(&e, "file");
+        enc_str(&e, file, strlen(file));
+        enc_key(&e, "line");
+        enc_i64(&e, line);
+        enc_key(&e, "func");
+        enc_str(&e, func, strlen(func));
+    }
+    enc_key(&e, "msg");
+    enc_str(&e, msg, msg_len);
+    for (size_t i = 0; i < nkv; ++i) {
+        enc_kv(&e, &kv[i]);
+    }
+
+    write_line(priority, buf, enc_finish(&e, buf));
+}
+
+void xlog_structured_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    char msg[XLOG_STRUCT_MSG_MAX];
+    int len;
+
+    len = vsnprintf(msg, sizeof(msg), fmt, args);
+    if (len < 0) {
+        len = 0;
+    }
+    else if ((size_t) len >= sizeof(msg)) {
+        len = sizeof(msg) - 1;
+    }
+
+    write_record(
+        xlog_get_log_format(), priority, print_loc, file, line, func, msg, (size_t) len, NULL, 0);
+}
+
+void _xlog_kv(
+    XlogPriority priority,
+    const char *file,
+    int line,
+    const char *func,
+    const char *msg,
+    const XlogKv *kv,
+    size_t nkv)
+{
+    char buf[XLOG_STRUCT_LINE_MAX];
+    XlogFunc log_func;
+    XlogFormat format;
+    Encoder e;
+    size_t len;
+
+    if (!xlog_enabled(priority)) {
+        return;
+    }
+
+    log_func = xlog_get_log_func();
+    format = xlog_get_log_format();
+    if (format != XLOG_FORMAT_TEXT &&
+        (log_func == xlog_default_func || log_func == xlog_structured_func)) {
+        _xlog_begin();
+        write_record(format, priority, true, file, line, func, msg, strlen(msg), kv, nkv);
+        _xlog_end();
+        return;
+    }
+
+    /* Any other sink gets the message with logfmt pairs appended. */
+    enc_init(&e, buf, sizeof(buf), XLOG_FORMAT_LOGFMT);
+    enc_raw(&e, msg, strlen(msg));
+    e.first = false;
+    for (size_t i = 0; i < nkv; ++i) {
+        enc_kv(&e, &kv[i]);
+    }
+    len = (size_t) (e.p - buf);
+    buf[len] = '\0';
+
+    _xlog(priority, true, file, line, func, "%s", buf);
+}
@@ -0,0 +1,331 @@
+/**
+ * @file      xpool.c
+ * @brief     Fixed-size object pool with per-thread caches.
+ *
+ *  Each thread has a few cache slots, picked by pool id. A slot taken over by
+ *  another pool, and every slot of an exiting thread, is flushed back to the
+ *  pool that filled it, as long as that pool is still alive and has not been
+ *  released since. Live pools are kept in a global list for that check, which
+ *  is only walked on those slow paths.
+ *
+ * @copyright Copyright (C) 2020 Xevo Inc. All Rights Reserved.
+ *
+ */
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <xlib/alloc.h>
+#include <xlib/xpool.h>
+
+/* Default number of objects per slab. */
+#define XPOOL_SLAB_OBJS 256
+
+/* Number of per-pool caches each thread has. */
+#define XPOOL_TCACHE_SLOTS 16
+
+/* Number of objects moved between a thread cache and its pool at once. */
+#define XPOOL_TCACHE_BATCH 32
+
+typedef struct xpool_obj {
+    struct xpool_obj *next;
+} xpool_obj;
+
+typedef struct xpool_slab {
+    struct xpool_slab *next;
+    alignas(max_align_t) char data[];
+} xpool_slab;
+
+struct xpool {
+    /* Live pools, protected by s_pools_lock. */
+    struct xpool *prev;
+    struct xpool *next;
+
+    size_t obj_size;
+    size_t slab_objs;
+    /* Identify the pool and its current generation in thread caches. */
+    uintptr_t id;
+    atomic_uintptr_t gen;
+
+    pthread_mutex_t lock;
+    /* The fields below are protected by lock. */
+    xpool_obj *free_list;
+    xpool_slab *slabs;
+    char *bump;
+    char *bump_end;
+};
+
+typedef struct xpool_tcache {
+    /* Pool that filled the cache; only used after checking it is alive. */
+    xpool *pool;
+    uintptr_t id;
+    uintptr_t gen;
+    xpool_obj *list;
+    size_t count;
+} xpool_tcache;
+
+static atomic_uintptr_t s_next_id = 1;
+static _Thread_local xpool_tcache s_tcache[XPOOL_TCACHE_SLOTS];
+static _Thread_local bool s_tcache_registered;
+
+static pthread_mutex_t s_pools_lock = PTHREAD_MUTEX_INITIALIZER;
+static xpool *s_pools;
+
+static pthread_once_t s_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_key;
+static bool s_key_valid;
+
+static void drain_tcache(xpool_tcache *tc);
+
+/* Flush every cache of an exiting thread. */
+static void tcache_destructor(void *value)
+{
+    xpool_tcache *tcache = value;
+
+    for (size_t i = 0; i < XPOOL_TCACHE_SLOTS; ++i) {
+        drain_tcache(&tcache[i]);
+    }
+}
+
+static void create_key(void)
+{
+    s_key_valid = (pthread_key_create(&s_key, tcache_destructor) == 0);
+}
+
+xpool *xpool_create(size_t obj_size, size_t slab_objs)
+{
+    xpool *pool;
+    size_t align = alignof(max_align_t);
+
+    pool = xcalloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (obj_size < sizeof(xpool_obj)) {
+        obj_size = sizeof(xpool_obj);
+    }
+    pool->obj_size = (obj_size + align - 1) & ~(align - 1);
+    pool->slab_objs = (slab_objs != 0) ? slab_objs : XPOOL_SLAB_OBJS;
+    pool->id = atomic_fetch_add(&s_next_id, 1);
+    atomic_init(&pool->gen, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+
+    pthread_mutex_lock(&s_pools_lock);
+    pool->next = s_pools;
+    if (s_pools != NULL) {
+        s_pools->prev = pool;
+    }
+    s_pools = pool;
+    pthread_mutex_unlock(&s_pools_lock);
+
+    return pool;
+}
+
+static void free_slabs(xpool_slab *slab)
+{
+    xpool_slab *next;
+
+    for (; slab != NULL; slab = next) {
+        next = slab->next;
+        xfree(slab);
+    }
+}
+
+void xpool_destroy(xpool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    /* Once unlinked, no thread cache flushes into the pool anymore. */
+    pthread_mutex_lock(&s_pools_lock);
+    if (pool->prev != NULL) {
+        pool->prev->next = pool->next;
+    }
+    else {
+        s_pools = pool->next;
+    }
+    if (pool->next != NULL) {
+        pool->next->prev = pool->prev;
+    }
+    pthread_mutex_unlock(&s_pools_lock);
+
+    free_slabs(pool->slabs);
+    pthread_mutex_destroy(&pool->lock);
+    xfree(pool);
+}
+
+void xpool_release(xpool *pool)
+{
+    xpool_slab *first;
+
+    /* Invalidate every thread cache holding objects of this pool. */
+    atomic_fetch_add(&pool->gen, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->free_list = NULL;
+    first = pool->slabs;
+    if (first != NULL) {
+        free_slabs(first->next);
+        first->next = NULL;
+        pool->bump = first->data;
+        pool->bump_end = first->data + pool->obj_size * pool->slab_objs;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Give every object of a cache back to the pool that filled it, and empty the
+ * cache. Objects of a destroyed pool, or of a released generation, are
+ * dropped: their memory is already gone or owned by the pool again.
+ */
+static void drain_tcache(xpool_tcache *tc)
+{
+    xpool_obj *last;
+    xpool *pool;
+
+    if (tc->list != NULL) {
+        pthread_mutex_lock(&s_pools_lock);
+        for (pool = s_pools; pool != NULL; pool = pool->next) {
+            if (pool == tc->pool && pool->id == tc->id) {
+                break;
+            }
+        }
+        if (pool != NULL &&
+            atomic_load_explicit(&pool->gen, memory_order_relaxed) == tc->gen) {
+            for (last = tc->list; last->next != NULL; last = last->next) {
+            }
+            pthread_mutex_lock(&pool->lock);
+            last->next = pool->free_list;
+            pool->free_list = tc->list;
+            pthread_mutex_unlock(&pool->lock);
+        }
+        pthread_mutex_unlock(&s_pools_lock);
+    }
+
+    tc->pool = NULL;
+    tc->id = 0;
+    tc->list = NULL;
+    tc->count = 0;
+}
+
+/*
+ * Find the calling thread's cache for the pool. A cache slot last used by
+ * another pool, or by an older generation of this one, is drained and taken
+ * over.
+ */
+static xpool_tcache *get_tcache(xpool *pool)
+{
+    xpool_tcache *tc = &s_tcache[pool->id % XPOOL_TCACHE_SLOTS];
+    uintptr_t gen = atomic_load_explicit(&pool->gen, memory_order_relaxed);
+
+    if (tc->id != pool->id || tc->gen != gen) {
+        drain_tcache(tc);
+        tc->pool = pool;
+        tc->id = pool->id;
+        tc->gen = gen;
+
+        /* Have the caches flushed when the thread exits. */
+        if (!s_tcache_registered) {
+            pthread_once(&s_key_once, create_key);
+            s_tcache_registered = s_key_valid &&
+                                  pthread_setspecific(s_key, s_tcache) == 0;
+        }
+    }
+
+    return tc;
+}
+
+/* Move a batch of objects from the pool to the thread cache. */
+static bool refill(xpool *pool, xpool_tcache *tc)
+{
+    xpool_obj *obj;
+    xpool_slab *slab;
+
+    pthread_mutex_lock(&pool->lock);
+    while (tc->count < XPOOL_TCACHE_BATCH) {
+        if (pool->free_list != NULL) {
+            obj = pool->free_list;
+            pool->free_list = obj->next;
+        }
+        else {
+            if (pool->bump == pool->bump_end) {
+                slab = xmalloc(sizeof(*slab) + pool->obj_size * pool->slab_objs);
+                if (slab == NULL) {
+                    break;
+                }
+                slab->next = pool->slabs;
+                pool->slabs = slab;
+                pool->bump = slab->data;
+                pool->bump_end = slab->data + pool->obj_size * pool->slab_objs;
+            }
+            obj = (xpool_obj *) pool->bump;
+            pool->bump += pool->obj_size;
+        }
+        obj->next = tc->list;
+        tc->list = obj;
+        ++tc->count;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return tc->count > 0;
+}
+
+/* Move a batch of objects from the thread cache back to the pool. */
+static void flush(xpool *pool, xpool_tcache *tc)
+{
+    xpool_obj *first = tc->list;
+    xpool_obj *last = first;
+
+    for (size_t i = 1; i < XPOOL_TCACHE_BATCH; ++i) {
+        last = last->next;
+    }
+    tc->list = last->next;
+    tc->count -= XPOOL_TCACHE_BATCH;
+
+    pthread_mutex_lock(&pool->lock);
+    last->next = pool->free_list;
+    pool->free_list = first;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void *xpool_alloc(xpool *pool)
+{
+    xpool_tcache *tc = get_tcache(pool);
+    xpool_obj *obj;
+
+    if (tc->list == NULL && !refill(pool, tc)) {
+        return NULL;
+    }
+
+    obj = tc->list;
+    tc->list = obj->next;
+    --tc->count;
+
+    return obj;
+}
+
+void xpool_free(xpool *pool, void *obj)
+{
+    xpool_tcache *tc;
+    xpool_obj *o = obj;
+
+    if (o == NULL) {
+        return;
+    }
+
+    tc = get_tcache(pool);
+    o->next = tc->list;
+    tc->list = o;
+    ++tc->count;
+
+    if (tc->count >= 2 * XPOOL_TCACHE_BATCH) {
+        flush(pool, tc);
+    }
+}
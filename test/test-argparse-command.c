@@ -0,0 +1,161 @@
+/*
+ * Tests of xargparse subcommands: global options, command selection, lazily
+ * built and reused command parsers, and unknown commands.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xargparse.h>
+
+#define NCOMMANDS 40
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static int count_pos(xargparse *self, const char *arg, void *ctx)
+{
+    (void) self;
+    (void) arg;
+    ++*(int *) ctx;
+    return 0;
+}
+
+int main(void)
+{
+    static char names[NCOMMANDS][16];
+    int debug = 0, port = 0, force = 0, npos = 0;
+    xargparse_entry globals[] = {
+        DEFINE_INT('d', "debug", debug, 0),
+        DEFINE_END()
+    };
+    xargparse_entry serve[] = {
+        DEFINE_INT('p', "port", port, 0),
+        DEFINE_END()
+    };
+    xargparse_entry rm[] = {
+        DEFINE_INT('f', "force", force, 0),
+        DEFINE_END()
+    };
+    xargparse *xa, *sub;
+
+    xa = xargparse_new(globals, NULL, NULL, NULL, NULL);
+    EXPECT(xa != NULL);
+
+    for (int i = 0; i < NCOMMANDS; i++) {
+        snprintf(names[i], sizeof(names[i]), "cmd%d", i);
+        EXPECT(xargparse_add_command(xa, names[i], rm, NULL, NULL) == 0);
+    }
+    EXPECT(xargparse_add_command(xa, "serve", serve, "Run the server", "[DIR]") == 0);
+    EXPECT(xargparse_add_command(xa, "serve", rm, NULL, NULL) == EEXIST);
+
+    /* Global options before the command, command options after it. */
+    {
+        char *argv[] = { "prog", "-d", "2", "serve", "--port=80", "www", NULL };
+
+        EXPECT(xargparse_parse(xa, 6, argv) == 0);
+        EXPECT(debug == 2);
+        EXPECT(port == 80);
+        EXPECT(strcmp(xargparse_command_name(xa), "serve") == 0);
+        sub = xargparse_command_parser(xa);
+        EXPECT(sub != NULL && xargparse_npos(sub) == 1);
+        EXPECT(strcmp(xargparse_pos(sub, 0), "www") == 0);
+        EXPECT(strcmp(argv[3], "serve") == 0);
+    }
+
+    /* The command parser is kept for later parses. */
+    {
+        char *argv[] = { "prog", "serve", "-p", "81", NULL };
+
+        EXPECT(xargparse_parse(xa, 4, argv) == 0);
+        EXPECT(port == 81);
+        EXPECT(xargparse_command_parser(xa) == sub);
+        EXPECT(xargparse_npos(sub) == 0);
+    }
+
+    {
+        char *argv[] = { "prog", "--", "cmd39", "-f1", "a", "b", NULL };
+
+        EXPECT(xargparse_parse(xa, 6, argv) == 0);
+        EXPECT(force == 1);
+        EXPECT(strcmp(xargparse_command_name(xa), "cmd39") == 0);
+        EXPECT(xargparse_npos(xargparse_command_parser(xa)) == 2);
+    }
+
+    /* Abbreviated global options take their value too. */
+    {
+        char *argv[] = { "prog", "--deb", "3", "serve", "-p", "83", NULL };
+
+        EXPECT(xargparse_parse(xa, 6, argv) == 0);
+        EXPECT(debug == 3);
+        EXPECT(port == 83);
+        EXPECT(strcmp(xargparse_command_name(xa), "serve") == 0);
+    }
+
+    /* The caller's argv is left alone, though argp permutes what it parses. */
+    {
+        char *argv[] = { "prog", "serve", "www", "--po", "84", NULL };
+
+        EXPECT(xargparse_parse(xa, 5, argv) == 0);
+        EXPECT(port == 84);
+        EXPECT(strcmp(argv[1], "serve") == 0);
+        EXPECT(strcmp(argv[2], "www") == 0);
+        EXPECT(strcmp(argv[3], "--po") == 0);
+    }
+
+    /* A callback set after the command parser was built still gets its arguments. */
+    {
+        char *argv[] = { "prog", "serve", "a", "b", NULL };
+
+        xargparse_set_pos_callback(xa, count_pos, &npos);
+        EXPECT(xargparse_parse(xa, 4, argv) == 0);
+        EXPECT(npos == 2);
+        xargparse_set_pos_callback(xa, NULL, NULL);
+    }
+
+    /* Options of another command are not accepted. */
+    {
+        char *argv[] = { "prog", "cmd0", "--port=1", NULL };
+
+        EXPECT(xargparse_parse(xa, 3, argv) != 0);
+    }
+
+    /* No command selects none; an unknown one is an error. */
+    {
+        char *argv[] = { "prog", "-d", "1", NULL };
+
+        EXPECT(xargparse_parse(xa, 3, argv) == 0);
+        EXPECT(xargparse_command_name(xa) == NULL);
+        EXPECT(xargparse_command_parser(xa) == NULL);
+    }
+    {
+        char *argv[] = { "prog", "bogus", NULL };
+
+        EXPECT(xargparse_parse(xa, 2, argv) == EINVAL);
+        EXPECT(xargparse_command_name(xa) == NULL);
+    }
+
+    /* An unknown option is reported instead of its value taken as the command. */
+    {
+        char *argv[] = { "prog", "--bogus", "serve", "x", NULL };
+
+        EXPECT(xargparse_parse(xa, 4, argv) != 0);
+        EXPECT(xargparse_command_name(xa) == NULL);
+    }
+
+    xargparse_free(xa);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
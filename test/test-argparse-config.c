@@ -0,0 +1,141 @@
+/*
+ * Tests of xargparse configuration layering: file, environment and command
+ * line applied over the defaults, each overriding the previous.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xlib/xargparse.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static void write_file(const char *path, const char *text, size_t len)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL || fwrite(text, 1, len, f) != len || fclose(f) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    static const char *const modes[] = { "fast", "safe", NULL };
+    static const char config[] =
+        "# tunables\n"
+        "  workers = 8\n"
+        "; another comment\r\n"
+        "name = \"from file\"\n"
+        "timeout=5s\n"
+        "\n"
+        "[cache]\n"
+        "size = 64M\n"
+        "mode = safe\n"
+        "[]\n"
+        "level = 3";
+    char path[] = "/tmp/xargconfigXXXXXX";
+    int workers = 1, level = 0, mode = 0;
+    uint64_t timeout = 0;
+    size_t cache_size = 0;
+    char name[32] = "default";
+    xargparse_entry entries[] = {
+        DEFINE_INT('w', "workers", workers, 0),
+        DEFINE_INT('l', "level", level, 0),
+        DEFINE_STRING('n', "name", name, sizeof(name), 0),
+        DEFINE_DURATION('t', "timeout", timeout, 0),
+        DEFINE_SIZE('c', "cache-size", cache_size, 0),
+        DEFINE_ENUM('m', "cache-mode", mode, modes, 0),
+        DEFINE_END()
+    };
+    char *argv[] = { "test", "--level=4", NULL };
+    xargparse *xa;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    xa = xargparse_new(entries, NULL, NULL, NULL, NULL);
+    EXPECT(xa != NULL);
+
+    /* File over defaults; the last line has no newline. */
+    write_file(path, config, sizeof(config) - 1);
+    EXPECT(xargparse_load_file(xa, path) == 0);
+    EXPECT(workers == 8);
+    EXPECT(strcmp(name, "from file") == 0);
+    EXPECT(timeout == UINT64_C(5000000000));
+    EXPECT(cache_size == 64 << 20);
+    EXPECT(mode == 1);
+    EXPECT(level == 3);
+
+    /* Environment over the file; unrelated variables are ignored. */
+    setenv("XTEST_WORKERS", "16", 1);
+    setenv("XTEST_CACHE_SIZE", "1k", 1);
+    setenv("XTEST_UNRELATED", "x", 1);
+    setenv("XTESTWORKERS", "99", 1);
+    EXPECT(xargparse_load_env(xa, "XTEST") == 0);
+    EXPECT(workers == 16);
+    EXPECT(cache_size == 1024);
+
+    /* Command line over the environment. */
+    EXPECT(xargparse_parse(xa, 2, argv) == 0);
+    EXPECT(level == 4);
+    EXPECT(workers == 16);
+
+    /* Bad lines are reported and skipped, the others applied. */
+    write_file(path, "workers = many\nbogus = 1\nno equals\nlevel = 7\n",
+               strlen("workers = many\nbogus = 1\nno equals\nlevel = 7\n"));
+    EXPECT(xargparse_load_file(xa, path) == EINVAL);
+    EXPECT(workers == 16);
+    EXPECT(level == 7);
+
+    setenv("XTEST_LEVEL", "99999999999", 1);
+    EXPECT(xargparse_load_env(xa, "XTEST") == ERANGE);
+    EXPECT(level == 7);
+
+    /* A file filling its last page exactly, without a final newline. */
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        char *big = malloc(page);
+        const char tail[] = "level=5";
+
+        memset(big, '#', page);
+        big[0] = '#';
+        big[page - sizeof(tail)] = '\n';
+        memcpy(big + page - sizeof(tail) + 1, tail, sizeof(tail) - 1);
+        write_file(path, big, page);
+        free(big);
+        EXPECT(xargparse_load_file(xa, path) == 0);
+        EXPECT(level == 5);
+    }
+
+    EXPECT(xargparse_load_file(xa, "/nonexistent/xargparse.conf") == ENOENT);
+
+    xargparse_free(xa);
+    unlink(path);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/*
+ * Tests of the native xargparse path against argp: each command line of the
+ * table is parsed twice, natively where possible and then with argp only
+ * (XARGPARSE_ARGP_ONLY), and both parses must agree on the result, the values
+ * set and the positional arguments. The table covers attached and separate
+ * option arguments, "--opt=val" and "--opt val", "--", permuted positional
+ * arguments, abbreviated long options and errors.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xlib/xargparse.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+#define MAX_WORDS 8
+#define MAX_POS 4
+
+/* A command line, without the program name, and whether it must parse. */
+typedef struct {
+    const char *words[MAX_WORDS];
+    bool ok;
+} Case;
+
+static const Case s_cases[] = {
+    /* Short options, argument attached or not. */
+    { { "-l5" }, true },
+    { { "-l", "5" }, true },
+    { { "-l", "-5" }, true },
+    { { "-c7", "-l1", "-l2" }, true },
+    { { "-o3" }, true },
+    { { "-n", "--level" }, true },
+    /* Long options, "--opt=val" and "--opt val". */
+    { { "--level=5" }, true },
+    { { "--level", "5" }, true },
+    { { "--level=-5" }, true },
+    { { "--name=a=b", "--bool", "1" }, true },
+    { { "--opt=4", "--count", "0x10" }, true },
+    /* Positional arguments, permuted, "-" and "--". */
+    { { "a", "-l3", "b", "--name", "x y", "c" }, true },
+    { { "-", "--count=2" }, true },
+    { { "--", "-l", "5" }, true },
+    { { "-l", "1", "--", "--name=x", "--" }, true },
+    { { "-c3", "x", "--", "-c4" }, true },
+    /* Abbreviations, left to argp by the native path. */
+    { { "--lev=4" }, true },
+    { { "--lev", "4", "p" }, true },
+    { { "--na", "x" }, true },
+    { { "--col=2" }, true },
+    /* Errors. */
+    { { "--co=1" }, false },
+    { { "--level=x" }, false },
+    { { "--level" }, false },
+    { { "-l" }, false },
+    { { "a", "-l" }, false },
+    { { "--nope" }, false },
+    { { "--nope=1", "a" }, false },
+    { { "-z" }, false },
+    { { "--count=-1" }, false },
+    { { "-c", "1x" }, false },
+    { { "--bool=maybe" }, false },
+    { { "a", "b", "c", "d", "e" }, false },
+};
+
+static bool s_flag;
+static int s_level, s_opt;
+static unsigned int s_count, s_color;
+static char s_name[32];
+
+/* What a parse did. */
+typedef struct {
+    bool ok;
+    bool flag;
+    int level, opt;
+    unsigned int count, color;
+    char name[32];
+    unsigned int npos;
+    char pos[MAX_POS][32];
+} Result;
+
+static void parse(xargparse *xa, const Case *c, bool argp_only, Result *r)
+{
+    char *argv[MAX_WORDS + 2];
+    int argc = 0, saved, null_fd;
+
+    s_flag = false;
+    s_level = -1;
+    s_opt = -1;
+    s_count = 0;
+    s_color = 0;
+    strcpy(s_name, "none");
+
+    /* argp permutes argv, so each parse gets a fresh copy. */
+    argv[argc++] = "test";
+    for (int i = 0; i < MAX_WORDS && c->words[i] != NULL; i++) {
+        argv[argc++] = strdup(c->words[i]);
+    }
+    argv[argc] = NULL;
+
+    if (argp_only) {
+        setenv("XARGPARSE_ARGP_ONLY", "1", 1);
+    }
+    else {
+        unsetenv("XARGPARSE_ARGP_ONLY");
+    }
+
+    /* argp reports errors on stderr. */
+    fflush(stderr);
+    saved = dup(STDERR_FILENO);
+    null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+    r->ok = (xargparse_parse(xa, argc, argv) == 0);
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+
+    r->flag = s_flag;
+    r->level = s_level;
+    r->opt = s_opt;
+    r->count = s_count;
+    r->color = s_color;
+    snprintf(r->name, sizeof(r->name), "%s", s_name);
+    r->npos = xargparse_npos(xa);
+    for (unsigned int i = 0; i < MAX_POS; i++) {
+        const char *pos = xargparse_pos(xa, i);
+        snprintf(r->pos[i], sizeof(r->pos[i]), "%s", (pos != NULL) ? pos : "");
+    }
+
+    for (int i = 1; i < argc; i++) {
+        free(argv[i]);
+    }
+}
+
+static bool same(const Result *a, const Result *b)
+{
+    if (a->ok != b->ok) {
+        return false;
+    }
+    /* After an error, only the error matters. */
+    if (!a->ok) {
+        return true;
+    }
+    if (a->flag != b->flag || a->level != b->level || a->opt != b->opt ||
+        a->count != b->count || a->color != b->color ||
+        strcmp(a->name, b->name) != 0 || a->npos != b->npos) {
+        return false;
+    }
+    for (unsigned int i = 0; i < MAX_POS; i++) {
+        if (strcmp(a->pos[i], b->pos[i]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_case(const Case *c)
+{
+    fprintf(stderr, "  test");
+    for (int i = 0; i < MAX_WORDS && c->words[i] != NULL; i++) {
+        fprintf(stderr, " '%s'", c->words[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(void)
+{
+    xargparse_entry entries[] = {
+        DEFINE_BOOL('b', "bool", s_flag, 0),
+        DEFINE_INT('l', "level", s_level, 0),
+        DEFINE_UINT('c', "count", s_count, 0),
+        DEFINE_UINT('k', "color", s_color, 0),
+        DEFINE_STRING('n', "name", s_name, sizeof(s_name), 0),
+        DEFINE_INT('o', "opt", s_opt, OPTION_ARG_OPTIONAL),
+        DEFINE_END()
+    };
+    Result native, argp;
+    xargparse *xa;
+
+    xa = xargparse_new(entries, NULL, NULL, NULL, NULL);
+    EXPECT(xa != NULL);
+    xargparse_set_pos_limits(xa, 0, MAX_POS);
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        const Case *c = &s_cases[i];
+
+        parse(xa, c, false, &native);
+        parse(xa, c, true, &argp);
+        if (!same(&native, &argp)) {
+            fprintf(stderr, "native and argp parses differ:\n");
+            print_case(c);
+            s_failures++;
+        }
+        if (native.ok != c->ok || argp.ok != c->ok) {
+            fprintf(stderr, "expected the parse to %s:\n", c->ok ? "succeed" : "fail");
+            print_case(c);
+            s_failures++;
+        }
+    }
+
+    /* Spot checks, so that both parsers cannot be wrong the same way. */
+    parse(xa, &s_cases[11], false, &native);
+    EXPECT(native.level == 3 && strcmp(native.name, "x y") == 0);
+    EXPECT(native.npos == 3 && strcmp(native.pos[0], "a") == 0 &&
+           strcmp(native.pos[1], "b") == 0 && strcmp(native.pos[2], "c") == 0);
+    parse(xa, &s_cases[14], false, &native);
+    EXPECT(native.level == 1 && strcmp(native.name, "none") == 0);
+    EXPECT(native.npos == 2 && strcmp(native.pos[0], "--name=x") == 0 &&
+           strcmp(native.pos[1], "--") == 0);
+    parse(xa, &s_cases[17], false, &native);
+    EXPECT(native.level == 4 && native.npos == 1);
+
+    unsetenv("XARGPARSE_ARGP_ONLY");
+    xargparse_free(xa);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
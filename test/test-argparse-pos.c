@@ -0,0 +1,131 @@
+/*
+ * Tests of xargparse positional arguments: unbounded storage, callback mode
+ * and response files, through both the native and the argp parse paths.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xlib/xargparse.h>
+
+#define NARGS 5000
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+typedef struct seen {
+    unsigned int count;
+    unsigned int stop_at;
+    char last[32];
+} seen;
+
+static int collect(xargparse *self, const char *arg, void *ctx)
+{
+    seen *s = ctx;
+
+    (void) self;
+    s->count++;
+    snprintf(s->last, sizeof(s->last), "%s", arg);
+    return (s->count == s->stop_at) ? 42 : 0;
+}
+
+int main(void)
+{
+    static char words[NARGS][16];
+    char *argv[NARGS + 4];
+    char path[] = "/tmp/xargposXXXXXX";
+    char at[sizeof(path) + 1];
+    int level = 0, fd;
+    xargparse_entry entries[] = {
+        DEFINE_INT('l', "level", level, 0),
+        DEFINE_END()
+    };
+    xargparse *xa;
+    seen s;
+
+    argv[0] = "test";
+    for (int i = 0; i < NARGS; i++) {
+        snprintf(words[i], sizeof(words[i]), "file%d", i);
+        argv[i + 1] = words[i];
+    }
+
+    xa = xargparse_new(entries, NULL, NULL, NULL, NULL);
+    EXPECT(xa != NULL);
+
+    /* Many more arguments than the old fixed array held. */
+    EXPECT(xargparse_parse(xa, NARGS + 1, argv) == 0);
+    EXPECT(xargparse_npos(xa) == NARGS);
+    EXPECT(strcmp(xargparse_pos(xa, NARGS - 1), "file4999") == 0);
+    EXPECT(xargparse_pos(xa, NARGS) == NULL);
+
+    /* Callback mode, stopped by the callback. */
+    memset(&s, 0, sizeof(s));
+    s.stop_at = 100;
+    xargparse_set_pos_callback(xa, collect, &s);
+    EXPECT(xargparse_parse(xa, NARGS + 1, argv) == 42);
+    EXPECT(s.count == 100);
+    EXPECT(strcmp(s.last, "file99") == 0);
+
+    /*
+     * A bad option after some arguments makes argp parse again: the
+     * arguments already handed out are not handed out twice.
+     */
+    memset(&s, 0, sizeof(s));
+    argv[3] = "--level=x";
+    EXPECT(xargparse_parse(xa, 5, argv) != 0);
+    EXPECT(s.count == 2);
+    argv[3] = words[2];
+
+    /* Response files, one argument per line, mixed with plain ones. */
+    fd = mkstemp(path);
+    EXPECT(fd >= 0);
+    EXPECT(write(fd, "a b\r\n\nc\nd", 9) == 9);
+    close(fd);
+    snprintf(at, sizeof(at), "@%s", path);
+
+    xargparse_set_pos_callback(xa, NULL, NULL);
+    xargparse_set_response_files(xa, true);
+    {
+        char *rargv[] = { "test", "x", at, "--level", "3", "y", NULL };
+
+        EXPECT(xargparse_parse(xa, 6, rargv) == 0);
+        EXPECT(level == 3);
+        EXPECT(xargparse_npos(xa) == 5);
+        EXPECT(strcmp(xargparse_pos(xa, 0), "x") == 0);
+        EXPECT(strcmp(xargparse_pos(xa, 1), "a b") == 0);
+        EXPECT(strcmp(xargparse_pos(xa, 2), "c") == 0);
+        EXPECT(strcmp(xargparse_pos(xa, 3), "d") == 0);
+        EXPECT(strcmp(xargparse_pos(xa, 4), "y") == 0);
+
+        /* Limits count the expanded arguments. */
+        xargparse_set_pos_limits(xa, 0, 4);
+        EXPECT(xargparse_parse(xa, 6, rargv) != 0);
+        xargparse_set_pos_limits(xa, 0, UINT_MAX);
+    }
+    {
+        char *rargv[] = { "test", "@/nonexistent/xargpos", NULL };
+
+        EXPECT(xargparse_parse(xa, 2, rargv) != 0);
+    }
+
+    unlink(path);
+    xargparse_free(xa);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
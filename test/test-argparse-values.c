@@ -0,0 +1,276 @@
+/*
+ * Tests of the xargparse value parsers: fixed cases, round trips and random
+ * strings checked against the C library parsers.
+ *
+ * Usage: xargvaluetest [seed]
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xargparse.h>
+
+#define FUZZ_ROUNDS 200000
+
+static unsigned int s_failures;
+
+#define EXPECT(cond, input) do {                                            \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: '%s': %s\n", __FILE__, __LINE__,        \
+                    (input), #cond);                                        \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static uint64_t s_rng;
+
+static uint64_t rnd(void)
+{
+    /* xorshift64* */
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * UINT64_C(2685821657736338717);
+}
+
+static void test_integers(void)
+{
+    static const struct {
+        const char *s;
+        int rc;
+        int64_t v;
+    } cases[] = {
+        { "0", 0, 0 },
+        { "-0", 0, 0 },
+        { "+17", 0, 17 },
+        { "-42", 0, -42 },
+        { "0x7fffffff", 0, INT32_MAX },
+        { "2147483647", 0, INT32_MAX },
+        { "-2147483648", 0, INT32_MIN },
+        { "2147483648", ERANGE, 0 },
+        { "-2147483649", ERANGE, 0 },
+        { "99999999999999999999999", ERANGE, 0 },
+        { "", EINVAL, 0 },
+        { "-", EINVAL, 0 },
+        { "0x", EINVAL, 0 },
+        { " 1", EINVAL, 0 },
+        { "1 ", EINVAL, 0 },
+        { "12abc", EINVAL, 0 },
+        { "99999999999999999999x", EINVAL, 0 },
+        { "1.0", EINVAL, 0 },
+    };
+    int v;
+    unsigned int u;
+    int64_t l;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        v = 12345;
+        EXPECT(xargparse_parse_int(cases[i].s, &v) == cases[i].rc, cases[i].s);
+        EXPECT(v == (cases[i].rc == 0 ? cases[i].v : 12345), cases[i].s);
+    }
+
+    EXPECT(xargparse_parse_uint("4294967295", &u) == 0 && u == UINT32_MAX, "4294967295");
+    EXPECT(xargparse_parse_uint("4294967296", &u) == ERANGE, "4294967296");
+    EXPECT(xargparse_parse_uint("-1", &u) == EINVAL, "-1");
+    EXPECT(xargparse_parse_uint("0xFFFFFFFF", &u) == 0 && u == UINT32_MAX, "0xFFFFFFFF");
+
+    EXPECT(xargparse_parse_int64("9223372036854775807", &l) == 0 && l == INT64_MAX,
+           "9223372036854775807");
+    EXPECT(xargparse_parse_int64("-9223372036854775808", &l) == 0 && l == INT64_MIN,
+           "-9223372036854775808");
+    EXPECT(xargparse_parse_int64("9223372036854775808", &l) == ERANGE,
+           "9223372036854775808");
+    EXPECT(xargparse_parse_int64("-9223372036854775809", &l) == ERANGE,
+           "-9223372036854775809");
+}
+
+static void test_double(void)
+{
+    static const struct {
+        const char *s;
+        int rc;
+        double v;
+    } cases[] = {
+        { "0", 0, 0.0 },
+        { "1.5", 0, 1.5 },
+        { "-.25", 0, -0.25 },
+        { "3.", 0, 3.0 },
+        { "1e3", 0, 1000.0 },
+        { "1E-3", 0, 0.001 },
+        { "0.1", 0, 0.1 },
+        { "123456789012345678901234567890", 0, 123456789012345678901234567890.0 },
+        { "4.9e-324", 0, 4.9e-324 },
+        { "1e309", ERANGE, 0 },
+        { "1e-400", ERANGE, 0 },
+        { "", EINVAL, 0 },
+        { ".", EINVAL, 0 },
+        { "1e", EINVAL, 0 },
+        { "1e+", EINVAL, 0 },
+        { "0x1p3", EINVAL, 0 },
+        { "1,5", EINVAL, 0 },
+        { " 1", EINVAL, 0 },
+        { "1.0f", EINVAL, 0 },
+    };
+    double d;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        d = 7.0;
+        EXPECT(xargparse_parse_double(cases[i].s, &d) == cases[i].rc, cases[i].s);
+        EXPECT(d == (cases[i].rc == 0 ? cases[i].v : 7.0), cases[i].s);
+    }
+
+    EXPECT(xargparse_parse_double("-inf", &d) == 0 && isinf(d) && d < 0, "-inf");
+    EXPECT(xargparse_parse_double("NaN", &d) == 0 && isnan(d), "NaN");
+}
+
+static void test_units(void)
+{
+    static const char *const colors[] = { "red", "green", "blue", NULL };
+    size_t sz;
+    uint64_t ns;
+    int e;
+    bool b;
+
+    EXPECT(xargparse_parse_size("4096", &sz) == 0 && sz == 4096, "4096");
+    EXPECT(xargparse_parse_size("4k", &sz) == 0 && sz == 4096, "4k");
+    EXPECT(xargparse_parse_size("2M", &sz) == 0 && sz == 2 << 20, "2M");
+    EXPECT(xargparse_parse_size("1GiB", &sz) == 0 && sz == 1 << 30, "1GiB");
+    EXPECT(xargparse_parse_size("3KB", &sz) == 0 && sz == 3 << 10, "3KB");
+    EXPECT(xargparse_parse_size("512B", &sz) == 0 && sz == 512, "512B");
+    EXPECT(xargparse_parse_size("16777216P", &sz) == ERANGE, "16777216P");
+    EXPECT(xargparse_parse_size("1X", &sz) == EINVAL, "1X");
+    EXPECT(xargparse_parse_size("k", &sz) == EINVAL, "k");
+    EXPECT(xargparse_parse_size("-1", &sz) == EINVAL, "-1");
+
+    EXPECT(xargparse_parse_duration("5", &ns) == 0 && ns == UINT64_C(5000000000), "5");
+    EXPECT(xargparse_parse_duration("250ms", &ns) == 0 && ns == UINT64_C(250000000), "250ms");
+    EXPECT(xargparse_parse_duration("1h30m", &ns) == 0 && ns == UINT64_C(5400000000000),
+           "1h30m");
+    EXPECT(xargparse_parse_duration("2d3s7ns", &ns) == 0 &&
+           ns == UINT64_C(172803000000007), "2d3s7ns");
+    EXPECT(xargparse_parse_duration("1s5", &ns) == EINVAL, "1s5");
+    EXPECT(xargparse_parse_duration("0s5", &ns) == EINVAL, "0s5");
+    EXPECT(xargparse_parse_duration("3w", &ns) == EINVAL, "3w");
+    EXPECT(xargparse_parse_duration("ms", &ns) == EINVAL, "ms");
+    EXPECT(xargparse_parse_duration("213504d", &ns) == ERANGE, "213504d");
+    EXPECT(xargparse_parse_duration("106751d23h47m16s854775807ns", &ns) == 0 &&
+           ns == INT64_MAX, "106751d23h47m16s854775807ns");
+
+    EXPECT(xargparse_parse_enum("green", colors, &e) == 0 && e == 1, "green");
+    EXPECT(xargparse_parse_enum("Green", colors, &e) == EINVAL, "Green");
+    EXPECT(xargparse_parse_enum("", colors, &e) == EINVAL, "");
+
+    EXPECT(xargparse_parse_bool("TRUE", &b) == 0 && b, "TRUE");
+    EXPECT(xargparse_parse_bool("off", &b) == 0 && !b, "off");
+    EXPECT(xargparse_parse_bool("maybe", &b) == EINVAL, "maybe");
+}
+
+/* Reference: strtoll on strings made only of a sign and digits. */
+static bool ref_int64(const char *s, int *rc, int64_t *v)
+{
+    const char *p = s;
+    int base = 10;
+    char *end;
+
+    if (*p == '+' || *p == '-') {
+        p++;
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+    if (*p == '\0' || strspn(p, base == 16 ? "0123456789abcdefABCDEF" : "0123456789")
+                      != strlen(p)) {
+        return false;
+    }
+
+    errno = 0;
+    *v = strtoll(s, &end, base);
+    *rc = errno;
+    return true;
+}
+
+static void fuzz(void)
+{
+    static const char alphabet[] = "0123456789+-.eExXkKMGiBnsumhd a";
+    char buf[40], msg[64];
+    size_t len;
+    int64_t l, ref;
+    double d, dref;
+    size_t sz;
+    uint64_t ns, bits;
+    int rc, refrc;
+    char *end;
+
+    for (int i = 0; i < FUZZ_ROUNDS; i++) {
+        /* Random strings over the characters the parsers care about. */
+        len = rnd() % 24;
+        for (size_t j = 0; j < len; j++) {
+            buf[j] = alphabet[rnd() % (sizeof(alphabet) - 1)];
+        }
+        buf[len] = '\0';
+
+        rc = xargparse_parse_int64(buf, &l);
+        if (ref_int64(buf, &refrc, &ref)) {
+            EXPECT(rc == refrc && (rc != 0 || l == ref), buf);
+        }
+        else {
+            EXPECT(rc == EINVAL, buf);
+        }
+
+        rc = xargparse_parse_double(buf, &d);
+        if (rc == 0) {
+            dref = strtod(buf, &end);
+            EXPECT(*end == '\0' && memcmp(&d, &dref, sizeof(d)) == 0, buf);
+        }
+
+        xargparse_parse_size(buf, &sz);
+        xargparse_parse_duration(buf, &ns);
+
+        /* Round trip of random integers. */
+        ref = (int64_t) rnd() >> (rnd() % 64);
+        snprintf(msg, sizeof(msg), "%" PRId64, ref);
+        EXPECT(xargparse_parse_int64(msg, &l) == 0 && l == ref, msg);
+
+        /* Round trip of random doubles, exact and through strtod. */
+        do {
+            bits = rnd();
+            memcpy(&d, &bits, sizeof(d));
+        } while (!isfinite(d) || d == 0.0 || fpclassify(d) == FP_SUBNORMAL);
+        snprintf(msg, sizeof(msg), "%.17g", d);
+        EXPECT(xargparse_parse_double(msg, &dref) == 0 &&
+               memcmp(&d, &dref, sizeof(d)) == 0, msg);
+
+        snprintf(msg, sizeof(msg), "%" PRIu64 ".%0*" PRIu64 "e%d",
+                 rnd() % 100000000, (int) (rnd() % 9) + 1, rnd() % 1000,
+                 (int) (rnd() % 60) - 30);
+        dref = strtod(msg, NULL);
+        EXPECT(xargparse_parse_double(msg, &d) == 0 &&
+               memcmp(&d, &dref, sizeof(d)) == 0, msg);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    s_rng = (argc > 1) ? strtoull(argv[1], NULL, 0) : UINT64_C(0x9e3779b97f4a7c15);
+    if (s_rng == 0) {
+        s_rng = 1;
+    }
+
+    test_integers();
+    test_double();
+    test_units();
+    fuzz();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -37,22 +37,22 @@ int main(int argc, char *argv[])
         DEFINE_END()
     };
 
-    xargparse xa;
+    xargparse *xa;
 
     printf("\n>>Test for extended argument parsing \n\n");
 
-    xargparse_init(&xa, xe,version,bug_addr,prg_doc,args_doc);
-    xargparse_parse(&xa, argc, argv);
+    xa = xargparse_new(xe,version,bug_addr,prg_doc,args_doc);
+    xargparse_parse(xa, argc, argv);
 
     printf("Command line flags: \n"
            "\titest=%d\n\tbtest=%d\n\tuitest=%d\n\tstest=%s\n",
            itest,btest,uitest,stest);
-    printf("\nPositional arguments:\tcount=%d \n", xa.npos_args);
-    for (uint i = 0; i < xa.npos_args; i++) {
-        printf("\t[%-2d]=%s\n",i+1,xa.pos_args[i]);
+    printf("\nPositional arguments:\tcount=%d \n", xargparse_npos(xa));
+    for (uint i = 0; i < xargparse_npos(xa); i++) {
+        printf("\t[%-2d]=%s\n",i+1,xargparse_pos(xa, i));
     }
 
-    xargparse_destroy(&xa);
+    xargparse_free(xa);
     exit(0);
 }
 
@@ -0,0 +1,223 @@
+/*
+ * Tests of xalgo: introsort and radix sort against qsort on several input
+ * shapes, binary searches against linear scans, and the order-preserving
+ * filters.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xalgo.h>
+#include <xlib/xvec.h>
+
+#define MAX_N 5000
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+typedef struct item {
+    int key;
+    int seq;
+} item;
+
+#define item_lt(a, b) ((a).key < (b).key)
+
+XVEC_ALGO_INIT(int, int, xv_generic_lt)
+XVEC_ALGO_INIT(item, item, item_lt)
+XVEC_RADIX_INIT(int, int)
+XVEC_RADIX_INIT(i8, int8_t)
+XVEC_RADIX_INIT(u64, uint64_t)
+XVEC_RADIX_INIT(i64, int64_t)
+
+static uint64_t s_rng = UINT64_C(0x9e3779b97f4a7c15);
+
+static uint64_t rnd(void)
+{
+    /* xorshift64* */
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * UINT64_C(2685821657736338717);
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int is_even(const int *x, void *ctx)
+{
+    (void) ctx;
+    return (*x & 1) == 0;
+}
+
+static int item_is_small(const item *x, void *ctx)
+{
+    return x->key < *(const int *) ctx;
+}
+
+/* Fill a with n values of the given shape. */
+static void fill(int *a, size_t n, int shape)
+{
+    for (size_t i = 0; i < n; i++) {
+        switch (shape) {
+        case 0: a[i] = (int) rnd(); break;
+        case 1: a[i] = (int) (rnd() % 4); break;
+        case 2: a[i] = (int) i; break;
+        case 3: a[i] = (int) (n - i); break;
+        case 4: a[i] = 7; break;
+        default: a[i] = (i & 1) ? (int) i : (int) (n - i); break;
+        }
+    }
+}
+
+static void test_sort(void)
+{
+    static const size_t sizes[] = { 0, 1, 2, 3, 15, 16, 17, 100, 1000, MAX_N };
+    static int a[MAX_N], b[MAX_N], c[MAX_N];
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+
+        for (int shape = 0; shape < 6; shape++) {
+            fill(a, n, shape);
+            memcpy(b, a, sizeof(int) * n);
+            memcpy(c, a, sizeof(int) * n);
+            qsort(a, n, sizeof(int), cmp_int);
+            xv_sort_int(b, n);
+            EXPECT(memcmp(a, b, sizeof(int) * n) == 0);
+            EXPECT(xv_radix_sort_int(c, n) == 0);
+            EXPECT(memcmp(a, c, sizeof(int) * n) == 0);
+        }
+    }
+
+    /* Radix sort on narrow and wide, signed and unsigned types. */
+    {
+        int8_t s8[256];
+        static int64_t s64[MAX_N], r64[MAX_N];
+        static uint64_t u64[MAX_N];
+
+        for (int i = 0; i < 256; i++) {
+            s8[i] = (int8_t) (127 - i);
+        }
+        EXPECT(xv_radix_sort_i8(s8, 256) == 0);
+        for (int i = 0; i < 256; i++) {
+            EXPECT(s8[i] == i - 128);
+        }
+
+        for (size_t i = 0; i < MAX_N; i++) {
+            s64[i] = r64[i] = (int64_t) rnd();
+            u64[i] = rnd();
+        }
+        u64[0] = UINT64_MAX;
+        u64[1] = 0;
+        qsort(r64, MAX_N, sizeof(int64_t), cmp_i64);
+        EXPECT(xv_radix_sort_i64(s64, MAX_N) == 0);
+        EXPECT(memcmp(s64, r64, sizeof(s64)) == 0);
+        EXPECT(xv_radix_sort_u64(u64, MAX_N) == 0);
+        EXPECT(u64[0] == 0 && u64[MAX_N - 1] == UINT64_MAX);
+        for (size_t i = 1; i < MAX_N; i++) {
+            EXPECT(u64[i - 1] <= u64[i]);
+        }
+    }
+}
+
+static void test_search(void)
+{
+    int a[200];
+    size_t n = 0, lo, hi;
+
+    /* Runs of equal values with gaps between them. */
+    for (int v = 0; v < 50; v++) {
+        for (int k = 0; k < v % 4; k++) {
+            a[n++] = v * 2;
+        }
+    }
+
+    for (int key = -1; key <= 101; key++) {
+        for (lo = 0; lo < n && a[lo] < key; lo++) {
+        }
+        for (hi = lo; hi < n && a[hi] == key; hi++) {
+        }
+        EXPECT(xv_lower_bound_int(a, n, key) == lo);
+        EXPECT(xv_upper_bound_int(a, n, key) == hi);
+        EXPECT(xv_bsearch_int(a, n, key) == ((lo < hi) ? lo : n));
+    }
+    EXPECT(xv_lower_bound_int(a, 0, 5) == 0);
+    EXPECT(xv_bsearch_int(a, 0, 5) == 0);
+}
+
+static void test_filters(void)
+{
+    xvec_t(int) v;
+    item items[100];
+    int limit = 3, last[10];
+    size_t k;
+
+    xv_init(v);
+    for (int i = 0; i < 20; i++) {
+        xv_push(int, v, i / 2);
+    }
+    xv_unique(int, v);
+    EXPECT(xv_size(v) == 10);
+    for (int i = 0; i < 10; i++) {
+        EXPECT(xv_A(v, i) == i);
+    }
+    xv_filter(int, v, is_even, NULL);
+    EXPECT(xv_size(v) == 5);
+    for (int i = 0; i < 5; i++) {
+        EXPECT(xv_A(v, i) == i * 2);
+    }
+    xv_destroy(v);
+
+    /* Stable partition keeps the order within both groups. */
+    for (int i = 0; i < 100; i++) {
+        items[i].key = (int) (rnd() % 10);
+        items[i].seq = i;
+    }
+    k = xv_stable_partition_item(items, 100, item_is_small, &limit);
+    EXPECT(k != (size_t) -1);
+    memset(last, -1, sizeof(last));
+    for (size_t i = 0; i < 100; i++) {
+        EXPECT((items[i].key < limit) == (i < k));
+        EXPECT(items[i].seq > last[items[i].key]);
+        last[items[i].key] = items[i].seq;
+    }
+    EXPECT(xv_stable_partition_item(items, k, item_is_small, &limit) == k);
+
+    /* Stable sort is not promised, but equal keys must stay together. */
+    xv_sort_item(items, 100);
+    for (size_t i = 1; i < 100; i++) {
+        EXPECT(items[i - 1].key <= items[i].key);
+    }
+}
+
+int main(void)
+{
+    test_sort();
+    test_search();
+    test_filters();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+ * Tests of xarena: bump allocation, mark/rewind and reset, and containers
+ * bound to an arena through alloc.h being grown and destroyed after their
+ * arena is unbound or another one is bound.
+ */
+
+#define XLIB_ALLOC_ARENA
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xarena.h>
+#include <xlib/xhash.h>
+#include <xlib/xvec.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+XHASH_MAP_INIT_INT(num, int)
+
+static void test_alloc(void)
+{
+    xarena a;
+    xarena_mark mark;
+    char *p, *q;
+
+    xarena_init(&a, 256);
+    p = xarena_alloc(&a, 10);
+    q = xarena_alloc_align(&a, 1, 64);
+    EXPECT(p != NULL && q != NULL);
+    EXPECT((uintptr_t) p % XARENA_ALIGN == 0 && (uintptr_t) q % 64 == 0);
+
+    mark = xarena_get_mark(&a);
+    for (int i = 0; i < 100; i++) {
+        EXPECT(xarena_alloc(&a, 100) != NULL);
+    }
+    EXPECT(xarena_alloc(&a, 100000) != NULL);
+    xarena_rewind(&a, mark);
+    EXPECT(xarena_alloc_align(&a, 1, 64) == q + 64);
+
+    xarena_reset(&a);
+    xarena_destroy(&a);
+}
+
+static void test_bound(void)
+{
+    xarena a, b;
+    xvec_t(int) before, v, w;
+    xhash_t(num) *h;
+    int *last;
+    xhint_t k;
+    int ret;
+
+    xarena_init(&a, 0);
+    xarena_init(&b, 0);
+
+    /* Created before binding: libc memory, destroyed while bound. */
+    xv_init(before);
+    xv_push(int, before, 1);
+
+    EXPECT(xarena_bind(&a) == NULL);
+    xv_init(v);
+    for (int i = 0; i < 1000; i++) {
+        xv_push(int, v, i);
+    }
+    h = xh_init(num);
+    for (int i = 0; i < 1000; i++) {
+        k = xh_put(num, h, i, &ret);
+        xh_value(h, k) = i;
+    }
+    for (int i = 0; i < 1000; i++) {
+        xv_push(int, before, i);
+    }
+    EXPECT(xv_size(before) == 1001 && xv_A(before, 1000) == 999);
+
+    /* The most recent allocation grows in place. */
+    xv_init(w);
+    xv_resize(int, w, 4);
+    last = w.a;
+    xv_resize(int, w, 64);
+    EXPECT(w.a == last);
+
+    /* Grown while another arena is bound: stays in its own arena. */
+    EXPECT(xarena_bind(&b) == &a);
+    for (int i = 1000; i < 5000; i++) {
+        xv_push(int, v, i);
+    }
+    EXPECT(b.chunk == NULL);
+    for (int i = 1000; i < 3000; i++) {
+        k = xh_put(num, h, i, &ret);
+        xh_value(h, k) = i;
+    }
+
+    /* Grown and destroyed with nothing bound. */
+    EXPECT(xarena_bind(NULL) == &b);
+    for (int i = 5000; i < 6000; i++) {
+        xv_push(int, v, i);
+    }
+    EXPECT(xv_size(v) == 6000);
+    for (int i = 0; i < 6000; i++) {
+        if (xv_A(v, i) != i) {
+            EXPECT(xv_A(v, i) == i);
+            break;
+        }
+    }
+    EXPECT(xh_size(h) == 3000);
+    EXPECT(xh_value(h, xh_get(num, h, 2999)) == 2999);
+    xv_destroy(v);
+    xv_destroy(w);
+    xh_destroy(num, h);
+
+    /* The libc vector goes back to libc with an arena bound. */
+    xarena_bind(&a);
+    xv_destroy(before);
+    xarena_bind(NULL);
+
+    xarena_destroy(&a);
+    xarena_destroy(&b);
+}
+
+int main(void)
+{
+    test_alloc();
+    test_bound();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/*
+ * Tests of the xassert tiers: enabled tiers evaluate their expression once and
+ * abort when it is false, disabled tiers never evaluate it. Built once per
+ * XASSERT_LEVEL.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <xlib/xassert.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static int s_evals;
+
+static int count(int v)
+{
+    s_evals++;
+    return v;
+}
+
+/* Run a check in a child process; returns whether it aborted. */
+#define ABORTS(check) __extension__ ({                                      \
+        pid_t _pid;                                                         \
+        int _status = 0;                                                    \
+        fflush(NULL);                                                       \
+        _pid = fork();                                                      \
+        if (_pid == 0) {                                                    \
+            /* Keep the expected failure reports out of the test output. */ \
+            freopen("/dev/null", "w", stderr);                              \
+            check                                                           \
+            _exit(0);                                                       \
+        }                                                                   \
+        waitpid(_pid, &_status, 0);                                         \
+        WIFSIGNALED(_status) && WTERMSIG(_status) == SIGABRT;               \
+    })
+
+static void test_always(void)
+{
+    s_evals = 0;
+    XASSERT(count(1));
+    XASSERT_LT(count(1), 2);
+    EXPECT(s_evals == 2);
+
+    EXPECT(ABORTS(XASSERT(count(0));));
+    EXPECT(ABORTS(XASSERT_GTE(count(1), 2);));
+    EXPECT(!ABORTS(XASSERT_GTE(count(2), 2);));
+}
+
+static void test_debug(void)
+{
+    s_evals = 0;
+    XASSERT_DEBUG(count(1));
+    XASSERT_DEBUG_EQ(count(3), 3);
+    XASSERT_DEBUG_NEQ(count(3), 4);
+#if XASSERT_LEVEL >= XASSERT_LEVEL_DEBUG
+    EXPECT(s_evals == 3);
+    EXPECT(ABORTS(XASSERT_DEBUG(count(0));));
+    EXPECT(ABORTS(XASSERT_DEBUG_GT(count(1), 1);));
+#else
+    EXPECT(s_evals == 0);
+    EXPECT(!ABORTS(XASSERT_DEBUG(count(0));));
+    EXPECT(!ABORTS(XASSERT_DEBUG_GT(count(1), 1);));
+#endif
+}
+
+static void test_paranoid(void)
+{
+    s_evals = 0;
+    XASSERT_PARANOID(count(1));
+    XASSERT_PARANOID_LTE(count(3), 3);
+#if XASSERT_LEVEL >= XASSERT_LEVEL_PARANOID
+    EXPECT(s_evals == 2);
+    EXPECT(ABORTS(XASSERT_PARANOID(count(0));));
+    EXPECT(ABORTS(XASSERT_PARANOID_LT(count(1), 1);));
+#else
+    EXPECT(s_evals == 0);
+    EXPECT(!ABORTS(XASSERT_PARANOID(count(0));));
+    EXPECT(!ABORTS(XASSERT_PARANOID_LT(count(1), 1);));
+#endif
+}
+
+int main(void)
+{
+    test_always();
+    test_debug();
+    test_paranoid();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/*
+ * Tests of xassert failure handling: operands are formatted without printf,
+ * and each kind of failing assertion is run in a child process, which must
+ * abort after reporting the expression, its location and its operands. Crash
+ * reports must include queued async log messages and cover stack overflows in
+ * any thread given an alternate stack.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <xlib/xassert.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+/* Output of the last failure run. */
+static char s_out[16384];
+
+/*
+ * Run fn in a child process with its stderr captured in s_out. Returns the
+ * signal that killed the child, or 0 if it exited.
+ */
+static int run_failure(void (*fn)(void))
+{
+    int fds[2], status;
+    size_t len = 0;
+    ssize_t n;
+    pid_t pid;
+
+    fflush(NULL);
+    if (pipe(fds) < 0) {
+        return -1;
+    }
+    pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDERR_FILENO);
+        fn();
+        _exit(0);
+    }
+    close(fds[1]);
+    while (len < sizeof(s_out) - 1 &&
+           (n = read(fds[0], s_out + len, sizeof(s_out) - 1 - len)) > 0) {
+        len += (size_t) n;
+    }
+    s_out[len] = '\0';
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+}
+
+#define EXPECT_OUT(text) EXPECT(strstr(s_out, text) != NULL)
+
+/* The line of the assertion in fail_plain. */
+static const int s_plain_line = __LINE__ + 6;
+
+static void fail_plain(void)
+{
+    int x = 1;
+
+    XASSERT(x == 2);
+}
+
+static void fail_lt(void)
+{
+    int x = 3;
+
+    XASSERT_LT(x, 2);
+}
+
+static void fail_streq(void)
+{
+    XASSERT_STREQ("abc", "abd");
+}
+
+static void fail_fmt(void)
+{
+    XASSERT_EQ_FMT("%#x", 0x10, 0x20);
+}
+
+static void fail_flteq(void)
+{
+    XASSERT_DBLEQ(1.0, 2.5);
+}
+
+static void fail_fnptr(void)
+{
+    void (*volatile fn)(void) = fail_plain;
+
+    XASSERT_EQ(fn, NULL);
+}
+
+static void pass_all(void)
+{
+    int x = 1;
+
+    XASSERT(x == 1);
+    XASSERT_LT(x, 2);
+    XASSERT_STREQ("abc", "abc");
+    XASSERT_EQ_FMT("%d", x, 1);
+}
+
+static void test_reports(void)
+{
+    char loc[512];
+
+    EXPECT(run_failure(fail_plain) == SIGABRT);
+    EXPECT_OUT("Assert: failed expression (x == 2)");
+    snprintf(loc, sizeof(loc), "%s:%d [fail_plain]", __FILE__, s_plain_line);
+    EXPECT_OUT(loc);
+    EXPECT_OUT("Backtrace:");
+
+    EXPECT(run_failure(fail_lt) == SIGABRT);
+    EXPECT_OUT("Assert: failed expression ((x) < (2))");
+    EXPECT_OUT("[fail_lt]");
+    EXPECT_OUT("LHS: 3\nRHS: 2");
+
+    EXPECT(run_failure(fail_streq) == SIGABRT);
+    EXPECT_OUT("LHS: abc\nRHS: abd");
+
+    EXPECT(run_failure(fail_fmt) == SIGABRT);
+    EXPECT_OUT("LHS: 0x10\nRHS: 0x20");
+
+    EXPECT(run_failure(fail_flteq) == SIGABRT);
+    EXPECT_OUT("LHS: 1.000000\nRHS: 2.500000");
+
+    EXPECT(run_failure(fail_fnptr) == SIGABRT);
+    EXPECT_OUT("LHS: 0x");
+    EXPECT_OUT("RHS: (nil)");
+
+    EXPECT(run_failure(pass_all) == 0);
+    EXPECT(s_out[0] == '\0');
+}
+
+/* Format an operand captured as by the comparison assertions. */
+#define OPERAND_IS(x, text) do {                                            \
+        XassertOperand _op = _XASSERT_OPERAND(x);                           \
+        char _buf[64];                                                      \
+        size_t _len = xassert_format_operand(&_op, _buf, sizeof(_buf));     \
+        EXPECT(_len == strlen(text) && strcmp(_buf, text) == 0);            \
+    } while (0)
+
+static void test_operands(void)
+{
+    const char *str = "text";
+    XassertOperand op;
+    char buf[64];
+
+    OPERAND_IS(0, "0");
+    OPERAND_IS(-42, "-42");
+    OPERAND_IS(INT64_MIN, "-9223372036854775808");
+    OPERAND_IS(UINT64_MAX, "18446744073709551615");
+    OPERAND_IS((uint8_t) 200, "200");
+    OPERAND_IS((short) -7, "-7");
+    OPERAND_IS((_Bool) 1, "1");
+    OPERAND_IS((char) 'q', "q");
+    OPERAND_IS(1.5, "1.500000");
+    OPERAND_IS(-0.25f, "-0.250000");
+    OPERAND_IS(1e20, "1.000000e+20");
+    OPERAND_IS(NAN, "nan");
+    OPERAND_IS(-INFINITY, "-inf");
+    OPERAND_IS((void *) NULL, "(nil)");
+    OPERAND_IS((void *) 0x1234, "0x1234");
+    OPERAND_IS((const volatile int *) 0xbeef, "0xbeef");
+
+    /* Function pointers are pointers too. */
+    op = _XASSERT_OPERAND(fail_plain);
+    EXPECT(op.kind == XASSERT_OPERAND_PTR && op.v.p == (uintptr_t) fail_plain);
+    op = _XASSERT_OPERAND((void (*)(void)) NULL);
+    EXPECT(op.kind == XASSERT_OPERAND_PTR && op.v.p == 0);
+
+    op = _xassert_op_str(str);
+    EXPECT(xassert_format_operand(&op, buf, sizeof(buf)) == 4);
+    EXPECT(strcmp(buf, "text") == 0);
+    op = _xassert_op_str(NULL);
+    EXPECT(xassert_format_operand(&op, buf, sizeof(buf)) == 6);
+    EXPECT(strcmp(buf, "(null)") == 0);
+
+    /* Text is truncated to the buffer and always terminated. */
+    op = _XASSERT_OPERAND(123456);
+    EXPECT(xassert_format_operand(&op, buf, 4) == 3 && strcmp(buf, "123") == 0);
+    op = _xassert_op_str(str);
+    EXPECT(xassert_format_operand(&op, buf, 1) == 0 && buf[0] == '\0');
+}
+
+static void fail_async(void)
+{
+    XlogAsyncConfig config;
+
+    memset(&config, 0, sizeof(config));
+    /* The writer thread does not wake up before the failure. */
+    config.idle_ms = 60 * 1000;
+    xlog_async_start(&config);
+    xlog(XLOG_ERR, "queued %d", 42);
+    XASSERT(0);
+}
+
+static volatile int s_depth_limit;
+
+__attribute__ ((noinline))
+static int recurse(int depth)
+{
+    volatile char frame[1024];
+
+    frame[0] = (char) depth;
+    if (s_depth_limit == 0 || depth < s_depth_limit) {
+        return recurse(depth + 1) + frame[0];
+    }
+    return frame[0];
+}
+
+static void *overflow_main(void *arg)
+{
+    (void) arg;
+    if (xassert_thread_init() != 0) {
+        return NULL;
+    }
+    return (void *) (intptr_t) recurse(0);
+}
+
+static void fail_overflow(void)
+{
+    pthread_t thread;
+
+    if (xassert_install_crash_handlers() != 0) {
+        return;
+    }
+    pthread_create(&thread, NULL, overflow_main, NULL);
+    pthread_join(thread, NULL);
+}
+
+static void *thread_init_main(void *arg)
+{
+    bool ok = xassert_thread_init() == 0 && xassert_thread_init() == 0;
+
+    (void) arg;
+    return (void *) (intptr_t) ok;
+}
+
+static void test_crashes(void)
+{
+    pthread_t thread;
+    void *ok;
+
+    EXPECT(run_failure(fail_async) == SIGABRT);
+    EXPECT_OUT("queued 42");
+    EXPECT(strstr(s_out, "queued 42") < strstr(s_out, "Backtrace:"));
+
+    EXPECT(run_failure(fail_overflow) == SIGSEGV);
+    EXPECT_OUT("Fatal signal 11 (SIGSEGV)");
+    EXPECT_OUT("Backtrace:");
+
+    /* Threads get their own stack, which is freed when they exit. */
+    for (int i = 0; i < 100; i++) {
+        EXPECT(pthread_create(&thread, NULL, thread_init_main, NULL) == 0);
+        EXPECT(pthread_join(thread, &ok) == 0 && ok != NULL);
+    }
+}
+
+int main(void)
+{
+    test_operands();
+    test_reports();
+    test_crashes();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
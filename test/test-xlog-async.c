@@ -0,0 +1,274 @@
+/*
+ * Tests of asynchronous logging: what a full queue does in drop and block
+ * mode, the order of messages written by xlog_flush, xlog_flush_signal_safe and
+ * the writer thread, and stopping the writer thread.
+ *
+ * The writer thread is given a long idle time, so that it sleeps through a
+ * test unless something wakes it up. Messages go to stdout and the drop
+ * reports to stderr, both captured in temporary files.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+/* Longer than any test, so that the writer thread only runs when woken up. */
+#define IDLE_MS (60 * 1000)
+
+/* A file descriptor redirected to a temporary file. */
+typedef struct {
+    int fd;
+    int saved;
+    int file;
+} Capture;
+
+static void capture_start(Capture *cap, int fd)
+{
+    char path[] = "/tmp/xlog-async-XXXXXX";
+
+    fflush(NULL);
+    cap->fd = fd;
+    cap->file = mkstemp(path);
+    unlink(path);
+    cap->saved = dup(fd);
+    dup2(cap->file, fd);
+}
+
+/* Read what was written so far into buf, NUL-terminated. */
+static const char *capture_read(const Capture *cap, char *buf, size_t size)
+{
+    ssize_t n = pread(cap->file, buf, size - 1, 0);
+
+    buf[(n > 0) ? n : 0] = '\0';
+    return buf;
+}
+
+static void capture_end(Capture *cap)
+{
+    fflush(NULL);
+    dup2(cap->saved, cap->fd);
+    close(cap->saved);
+    close(cap->file);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Let the writer thread run its first, empty drain and go to sleep. */
+static void settle(void)
+{
+    struct timespec ts = { 0, 50 * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+static int start(size_t queue_len, XlogAsyncPolicy overflow, bool deferred)
+{
+    XlogAsyncConfig config;
+    int err;
+
+    memset(&config, 0, sizeof(config));
+    config.queue_len = queue_len;
+    config.overflow = overflow;
+    config.idle_ms = IDLE_MS;
+    config.deferred_format = deferred;
+    err = xlog_async_start(&config);
+    settle();
+
+    return err;
+}
+
+/* Count the lines prefix0, prefix1, ... up to n found in order in out. */
+static int count_in_order(const char *out, const char *prefix, int n)
+{
+    char text[64];
+    const char *p = out;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        snprintf(text, sizeof(text), "\n%s%d\n", prefix, i);
+        p = strstr(p, text);
+        if (p == NULL) {
+            break;
+        }
+        p++;
+    }
+    return i;
+}
+
+static void test_drop(void)
+{
+    static char buf[65536];
+    Capture out, err;
+    size_t dropped = xlog_async_dropped();
+
+    capture_start(&out, STDOUT_FILENO);
+    EXPECT(start(8, XLOG_ASYNC_DROP, false) == 0);
+
+    /* The queue holds 8 messages; the writer is asleep, so the rest go. */
+    for (int i = 0; i < 20; i++) {
+        xlog(XLOG_INFO, "drop %d", i);
+    }
+    EXPECT(xlog_async_dropped() - dropped == 12);
+
+    xlog_flush();
+    capture_read(&out, buf, sizeof(buf));
+    EXPECT(count_in_order(buf, "drop ", 20) == 8);
+    EXPECT(strstr(buf, "drop 8\n") == NULL);
+
+    /* Room again after the flush. */
+    xlog(XLOG_INFO, "after %d", 0);
+    capture_start(&err, STDERR_FILENO);
+    xlog_async_stop();
+    capture_read(&err, buf, sizeof(buf));
+    capture_end(&err);
+    EXPECT(strstr(buf, "xlog: dropped 12 messages\n") != NULL);
+    capture_read(&out, buf, sizeof(buf));
+    EXPECT(count_in_order(buf, "after ", 1) == 1);
+
+    capture_end(&out);
+}
+
+static void test_block(void)
+{
+    static char buf[1 << 20];
+    Capture out;
+    size_t dropped = xlog_async_dropped();
+
+    capture_start(&out, STDOUT_FILENO);
+    EXPECT(start(8, XLOG_ASYNC_BLOCK, false) == 0);
+
+    /* A full queue wakes the sleeping writer up instead of dropping. */
+    for (int i = 0; i < 2000; i++) {
+        xlog(XLOG_INFO, "block %d", i);
+    }
+    xlog_flush();
+    EXPECT(xlog_async_dropped() == dropped);
+    capture_read(&out, buf, sizeof(buf));
+    EXPECT(count_in_order(buf, "block ", 2000) == 2000);
+
+    xlog_async_stop();
+    capture_end(&out);
+}
+
+static void test_flush_order(void)
+{
+    static char buf[65536];
+    Capture out;
+    const char *p;
+
+    capture_start(&out, STDOUT_FILENO);
+    EXPECT(start(64, XLOG_ASYNC_DROP, false) == 0);
+    for (int i = 0; i < 3; i++) {
+        xlog(XLOG_INFO, "order %d", i);
+    }
+    xlog_flush();
+    EXPECT(count_in_order(capture_read(&out, buf, sizeof(buf)), "order ", 3) == 3);
+    for (int i = 3; i < 6; i++) {
+        xlog(XLOG_INFO, "order %d", i);
+    }
+    xlog_flush_signal_safe();
+    EXPECT(count_in_order(capture_read(&out, buf, sizeof(buf)), "order ", 6) == 6);
+    xlog_async_stop();
+
+    /* Deferred messages cannot be formatted safely: their format is written. */
+    EXPECT(start(64, XLOG_ASYNC_DROP, true) == 0);
+    xlog(XLOG_INFO, "deferred %d", 0);
+    xlog_flush_signal_safe();
+    xlog(XLOG_INFO, "deferred %d", 1);
+    xlog_flush();
+    xlog_async_stop();
+    capture_read(&out, buf, sizeof(buf));
+    p = strstr(buf, "test-xlog-async.c:");
+    EXPECT(p != NULL && strstr(p, "[test_flush_order]:\ndeferred %d\n") != NULL);
+    EXPECT(p != NULL && strstr(p, "deferred %d\n") < strstr(p, "deferred 1\n"));
+
+    capture_end(&out);
+}
+
+static void null_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) line;
+    (void) func;
+    (void) fmt;
+    (void) args;
+}
+
+static void test_shutdown(void)
+{
+    static char buf[65536];
+    Capture out;
+    double t;
+
+    xlog_set_log_func(null_func);
+    capture_start(&out, STDOUT_FILENO);
+    EXPECT(start(64, XLOG_ASYNC_DROP, false) == 0);
+    EXPECT(xlog_get_log_func() == xlog_async_func);
+    EXPECT(start(64, XLOG_ASYNC_DROP, false) == EBUSY);
+
+    /* Stopping wakes the writer up, writes everything out and returns. */
+    xlog(XLOG_INFO, "stop %d", 0);
+    xlog(XLOG_INFO, "stop %d", 1);
+    t = now();
+    xlog_async_stop();
+    EXPECT(now() - t < 5.0);
+    EXPECT(count_in_order(capture_read(&out, buf, sizeof(buf)), "stop ", 2) == 2);
+    EXPECT(xlog_get_log_func() == null_func);
+    xlog_async_stop();
+
+    /* The backend can be started again. */
+    EXPECT(start(64, XLOG_ASYNC_DROP, false) == 0);
+    xlog(XLOG_INFO, "restart %d", 0);
+    xlog_async_stop();
+    EXPECT(count_in_order(capture_read(&out, buf, sizeof(buf)), "restart ", 1) == 1);
+
+    capture_end(&out);
+    xlog_set_log_func(xlog_default_func);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+
+    test_drop();
+    test_block();
+    test_flush_order();
+    test_shutdown();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+ * Tests of xlog categories and runtime configuration: the level spec parser,
+ * with good, bad and empty values, priorities remembered for categories
+ * registered later, configuration files and reloading them on a signal.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+XLOG_CATEGORY_DEFINE(s_net, "net");
+XLOG_CATEGORY_DEFINE(s_io, "io");
+
+static int global_priority(void)
+{
+    int priority = XLOG_DEBUG;
+
+    while (priority > XLOG_EMERG && !xlog_enabled((XlogPriority) priority)) {
+        priority--;
+    }
+    return priority;
+}
+
+static void test_good(void)
+{
+    EXPECT(xlog_config_apply("warning, net=debug, io=info") == 0);
+    EXPECT(global_priority() == XLOG_WARNING);
+    EXPECT(s_net.priority == XLOG_DEBUG);
+    EXPECT(s_io.priority == XLOG_INFO);
+
+    /* Numbers, aliases, comments and any separators. */
+    EXPECT(xlog_config_apply("# levels\n3\tnet=error # trailing\n io=warn,,") == 0);
+    EXPECT(global_priority() == XLOG_ERR);
+    EXPECT(s_net.priority == XLOG_ERR);
+    EXPECT(s_io.priority == XLOG_WARNING);
+
+    EXPECT(xlog_config_apply("notice net=7 io=default") == 0);
+    EXPECT(global_priority() == XLOG_NOTICE);
+    EXPECT(s_net.priority == XLOG_DEBUG);
+    EXPECT(s_io.priority == -1);
+    EXPECT(xlog_config_apply("") == 0);
+    EXPECT(xlog_config_apply("  # nothing\n") == 0);
+}
+
+static void test_bad(void)
+{
+    static const char *const bad[] = {
+        "net=", "net= ", "net=#", "=debug", "net=8", "net=-1", "net=+5",
+        "net=\v5", "net=5x", "net=debugx", "net=DEBUG", "loud", "default", "8",
+    };
+
+    EXPECT(xlog_config_apply("warning net=info io=info") == 0);
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        if (xlog_config_apply(bad[i]) != EINVAL) {
+            fprintf(stderr, "accepted \"%s\"\n", bad[i]);
+            s_failures++;
+        }
+    }
+    EXPECT(global_priority() == XLOG_WARNING);
+    EXPECT(s_net.priority == XLOG_INFO);
+
+    /* An empty value fails, and does not mute the category; others apply. */
+    EXPECT(xlog_config_apply("net=,io=debug") == EINVAL);
+    EXPECT(s_net.priority == XLOG_INFO);
+    EXPECT(s_io.priority == XLOG_DEBUG);
+
+    EXPECT(xlog_set_category_priority("nope", XLOG_INFO) == ENOENT);
+}
+
+static void test_remembered(void)
+{
+    static XlogCategory later = { "later", -1, NULL };
+
+    EXPECT(xlog_config_apply("later=crit") == 0);
+    xlog_category_register(&later);
+    EXPECT(later.priority == XLOG_CRIT);
+    EXPECT(xlog_set_category_priority("later", XLOG_ALERT) == 0);
+    EXPECT(later.priority == XLOG_ALERT);
+}
+
+static void write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f != NULL) {
+        fputs(text, f);
+        fclose(f);
+    }
+}
+
+/* Wait up to two seconds for a category to get a priority. */
+static bool wait_priority(const XlogCategory *cat, int priority)
+{
+    struct timespec ts = { 0, 1000000 };
+
+    for (int i = 0; i < 2000; i++) {
+        if (__atomic_load_n(&cat->priority, __ATOMIC_RELAXED) == priority) {
+            return true;
+        }
+        nanosleep(&ts, NULL);
+    }
+    return false;
+}
+
+static void test_files(void)
+{
+    char path[] = "/tmp/xlog-config-XXXXXX";
+    int fd = mkstemp(path);
+
+    EXPECT(fd >= 0);
+    close(fd);
+
+    write_file(path, "info\nnet=err\n");
+    EXPECT(xlog_config_load(path) == 0);
+    EXPECT(global_priority() == XLOG_INFO);
+    EXPECT(s_net.priority == XLOG_ERR);
+    EXPECT(xlog_config_load("/nonexistent/xlog.conf") == ENOENT);
+
+    /* The file is read again on each signal. */
+    EXPECT(xlog_config_reload_on_signal(SIGUSR1, path) == 0);
+    EXPECT(xlog_config_reload_on_signal(SIGUSR2, path) == EBUSY);
+    write_file(path, "net=debug\n");
+    raise(SIGUSR1);
+    EXPECT(wait_priority(&s_net, XLOG_DEBUG));
+
+    /* Bad entries in a reloaded file are skipped; io comes after net= here. */
+    write_file(path, "net=\nio=crit\n");
+    raise(SIGUSR1);
+    EXPECT(wait_priority(&s_io, XLOG_CRIT));
+    EXPECT(s_net.priority == XLOG_DEBUG);
+
+    unlink(path);
+}
+
+int main(void)
+{
+    test_good();
+    test_bad();
+    test_remembered();
+    test_files();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*
+ * Tests of deferred formatting: arguments are copied when a message is logged
+ * and formatted by the writer, with the same result as printf. Messages that
+ * cannot be deferred are formatted immediately instead.
+ *
+ * xlog_flush_signal_safe writes deferred messages with their format string
+ * unexpanded, which tells deferred messages from immediately formatted ones.
+ */
+
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static int s_saved_fd, s_file;
+static char s_out[65536];
+
+/* Send stdout, where the async backend writes XLOG_INFO messages, to a file. */
+static void capture_start(void)
+{
+    char path[] = "/tmp/xlog-deferred-XXXXXX";
+
+    fflush(NULL);
+    s_file = mkstemp(path);
+    unlink(path);
+    s_saved_fd = dup(STDOUT_FILENO);
+    dup2(s_file, STDOUT_FILENO);
+}
+
+/* Read what was written since the last call. */
+static const char *capture_read(void)
+{
+    static off_t offset;
+    ssize_t n = pread(s_file, s_out, sizeof(s_out) - 1, offset);
+
+    n = (n > 0) ? n : 0;
+    s_out[n] = '\0';
+    offset += n;
+    return s_out;
+}
+
+static void capture_end(void)
+{
+    fflush(NULL);
+    dup2(s_saved_fd, STDOUT_FILENO);
+    close(s_saved_fd);
+    close(s_file);
+}
+
+/* Whether the message written since the last check ends with text. */
+#define EXPECT_MSG(text) do {                                               \
+        const char *_out = capture_read();                                  \
+        size_t _len = strlen(_out), _n = strlen(text "\n");                 \
+        EXPECT(_len >= _n && strcmp(_out + _len - _n, text "\n") == 0);     \
+    } while (0)
+
+static void test_conversions(void)
+{
+    char expected[128];
+    intmax_t big = INTMAX_MIN;
+    char str[] = "before";
+
+    xlog(XLOG_INFO, "%d|%5.2f|%-4x|%c|%%|%s", -7, 3.14159, 0xab, 'z', "end");
+    xlog_flush();
+    EXPECT_MSG("-7| 3.14|ab  |z|%|end");
+
+    xlog(XLOG_INFO, "%Lf %jd %zu %td", 1.5L, big, (size_t) 42, (ptrdiff_t) -3);
+    xlog_flush();
+    EXPECT_MSG("1.500000 -9223372036854775808 42 -3");
+
+    xlog(XLOG_INFO, "%lld %lu %hd %hhu", -1LL, 7UL, (short) -2, (unsigned char) 255);
+    xlog_flush();
+    EXPECT_MSG("-1 7 -2 255");
+
+    xlog(XLOG_INFO, "%*d|%-*.*f|%p", 4, 1, 8, 3, 2.0, (void *) 0x10);
+    xlog_flush();
+    snprintf(expected, sizeof(expected), "%*d|%-*.*f|%p", 4, 1, 8, 3, 2.0, (void *) 0x10);
+    EXPECT(strstr(capture_read(), expected) != NULL);
+
+    /* Strings are copied when the message is logged. */
+    xlog(XLOG_INFO, "%s %s", str, (const char *) NULL);
+    strcpy(str, "after");
+    xlog_flush();
+    EXPECT_MSG("before (null)");
+}
+
+static void test_precision(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    char *map, *buf;
+
+    /* Four bytes right before an inaccessible page, with no terminator. */
+    map = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    EXPECT(map != MAP_FAILED);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    EXPECT(mprotect(map + page, page, PROT_NONE) == 0);
+    buf = map + page - 4;
+    memcpy(buf, "abcd", 4);
+
+    xlog(XLOG_INFO, "[%.*s]", 4, buf);
+    xlog(XLOG_INFO, "[%.3s]", buf);
+    xlog(XLOG_INFO, "[%6.2s]", buf);
+    xlog(XLOG_INFO, "[%.*s]", -1, "negative means none");
+    xlog(XLOG_INFO, "[%.*s]", 0, buf);
+    xlog_flush();
+    capture_read();
+    EXPECT(strstr(s_out, "\n[abcd]\n") != NULL);
+    EXPECT(strstr(s_out, "\n[abc]\n") != NULL);
+    EXPECT(strstr(s_out, "\n[    ab]\n") != NULL);
+    EXPECT(strstr(s_out, "\n[negative means none]\n") != NULL);
+    EXPECT(strstr(s_out, "\n[]\n") != NULL);
+
+    /* These were deferred, not formatted immediately. */
+    xlog(XLOG_INFO, "[%.*s]", 4, buf);
+    xlog_flush_signal_safe();
+    EXPECT_MSG("[%.*s]");
+
+    munmap(map, 2 * page);
+}
+
+static void test_fallback(void)
+{
+    char big[1024];
+
+    /* Wide strings are not deferred: the message is formatted right away. */
+    xlog(XLOG_INFO, "wide %ls %d", L"text", 5);
+    xlog_flush_signal_safe();
+    EXPECT_MSG("wide text 5");
+
+    /* Neither are arguments that do not fit a record; the text is cut. */
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    xlog(XLOG_INFO, "big %s", big);
+    xlog_flush_signal_safe();
+    capture_read();
+    EXPECT(strstr(s_out, "big xxxx") != NULL);
+    EXPECT(strstr(s_out, "big %s") == NULL);
+}
+
+int main(void)
+{
+    XlogAsyncConfig config;
+    struct timespec settle = { 0, 50 * 1000000 };
+
+    xlog_set_log_priority(XLOG_INFO);
+    memset(&config, 0, sizeof(config));
+    config.deferred_format = true;
+    /* The writer thread sleeps through the test; the test flushes. */
+    config.idle_ms = 60 * 1000;
+
+    capture_start();
+    EXPECT(xlog_async_start(&config) == 0);
+    nanosleep(&settle, NULL);
+
+    test_conversions();
+    test_precision();
+    test_fallback();
+
+    xlog_async_stop();
+    capture_end();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
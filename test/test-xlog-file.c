@@ -0,0 +1,263 @@
+/*
+ * Tests of the file-backed sinks: rotation of the file sink by size, with the
+ * names and number of the rotated files, reopening an existing file, and the
+ * flight recorder wrapping around, read and dumped oldest first.
+ *
+ * Files are created in a temporary directory, removed at the end.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static char s_dir[] = "/tmp/xlog-file-XXXXXX";
+
+static void make_path(char *buf, size_t size, const char *name)
+{
+    snprintf(buf, size, "%s/%s", s_dir, name);
+}
+
+/* Read a whole file into buf, NUL-terminated; returns its length or -1. */
+static long read_file(const char *path, char *buf, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    ssize_t n;
+
+    if (fd < 0) {
+        return -1;
+    }
+    n = read(fd, buf, size - 1);
+    close(fd);
+    n = (n > 0) ? n : 0;
+    buf[n] = '\0';
+    return (long) n;
+}
+
+static bool exists(const char *path)
+{
+    struct stat st;
+
+    return stat(path, &st) == 0;
+}
+
+/*
+ * Check that text holds the messages "<prefix>first" up to "<prefix>last",
+ * in order and with no other message with that prefix. Returns the number of
+ * messages found.
+ */
+static int check_run(const char *text, const char *prefix, int first, int last)
+{
+    size_t plen = strlen(prefix);
+    const char *p = text;
+    int expected = first, n = 0;
+
+    while ((p = strstr(p, prefix)) != NULL) {
+        int v = atoi(p + plen);
+        if (v != expected) {
+            fprintf(stderr, "found %s%d, expected %s%d\n", prefix, v, prefix, expected);
+            s_failures++;
+            return n;
+        }
+        expected++;
+        n++;
+        p += plen;
+    }
+    EXPECT(expected == last + 1);
+    return n;
+}
+
+static void test_rotation(void)
+{
+    XlogFileSinkConfig config;
+    char path[128], rotated[256], all[16384], buf[4096];
+    long len;
+
+    make_path(path, sizeof(path), "rot.log");
+    memset(&config, 0, sizeof(config));
+    config.path = path;
+    config.max_size = 512;
+    config.max_files = 3;
+    EXPECT(xlog_file_sink_open(&config) == 0);
+    EXPECT(xlog_file_sink_open(&config) == EBUSY);
+
+    xlog_set_log_func(xlog_file_sink_func);
+    for (int i = 0; i < 60; i++) {
+        xlog(XLOG_INFO, "rot %d;", i);
+    }
+    xlog_set_log_func(xlog_default_func);
+    xlog_file_sink_close();
+
+    /* rot.log.3 is the oldest kept, rot.log the newest; rot.log.4 never exists. */
+    all[0] = '\0';
+    for (int i = 3; i >= 0; i--) {
+        if (i > 0) {
+            snprintf(rotated, sizeof(rotated), "%s.%d", path, i);
+        }
+        else {
+            snprintf(rotated, sizeof(rotated), "%s", path);
+        }
+        len = read_file(rotated, buf, sizeof(buf));
+        EXPECT(len > 0 && len <= 512);
+        EXPECT(len > 0 && buf[len - 1] == '\n');
+        if (len > 0) {
+            strcat(all, buf);
+        }
+    }
+    snprintf(rotated, sizeof(rotated), "%s.4", path);
+    EXPECT(!exists(rotated));
+
+    /* The kept files hold the most recent messages, unsplit and in order. */
+    {
+        const char *first = strstr(all, "rot ");
+        int n = (first != NULL) ? atoi(first + 4) : 60;
+        EXPECT(n > 0);
+        EXPECT(check_run(all, "rot ", n, 59) == 60 - n);
+    }
+
+    for (int i = 1; i <= 3; i++) {
+        snprintf(rotated, sizeof(rotated), "%s.%d", path, i);
+        unlink(rotated);
+    }
+    unlink(path);
+}
+
+static void test_reopen(void)
+{
+    XlogFileSinkConfig config;
+    char path[128], rotated[256], buf[4096];
+    long len;
+
+    make_path(path, sizeof(path), "reopen.log");
+    memset(&config, 0, sizeof(config));
+    config.path = path;
+
+    /* Messages are appended to an existing file. */
+    EXPECT(xlog_file_sink_open(&config) == 0);
+    xlog_set_log_func(xlog_file_sink_func);
+    xlog(XLOG_INFO, "open %d;", 0);
+    xlog_file_sink_close();
+    EXPECT(xlog_file_sink_open(&config) == 0);
+    xlog(XLOG_INFO, "open %d;", 1);
+    xlog_file_sink_close();
+    /* Messages logged while the sink is closed are dropped. */
+    xlog(XLOG_INFO, "open %d;", 2);
+    len = read_file(path, buf, sizeof(buf));
+    EXPECT(check_run(buf, "open ", 0, 1) == 2);
+
+    /* Its size counts: an existing file over the limit is rotated first. */
+    config.max_size = (size_t) len;
+    config.max_files = 1;
+    EXPECT(xlog_file_sink_open(&config) == 0);
+    xlog(XLOG_INFO, "open %d;", 3);
+    xlog_set_log_func(xlog_default_func);
+    xlog_file_sink_close();
+
+    snprintf(rotated, sizeof(rotated), "%s.1", path);
+    EXPECT(read_file(rotated, buf, sizeof(buf)) == len);
+    EXPECT(check_run(buf, "open ", 0, 1) == 2);
+    EXPECT(read_file(path, buf, sizeof(buf)) > 0);
+    EXPECT(check_run(buf, "open ", 3, 3) == 1);
+
+    unlink(rotated);
+    unlink(path);
+}
+
+static void test_ring(void)
+{
+    static char buf[16384], dumped[16384];
+    char path[256], dump_path[256];
+    size_t len;
+    long dlen;
+    int fd;
+    const char *nl;
+
+    make_path(path, sizeof(path), "ring");
+    EXPECT(xlog_ring_sink_open(1000, path) == 0);
+    EXPECT(xlog_ring_sink_open(1000, NULL) == EBUSY);
+    xlog_set_log_func(xlog_ring_sink_func);
+
+    /* Before wrapping around, everything logged is read back. */
+    xlog(XLOG_INFO, "ring %d;", 0);
+    len = xlog_ring_sink_read(buf, sizeof(buf) - 1);
+    buf[len] = '\0';
+    EXPECT(len > 0 && buf[len - 1] == '\n');
+    EXPECT(check_run(buf, "ring ", 0, 0) == 1);
+
+    /* The size is rounded up to 4096; 400 messages wrap around several times. */
+    for (int i = 1; i < 400; i++) {
+        xlog(XLOG_INFO, "ring %d;", i);
+    }
+    len = xlog_ring_sink_read(buf, sizeof(buf) - 1);
+    buf[len] = '\0';
+    EXPECT(len == 4096);
+    /* The oldest line may be cut; from the next one, lines are in order. */
+    nl = strchr(buf, '\n');
+    EXPECT(nl != NULL && buf[len - 1] == '\n');
+    if (nl != NULL) {
+        const char *first = strstr(nl, "ring ");
+        int n = (first != NULL) ? atoi(first + 5) : 0;
+        EXPECT(n > 300);
+        EXPECT(check_run(nl, "ring ", n, 399) == 400 - n);
+    }
+
+    /* A short read gets the most recent bytes. */
+    EXPECT(xlog_ring_sink_read(dumped, 64) == 64);
+    EXPECT(memcmp(dumped, buf + len - 64, 64) == 0);
+
+    /* A dump writes the same bytes as a read. */
+    make_path(dump_path, sizeof(dump_path), "dump");
+    fd = open(dump_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+    xlog_ring_sink_dump(fd);
+    close(fd);
+    dlen = read_file(dump_path, dumped, sizeof(dumped));
+    EXPECT(dlen == (long) len && memcmp(dumped, buf, len) == 0);
+
+    /* The mapped file starts with the magic string. */
+    EXPECT(read_file(path, dumped, 9) == 8 && strcmp(dumped, "XLOGRING") == 0);
+
+    xlog_set_log_func(xlog_default_func);
+    xlog_ring_sink_close();
+    EXPECT(xlog_ring_sink_read(buf, sizeof(buf)) == 0);
+
+    unlink(dump_path);
+    unlink(path);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+    if (mkdtemp(s_dir) == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    test_rotation();
+    test_reopen();
+    test_ring();
+
+    rmdir(s_dir);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+ * Tests of the xlog level checks: messages less urgent than
+ * XLOG_COMPILE_LEVEL are compiled out, and those less urgent than the runtime
+ * priority are skipped without evaluating their arguments.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* XLOG_DEBUG messages are compiled out of this file. */
+#define XLOG_COMPILE_LEVEL XLOG_INFO
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static int s_logged;
+static int s_evals;
+
+static void count_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) line;
+    (void) func;
+    (void) fmt;
+    (void) args;
+    s_logged++;
+}
+
+static int count(void)
+{
+    return ++s_evals;
+}
+
+XLOG_CATEGORY_DEFINE(s_cat, "level-test");
+
+static void reset(void)
+{
+    s_logged = 0;
+    s_evals = 0;
+}
+
+int main(void)
+{
+    xlog_set_log_func(count_func);
+
+    /* Compiled out: never logged nor evaluated, whatever the priority. */
+    xlog_set_log_priority(XLOG_DEBUG);
+    reset();
+    xlog(XLOG_DEBUG, "%d", count());
+    xlog_nofmt(XLOG_DEBUG, "debug");
+    xlog_cat(&s_cat, XLOG_DEBUG, "%d", count());
+    xlog_kv(XLOG_DEBUG, "kv", xlog_kv_int("n", count()));
+    EXPECT(s_logged == 0 && s_evals == 0);
+    /* The runtime check still sees them as enabled. */
+    EXPECT(xlog_enabled(XLOG_DEBUG));
+
+    /* Enabled at compile time: the runtime priority decides. */
+    reset();
+    xlog(XLOG_INFO, "%d", count());
+    xlog_cat(&s_cat, XLOG_INFO, "%d", count());
+    xlog_kv(XLOG_INFO, "kv", xlog_kv_int("n", count()));
+    EXPECT(s_logged == 3 && s_evals == 3);
+
+    xlog_set_log_priority(XLOG_WARNING);
+    reset();
+    xlog(XLOG_INFO, "%d", count());
+    xlog_nofmt(XLOG_INFO, "info");
+    xlog_cat(&s_cat, XLOG_INFO, "%d", count());
+    xlog_kv(XLOG_INFO, "kv", xlog_kv_int("n", count()));
+    EXPECT(s_logged == 0 && s_evals == 0);
+    EXPECT(!xlog_enabled(XLOG_INFO));
+    EXPECT(xlog_enabled(XLOG_WARNING));
+
+    reset();
+    xlog(XLOG_WARNING, "%d", count());
+    xlog(XLOG_ERR, "%d", count());
+    EXPECT(s_logged == 2 && s_evals == 2);
+
+    xlog_set_log_func(xlog_default_func);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
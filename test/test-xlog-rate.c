@@ -0,0 +1,189 @@
+/*
+ * Tests of per-call-site rate limiting: which messages a burst lets through,
+ * the report of the messages dropped, whether the site logs again, is flushed
+ * or the process exits, and the independence of call sites.
+ *
+ * The rate is 10 messages per second, so that a burst logged in a loop takes
+ * far less than one emission interval.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+#define MAX_LINES 128
+
+/* Messages logged, formatted, with their line. */
+static char s_lines[MAX_LINES][128];
+static int s_line_nos[MAX_LINES];
+static int s_nlines;
+
+static void record_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) func;
+    if (s_nlines < MAX_LINES) {
+        vsnprintf(s_lines[s_nlines], sizeof(s_lines[0]), fmt, args);
+        s_line_nos[s_nlines] = line;
+        s_nlines++;
+    }
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+static int s_site_a_line;
+
+/* Log n messages from a single call site. */
+static void site_a(int n)
+{
+    for (int i = 0; i < n; i++) {
+        s_site_a_line = __LINE__ + 1;
+        xlog_rl(XLOG_INFO, "a %d", i);
+    }
+}
+
+static void site_b(int n)
+{
+    for (int i = 0; i < n; i++) {
+        xlog_rl(XLOG_INFO, "b %d", i);
+    }
+}
+
+static void test_burst(void)
+{
+    /* A burst of 3 goes through, the rest is dropped. */
+    s_nlines = 0;
+    site_a(10);
+    EXPECT(s_nlines == 3);
+    EXPECT(strcmp(s_lines[0], "a 0") == 0);
+    EXPECT(strcmp(s_lines[2], "a 2") == 0);
+
+    /* Another site has its own budget. */
+    site_b(2);
+    EXPECT(s_nlines == 5);
+    EXPECT(strcmp(s_lines[4], "b 1") == 0);
+
+    /* The count is reported with the site's location, once. */
+    xlog_rl_flush();
+    EXPECT(s_nlines == 6);
+    EXPECT(strcmp(s_lines[5], "message repeated 7 times (rate limited)") == 0);
+    EXPECT(s_line_nos[5] == s_site_a_line);
+    xlog_flush();
+    EXPECT(s_nlines == 6);
+
+    /* One interval later, the site may log one message again. */
+    sleep_ms(150);
+    s_nlines = 0;
+    site_a(1);
+    EXPECT(s_nlines == 1 && strcmp(s_lines[0], "a 0") == 0);
+}
+
+static void test_report_on_admit(void)
+{
+    /* Let the bucket refill, then overflow it by 2. */
+    sleep_ms(400);
+    s_nlines = 0;
+    site_a(5);
+    EXPECT(s_nlines == 3);
+
+    /* The next admitted message comes after the report of the dropped ones. */
+    sleep_ms(150);
+    site_a(1);
+    EXPECT(s_nlines == 5);
+    EXPECT(strcmp(s_lines[3], "message repeated 2 times (rate limited)") == 0);
+    EXPECT(strcmp(s_lines[4], "a 0") == 0);
+    xlog_rl_flush();
+    EXPECT(s_nlines == 5);
+}
+
+static void test_unlimited(void)
+{
+    xlog_set_rate_limit(0, 1);
+    s_nlines = 0;
+    site_b(50);
+    EXPECT(s_nlines == 50);
+    xlog_set_rate_limit(10, 3);
+}
+
+static void test_exit(void)
+{
+    char out[4096];
+    int fds[2], status;
+    size_t len = 0;
+    ssize_t n;
+    pid_t pid;
+
+    /* A site that bursts and goes quiet is reported when the process exits. */
+    fflush(NULL);
+    EXPECT(pipe(fds) == 0);
+    pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        xlog_set_log_func(xlog_default_func);
+        sleep_ms(400);
+        site_b(10);
+        exit(0);
+    }
+    close(fds[1]);
+    while (len < sizeof(out) - 1 &&
+           (n = read(fds[0], out + len, sizeof(out) - 1 - len)) > 0) {
+        len += (size_t) n;
+    }
+    out[len] = '\0';
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT(strstr(out, "b 2\n") != NULL && strstr(out, "b 3\n") == NULL);
+    EXPECT(strstr(out, "message repeated 7 times (rate limited)\n") != NULL);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+    xlog_set_log_func(record_func);
+    xlog_set_rate_limit(10, 3);
+
+    test_burst();
+    test_report_on_admit();
+    test_unlimited();
+    test_exit();
+
+    xlog_set_log_func(xlog_default_func);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/*
+ * Tests of the syslog and journald sinks against a local datagram socket
+ * standing in for the daemon: the exact bytes of each datagram, with the
+ * priority and facility, and the queue of datagrams that did not fit in the
+ * socket, sent when the sink is flushed or closed.
+ *
+ * Sockets are bound in a temporary directory, removed at the end.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+/* Syslog facilities, as in <syslog.h>. */
+#define FACILITY_USER (1 << 3)
+#define FACILITY_DAEMON (3 << 3)
+#define FACILITY_LOCAL0 (16 << 3)
+
+#define MESSAGES 2000
+
+static char s_dir[] = "/tmp/xlog-sink-XXXXXX";
+
+/* The sink a message goes to, and the time xlog gave it. */
+static XlogFunc s_sink;
+static XlogTime s_time;
+
+/* Record the time of the message, which the sink reuses, and forward it. */
+static void timed_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    s_time = *xlog_time();
+    s_sink(priority, print_loc, file, line, func, fmt, args);
+}
+
+/* Bind a nonblocking datagram socket standing in for a daemon. */
+static int bind_daemon(const char *name, char *path, size_t size)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    snprintf(path, size, "%s/%s", s_dir, name);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    EXPECT(fd >= 0);
+    EXPECT(bind(fd, (const struct sockaddr *) &addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+/* Receive one datagram, NUL-terminated; returns its length or -1. */
+static ssize_t receive(int fd, char *buf, size_t size)
+{
+    ssize_t n = recv(fd, buf, size - 1, 0);
+
+    buf[(n > 0) ? n : 0] = '\0';
+    return n;
+}
+
+static void test_syslog_format(void)
+{
+    char path[128], buf[2048], expected[2048], date[32];
+    struct tm tm;
+    ssize_t n;
+    int fd, line;
+
+    fd = bind_daemon("syslog", path, sizeof(path));
+    EXPECT(xlog_syslog_sink_open(path, "tester", FACILITY_DAEMON) == 0);
+    /* A second open fails without touching the open sink's facility. */
+    EXPECT(xlog_syslog_sink_open(path, "other", FACILITY_LOCAL0) == EBUSY);
+
+    s_sink = xlog_syslog_sink_func;
+    xlog_set_log_func(timed_func);
+    line = __LINE__ + 1;
+    xlog(XLOG_ERR, "disk %s is %d%% full", "sda", 93);
+
+    localtime_r(&s_time.real.tv_sec, &tm);
+    strftime(date, sizeof(date), "%b %e %H:%M:%S", &tm);
+    snprintf(expected, sizeof(expected),
+             "<%d>%s tester[%d]: %s:%d [test_syslog_format]: disk sda is 93%% full",
+             FACILITY_DAEMON | XLOG_ERR, date, (int) getpid(), __FILE__, line);
+    n = receive(fd, buf, sizeof(buf));
+    EXPECT(n == (ssize_t) strlen(expected));
+    EXPECT(strcmp(buf, expected) == 0);
+    EXPECT(receive(fd, buf, sizeof(buf)) < 0 && errno == EAGAIN);
+
+    xlog_set_log_func(xlog_default_func);
+    xlog_syslog_sink_close();
+    EXPECT(xlog_syslog_sink_dropped() == 0);
+
+    /* The default facility is LOG_USER. */
+    EXPECT(xlog_syslog_sink_open(path, "tester", 0) == 0);
+    xlog_set_log_func(timed_func);
+    xlog(XLOG_INFO, "%s", "user");
+    xlog_set_log_func(xlog_default_func);
+    xlog_syslog_sink_close();
+    EXPECT(receive(fd, buf, sizeof(buf)) > 0);
+    snprintf(expected, sizeof(expected), "<%d>", FACILITY_USER | XLOG_INFO);
+    EXPECT(strncmp(buf, expected, strlen(expected)) == 0);
+    EXPECT(strlen(buf) > 7 && strcmp(buf + strlen(buf) - 7, "]: user") == 0);
+
+    close(fd);
+    unlink(path);
+}
+
+static void test_journald_format(void)
+{
+    char path[128], buf[2048], expected[2048];
+    const char *msg = "two\nlines";
+    size_t len;
+    ssize_t n;
+    int fd, line;
+
+    fd = bind_daemon("journal", path, sizeof(path));
+    EXPECT(xlog_journald_sink_open(path, "tester") == 0);
+    EXPECT(xlog_journald_sink_open(path, "other") == EBUSY);
+
+    s_sink = xlog_journald_sink_func;
+    xlog_set_log_func(timed_func);
+    line = __LINE__ + 1;
+    xlog(XLOG_WARNING, "%s", msg);
+    xlog_set_log_func(xlog_default_func);
+
+    /* KEY=value fields, then MESSAGE in the binary form with a length. */
+    len = (size_t) snprintf(expected, sizeof(expected),
+                            "PRIORITY=%d\nSYSLOG_IDENTIFIER=tester\nCODE_FILE=%s\n"
+                            "CODE_LINE=%d\nCODE_FUNC=test_journald_format\nMESSAGE\n",
+                            XLOG_WARNING, __FILE__, line);
+    for (int i = 0; i < 8; i++) {
+        expected[len++] = (char) ((i == 0) ? strlen(msg) : 0);
+    }
+    memcpy(expected + len, msg, strlen(msg));
+    len += strlen(msg);
+    expected[len++] = '\n';
+
+    n = recv(fd, buf, sizeof(buf), 0);
+    EXPECT(n == (ssize_t) len);
+    EXPECT(n == (ssize_t) len && memcmp(buf, expected, len) == 0);
+
+    xlog_journald_sink_close();
+    EXPECT(xlog_journald_sink_dropped() == 0);
+    close(fd);
+    unlink(path);
+}
+
+/*
+ * Receive the datagrams waiting on fd, checking that they are the messages
+ * "q <next>", "q <next + 1>", ... Returns the number received.
+ */
+static int receive_run(int fd, int *next)
+{
+    char buf[2048], expected[32];
+    const char *p;
+    int n = 0;
+
+    while (receive(fd, buf, sizeof(buf)) > 0) {
+        snprintf(expected, sizeof(expected), "]: q %d", *next);
+        p = strstr(buf, "]: q ");
+        if (p == NULL || strcmp(p, expected) != 0) {
+            fprintf(stderr, "received \"%s\", expected \"%s\"\n", buf, expected);
+            s_failures++;
+            return n;
+        }
+        (*next)++;
+        n++;
+    }
+    return n;
+}
+
+/* Flush the sink and receive what it sent until it has nothing left. */
+static int flush_run(int fd, int *next)
+{
+    int n = 0, got;
+
+    do {
+        xlog_syslog_sink_flush();
+        got = receive_run(fd, next);
+        n += got;
+    } while (got > 0);
+    return n;
+}
+
+typedef struct {
+    int fd;
+    int next;
+    int received;
+} Reader;
+
+/* Receive datagrams as they come, until none comes for a while. */
+static void *reader_main(void *arg)
+{
+    Reader *r = arg;
+    struct pollfd pfd = { r->fd, POLLIN, 0 };
+
+    while (poll(&pfd, 1, 500) > 0) {
+        r->received += receive_run(r->fd, &r->next);
+    }
+    return NULL;
+}
+
+static void test_queue(void)
+{
+    char path[128];
+    int fd, next = 0, sent, queued;
+    size_t dropped;
+    Reader reader;
+    pthread_t thread;
+
+    fd = bind_daemon("queue", path, sizeof(path));
+    EXPECT(xlog_syslog_sink_open(path, "tester", 0) == 0);
+    xlog_set_log_func(xlog_syslog_sink_func);
+
+    /*
+     * Nobody reads the socket: once it is full, messages are queued, and once
+     * the queue is full too, dropped.
+     */
+    for (int i = 0; i < MESSAGES; i++) {
+        xlog(XLOG_INFO, "q %d", i);
+    }
+    dropped = xlog_syslog_sink_dropped();
+    EXPECT(dropped > 0);
+    sent = receive_run(fd, &next);
+    EXPECT(sent > 0);
+
+    /* The queued messages are sent, in order, as the socket drains. */
+    queued = flush_run(fd, &next);
+    EXPECT(queued > 0);
+    EXPECT((size_t) (sent + queued) + dropped == MESSAGES);
+    EXPECT(xlog_syslog_sink_dropped() == dropped);
+
+    /*
+     * Fill the socket and the queue again. Closing sends the queue, waiting
+     * for the socket to drain as it is read.
+     */
+    for (int i = 0; i < MESSAGES; i++) {
+        xlog(XLOG_INFO, "q %d", i);
+    }
+    xlog_set_log_func(xlog_default_func);
+    dropped = xlog_syslog_sink_dropped();
+    memset(&reader, 0, sizeof(reader));
+    reader.fd = fd;
+    EXPECT(pthread_create(&thread, NULL, reader_main, &reader) == 0);
+    xlog_syslog_sink_close();
+    pthread_join(thread, NULL);
+    EXPECT(reader.received == sent + queued);
+    EXPECT(xlog_syslog_sink_dropped() == dropped);
+
+    close(fd);
+    unlink(path);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+    if (mkdtemp(s_dir) == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    test_syslog_format();
+    test_journald_format();
+    test_queue();
+
+    rmdir(s_dir);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
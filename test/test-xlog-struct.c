@@ -0,0 +1,395 @@
+/*
+ * Tests of the structured formats: escaping in JSON and logfmt, including
+ * control bytes and invalid UTF-8, non-finite doubles, and lines cut at their
+ * maximum length, which must drop whole fields and stay valid.
+ *
+ * Messages are logged by the default log function at XLOG_INFO, so they go to
+ * stdout, which is captured in a temporary file. Every JSON line is checked
+ * with a small validator.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+/* Maximum length of an encoded line, including the newline. */
+#define LINE_MAX_LEN 1024
+
+static int s_saved_fd, s_file;
+static char s_out[1 << 20];
+
+static void capture_start(void)
+{
+    char path[] = "/tmp/xlog-struct-XXXXXX";
+
+    fflush(NULL);
+    s_file = mkstemp(path);
+    unlink(path);
+    s_saved_fd = dup(STDOUT_FILENO);
+    dup2(s_file, STDOUT_FILENO);
+}
+
+/* Read what was written since the last call. */
+static char *capture_read(void)
+{
+    static off_t offset;
+    ssize_t n = pread(s_file, s_out, sizeof(s_out) - 1, offset);
+
+    n = (n > 0) ? n : 0;
+    s_out[n] = '\0';
+    offset += n;
+    return s_out;
+}
+
+static void capture_end(void)
+{
+    fflush(NULL);
+    dup2(s_saved_fd, STDOUT_FILENO);
+    close(s_saved_fd);
+    close(s_file);
+}
+
+/* Length of the valid UTF-8 sequence at p, per the Unicode table, or 0. */
+static int utf8_seq(const unsigned char *p)
+{
+    unsigned char lo = 0x80, hi = 0xbf;
+    int n;
+
+    if (*p >= 0xc2 && *p <= 0xdf) {
+        n = 2;
+    }
+    else if (*p >= 0xe0 && *p <= 0xef) {
+        n = 3;
+        lo = (*p == 0xe0) ? 0xa0 : 0x80;
+        hi = (*p == 0xed) ? 0x9f : 0xbf;
+    }
+    else if (*p >= 0xf0 && *p <= 0xf4) {
+        n = 4;
+        lo = (*p == 0xf0) ? 0x90 : 0x80;
+        hi = (*p == 0xf4) ? 0x8f : 0xbf;
+    }
+    else {
+        return 0;
+    }
+    if (p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (int i = 2; i < n; i++) {
+        if (p[i] < 0x80 || p[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+static const char *json_string(const char *p)
+{
+    if (*p++ != '"') {
+        return NULL;
+    }
+    while (*p != '"') {
+        unsigned char c = (unsigned char) *p;
+        int n;
+
+        if (c < 0x20) {
+            return NULL;
+        }
+        if (c == '\\') {
+            p++;
+            if (*p == 'u') {
+                for (int i = 1; i <= 4; i++) {
+                    if (strchr("0123456789abcdefABCDEF", p[i]) == NULL || p[i] == '\0') {
+                        return NULL;
+                    }
+                }
+                p += 5;
+            }
+            else if (*p != '\0' && strchr("\"\\/bfnrt", *p) != NULL) {
+                p++;
+            }
+            else {
+                return NULL;
+            }
+        }
+        else if (c >= 0x80) {
+            n = utf8_seq((const unsigned char *) p);
+            if (n == 0) {
+                return NULL;
+            }
+            p += n;
+        }
+        else {
+            p++;
+        }
+    }
+    return p + 1;
+}
+
+static const char *json_number(const char *p)
+{
+    const char *start;
+
+    if (*p == '-') {
+        p++;
+    }
+    if (*p == '0') {
+        p++;
+    }
+    else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    else {
+        return NULL;
+    }
+    if (*p == '.') {
+        start = ++p;
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == start) {
+            return NULL;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') {
+            p++;
+        }
+        start = p;
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == start) {
+            return NULL;
+        }
+    }
+    return p;
+}
+
+static const char *json_value(const char *p)
+{
+    if (*p == '"') {
+        return json_string(p);
+    }
+    if (strncmp(p, "true", 4) == 0 || strncmp(p, "null", 4) == 0) {
+        return p + 4;
+    }
+    if (strncmp(p, "false", 5) == 0) {
+        return p + 5;
+    }
+    return json_number(p);
+}
+
+/* Whether line, without its newline, is one flat JSON object. */
+static bool json_valid(const char *line)
+{
+    const char *p = line;
+
+    if (*p++ != '{') {
+        return false;
+    }
+    if (*p == '}') {
+        return p[1] == '\0';
+    }
+    for (;;) {
+        p = json_string(p);
+        if (p == NULL || *p++ != ':') {
+            return false;
+        }
+        p = json_value(p);
+        if (p == NULL) {
+            return false;
+        }
+        if (*p == '}') {
+            return p[1] == '\0';
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+}
+
+/* Read the single line logged since the last call, without its newline. */
+static char *read_line(void)
+{
+    char *out = capture_read();
+    size_t len = strlen(out);
+
+    EXPECT(len > 0 && out[len - 1] == '\n' && strchr(out, '\n') == out + len - 1);
+    if (len > 0) {
+        out[len - 1] = '\0';
+    }
+    return out;
+}
+
+static void test_json_escaping(void)
+{
+    char *line;
+
+    xlog_set_log_format(XLOG_FORMAT_JSON);
+
+    xlog_kv(XLOG_INFO, "quote \" back \\ nl \n",
+            xlog_kv_str("ctl", "\x01\x1f\x7f\t\r"),
+            xlog_kv_str("utf8", "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"),
+            xlog_kv_str("k\"ey", NULL),
+            xlog_kv_bool("b", false));
+    line = read_line();
+    EXPECT(json_valid(line));
+    EXPECT(strstr(line, ",\"msg\":\"quote \\\" back \\\\ nl \\n\",") != NULL);
+    EXPECT(strstr(line, ",\"ctl\":\"\\u0001\\u001f\\u007f\\t\\r\",") != NULL);
+    EXPECT(strstr(line, ",\"utf8\":\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\",") != NULL);
+    EXPECT(strstr(line, ",\"k\\\"ey\":null,\"b\":false}") != NULL);
+
+    /*
+     * Invalid UTF-8 is replaced byte by byte: a lone byte, a lead byte without
+     * its continuation, an overlong '/', a surrogate, a code point past
+     * U+10FFFF and a sequence cut short.
+     */
+    xlog_kv(XLOG_INFO, "bad",
+            xlog_kv_str("bad", "\xff\xc3(\xc0\xaf\xed\xa0\x80\xf4\x90\x80\x80\xe2\x82"));
+    line = read_line();
+    EXPECT(json_valid(line));
+    EXPECT(strstr(line, ",\"bad\":\"\\ufffd\\ufffd(\\ufffd\\ufffd"
+                        "\\ufffd\\ufffd\\ufffd"
+                        "\\ufffd\\ufffd\\ufffd\\ufffd"
+                        "\\ufffd\\ufffd\"}") != NULL);
+
+    /* The same goes for a formatted message. */
+    xlog(XLOG_INFO, "%s|%c", "\xc3\xa9\x80", 0x01);
+    line = read_line();
+    EXPECT(json_valid(line));
+    EXPECT(strstr(line, ",\"msg\":\"\xc3\xa9\\ufffd|\\u0001\"}") != NULL);
+}
+
+static void test_doubles(void)
+{
+    char *line;
+
+    xlog_set_log_format(XLOG_FORMAT_JSON);
+    xlog_kv(XLOG_INFO, "d",
+            xlog_kv_double("nan", NAN), xlog_kv_double("inf", INFINITY),
+            xlog_kv_double("ninf", -INFINITY), xlog_kv_double("x", 1.5),
+            xlog_kv_double("big", 1e20), xlog_kv_double("neg", -0.25),
+            xlog_kv_double("negz", -0.0));
+    line = read_line();
+    EXPECT(json_valid(line));
+    EXPECT(strstr(line, ",\"nan\":null,\"inf\":null,\"ninf\":null,\"x\":1.5,"
+                        "\"big\":1e+20,\"neg\":-0.25,\"negz\":0}") != NULL);
+
+    xlog_set_log_format(XLOG_FORMAT_LOGFMT);
+    xlog_kv(XLOG_INFO, "d",
+            xlog_kv_double("nan", NAN), xlog_kv_double("inf", INFINITY),
+            xlog_kv_double("ninf", -INFINITY), xlog_kv_double("x", 1.5));
+    line = read_line();
+    EXPECT(strstr(line, " nan=NaN inf=+Inf ninf=-Inf x=1.5") != NULL);
+}
+
+static void test_logfmt_escaping(void)
+{
+    char *line;
+
+    xlog_set_log_format(XLOG_FORMAT_LOGFMT);
+    xlog_kv(XLOG_INFO, "two words",
+            xlog_kv_str("a key", "x=y"), xlog_kv_str("plain", "v"),
+            xlog_kv_str("empty", ""), xlog_kv_str("q", "say \"hi\"\n"),
+            xlog_kv_str("utf8", "caf\xc3\xa9"), xlog_kv_str("bad", "ab\xff"));
+    line = read_line();
+    EXPECT(strstr(line, " msg=\"two words\" a_key=\"x=y\" plain=v empty=\"\" "
+                        "q=\"say \\\"hi\\\"\\n\" utf8=caf\xc3\xa9 "
+                        "bad=\"ab\\ufffd\"") != NULL);
+    EXPECT(strncmp(line, "ts=", 3) == 0);
+}
+
+/*
+ * Log a message long enough to push a 20-digit field across the end of the
+ * line, growing it byte by byte, and check each line.
+ */
+static void test_truncation(XlogFormat format)
+{
+    static char msg[LINE_MAX_LEN + 1];
+    int with = 0, without = 0, lines = 0;
+    const char *num = (format == XLOG_FORMAT_JSON) ? "\"num\":" : " num=";
+    char full[64];
+    char *out, *line, *nl;
+
+    snprintf(full, sizeof(full), "%s%llu", num, (unsigned long long) UINT64_MAX);
+    xlog_set_log_format(format);
+    for (size_t len = 700; len < sizeof(msg); len++) {
+        memset(msg, 'y', len);
+        msg[len] = '\0';
+        xlog_kv(XLOG_INFO, msg,
+                xlog_kv_uint("num", UINT64_MAX), xlog_kv_str("tail", "end"));
+    }
+
+    out = capture_read();
+    for (line = out; (nl = strchr(line, '\n')) != NULL; line = nl + 1) {
+        *nl = '\0';
+        lines++;
+        EXPECT(nl - line + 1 <= LINE_MAX_LEN);
+        /* A field is there whole or not at all. */
+        if (strstr(line, num) != NULL) {
+            EXPECT(strstr(line, full) != NULL);
+            with++;
+        }
+        else {
+            without++;
+        }
+        if (format == XLOG_FORMAT_JSON) {
+            EXPECT(json_valid(line));
+        }
+        else {
+            EXPECT(nl[-1] != '=');
+        }
+    }
+    EXPECT(lines == (int) (sizeof(msg) - 700));
+    EXPECT(with > 0 && without > 0);
+
+    /* A formatted message is cut at 511 bytes, with nothing after it. */
+    memset(msg, 'z', 600);
+    msg[600] = '\0';
+    xlog(XLOG_INFO, "%s", msg);
+    line = read_line();
+    memset(msg + 511, '\0', 89);
+    strcat(msg, (format == XLOG_FORMAT_JSON) ? "\"}" : "");
+    EXPECT(strstr(line, msg) != NULL);
+    EXPECT(strcmp(line + strlen(line) - strlen(msg), msg) == 0);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+    capture_start();
+
+    test_json_escaping();
+    test_doubles();
+    test_logfmt_escaping();
+    test_truncation(XLOG_FORMAT_JSON);
+    test_truncation(XLOG_FORMAT_LOGFMT);
+
+    capture_end();
+    xlog_set_log_format(XLOG_FORMAT_TEXT);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
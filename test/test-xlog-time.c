@@ -0,0 +1,214 @@
+/*
+ * Tests of message timestamps: within a message, xlog_time reads the clocks
+ * once and every later call returns that reading; outside of one, it returns
+ * the current time. Also tests the time prefix format and the coarse clocks.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <xlib/xlog.h>
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+XLOG_CATEGORY_DEFINE(s_cat, "time-test");
+
+/* The two readings of xlog_time made by the last message logged. */
+static XlogTime s_first, s_second;
+static int s_logged;
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+static void time_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) line;
+    (void) func;
+    (void) fmt;
+    (void) args;
+    s_first = *xlog_time();
+    sleep_ms(2);
+    s_second = *xlog_time();
+    s_logged++;
+}
+
+static void null_func(
+    XlogPriority priority,
+    bool print_loc,
+    const char *file,
+    int line,
+    const char *func,
+    const char *fmt,
+    va_list args)
+{
+    (void) priority;
+    (void) print_loc;
+    (void) file;
+    (void) line;
+    (void) func;
+    (void) fmt;
+    (void) args;
+}
+
+static double seconds(const struct timespec *ts)
+{
+    return ts->tv_sec + ts->tv_nsec * 1e-9;
+}
+
+static bool same_time(const XlogTime *a, const XlogTime *b)
+{
+    return a->mono.tv_sec == b->mono.tv_sec && a->mono.tv_nsec == b->mono.tv_nsec &&
+           a->real.tv_sec == b->real.tv_sec && a->real.tv_nsec == b->real.tv_nsec;
+}
+
+/* Check that a message read the time once, between before and after. */
+static void check_message(const struct timespec *before, const struct timespec *after)
+{
+    EXPECT(same_time(&s_first, &s_second));
+    EXPECT(seconds(&s_first.mono) >= seconds(before));
+    EXPECT(seconds(&s_first.mono) <= seconds(after));
+}
+
+static void test_once_per_message(void)
+{
+    struct timespec before, after;
+    XlogTime previous;
+
+    xlog_set_log_func(time_func);
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    xlog(XLOG_INFO, "%d", 1);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    check_message(&before, &after);
+    previous = s_first;
+
+    /* Each message gets its own reading, whatever the entry point. */
+    s_logged = 0;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    xlog_nofmt(XLOG_INFO, "nofmt");
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    check_message(&before, &after);
+    EXPECT(seconds(&s_first.mono) > seconds(&previous.mono));
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    xlog_cat(&s_cat, XLOG_INFO, "%d", 2);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    check_message(&before, &after);
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    xlog_kv(XLOG_INFO, "kv", xlog_kv_int("n", 3));
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    check_message(&before, &after);
+    EXPECT(s_logged == 3);
+}
+
+static void test_outside_message(void)
+{
+    XlogTime a, b;
+
+    /* A message whose log function never asks for the time. */
+    xlog_set_log_func(null_func);
+    xlog(XLOG_INFO, "%d", 0);
+
+    /* Outside of a message, every call reads the clocks. */
+    a = *xlog_time();
+    sleep_ms(2);
+    b = *xlog_time();
+    EXPECT(seconds(&b.mono) - seconds(&a.mono) >= 0.002);
+    EXPECT(seconds(&b.real) > seconds(&a.real));
+}
+
+static void test_prefix(void)
+{
+    XlogTime t;
+    char buf[XLOG_TIME_PREFIX_LEN + 1];
+    char expected[XLOG_TIME_PREFIX_LEN + 1];
+    struct tm tm;
+
+    setenv("TZ", "UTC", 1);
+    tzset();
+    memset(&t, 0, sizeof(t));
+    t.real.tv_sec = 1591012800;
+    t.real.tv_nsec = 123456789;
+    memset(buf, 'x', sizeof(buf));
+    EXPECT(xlog_time_prefix(&t, buf) == XLOG_TIME_PREFIX_LEN);
+    EXPECT(strcmp(buf, "2020-06-01 12:00:00.123456") == 0);
+
+    /* Within the same second, the cached date and time are reused. */
+    t.real.tv_nsec = 999999999;
+    xlog_time_prefix(&t, buf);
+    EXPECT(strcmp(buf, "2020-06-01 12:00:00.999999") == 0);
+    t.real.tv_nsec = 0;
+    xlog_time_prefix(&t, buf);
+    EXPECT(strcmp(buf, "2020-06-01 12:00:00.000000") == 0);
+    t.real.tv_sec++;
+    xlog_time_prefix(&t, buf);
+    EXPECT(strcmp(buf, "2020-06-01 12:00:01.000000") == 0);
+
+    /* The current time is formatted like strftime does. */
+    t = *xlog_time();
+    xlog_time_prefix(&t, buf);
+    localtime_r(&t.real.tv_sec, &tm);
+    strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(expected + 19, sizeof(expected) - 19, ".%06d", (int) (t.real.tv_nsec / 1000));
+    EXPECT(strcmp(buf, expected) == 0);
+}
+
+static void test_coarse(void)
+{
+    struct timespec before, after;
+
+    xlog_set_coarse_clock(true);
+    xlog_set_log_func(time_func);
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    xlog(XLOG_INFO, "%d", 4);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    EXPECT(same_time(&s_first, &s_second));
+    /* The coarse clocks lag the precise ones by a few ticks at most. */
+    EXPECT(seconds(&s_first.mono) >= seconds(&before) - 0.1);
+    EXPECT(seconds(&s_first.mono) <= seconds(&after));
+    xlog_set_coarse_clock(false);
+}
+
+int main(void)
+{
+    xlog_set_log_priority(XLOG_INFO);
+
+    test_once_per_message();
+    test_outside_message();
+    test_prefix();
+    test_coarse();
+
+    xlog_set_log_func(xlog_default_func);
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
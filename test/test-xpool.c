@@ -0,0 +1,160 @@
+/*
+ * Tests of xpool: objects are reused rather than leaked when pools share a
+ * thread cache slot, when threads exit with cached objects, and across
+ * release.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xpool.h>
+
+/* Thread cache slots per thread, as in xpool.c. */
+#define TCACHE_SLOTS 16
+
+#define SLAB_OBJS   64
+#define BATCH       50
+#define ROUNDS      200
+#define MAX_SEEN    4096
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+/* Distinct object addresses handed out by a pool. */
+typedef struct seen {
+    void *addr[MAX_SEEN];
+    size_t n;
+} seen;
+
+static void note(seen *s, void *p)
+{
+    for (size_t i = 0; i < s->n; i++) {
+        if (s->addr[i] == p) {
+            return;
+        }
+    }
+    if (s->n < MAX_SEEN) {
+        s->addr[s->n++] = p;
+    }
+}
+
+/* Allocate and free a batch, recording the objects. */
+static void churn(xpool *pool, seen *s)
+{
+    void *objs[BATCH];
+
+    for (int i = 0; i < BATCH; i++) {
+        objs[i] = xpool_alloc(pool);
+        EXPECT(objs[i] != NULL);
+        note(s, objs[i]);
+        memset(objs[i], 0xa5, 16);
+    }
+    for (int i = 0; i < BATCH; i++) {
+        xpool_free(pool, objs[i]);
+    }
+}
+
+static void test_colliding(void)
+{
+    static seen sa, sb;
+    xpool *a, *b, *others[TCACHE_SLOTS - 1];
+
+    /* Pool ids are consecutive, so a and b share a cache slot. */
+    a = xpool_create(32, SLAB_OBJS);
+    for (int i = 0; i < TCACHE_SLOTS - 1; i++) {
+        others[i] = xpool_create(32, SLAB_OBJS);
+    }
+    b = xpool_create(32, SLAB_OBJS);
+
+    for (int round = 0; round < ROUNDS; round++) {
+        churn(a, &sa);
+        churn(b, &sb);
+    }
+    EXPECT(sa.n <= 2 * SLAB_OBJS);
+    EXPECT(sb.n <= 2 * SLAB_OBJS);
+
+    /* Caches holding objects of a destroyed pool are simply dropped. */
+    xpool_destroy(a);
+    for (int round = 0; round < 4; round++) {
+        churn(b, &sb);
+    }
+    EXPECT(sb.n <= 2 * SLAB_OBJS);
+
+    for (int i = 0; i < TCACHE_SLOTS - 1; i++) {
+        xpool_destroy(others[i]);
+    }
+    xpool_destroy(b);
+}
+
+static xpool *s_shared;
+static seen s_shared_seen;
+static pthread_mutex_t s_seen_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *thread_main(void *arg)
+{
+    void *objs[BATCH];
+
+    (void) arg;
+    for (int i = 0; i < BATCH; i++) {
+        objs[i] = xpool_alloc(s_shared);
+    }
+    pthread_mutex_lock(&s_seen_lock);
+    for (int i = 0; i < BATCH; i++) {
+        EXPECT(objs[i] != NULL);
+        note(&s_shared_seen, objs[i]);
+    }
+    pthread_mutex_unlock(&s_seen_lock);
+    for (int i = 0; i < BATCH; i++) {
+        xpool_free(s_shared, objs[i]);
+    }
+    return NULL;
+}
+
+static void test_thread_exit(void)
+{
+    pthread_t thread;
+
+    s_shared = xpool_create(48, SLAB_OBJS);
+    for (int i = 0; i < ROUNDS; i++) {
+        pthread_create(&thread, NULL, thread_main, NULL);
+        pthread_join(thread, NULL);
+    }
+    EXPECT(s_shared_seen.n <= 2 * SLAB_OBJS);
+    xpool_destroy(s_shared);
+}
+
+static void test_release(void)
+{
+    static seen s;
+    xpool *pool = xpool_create(16, SLAB_OBJS);
+
+    for (int round = 0; round < ROUNDS; round++) {
+        churn(pool, &s);
+        xpool_alloc(pool);
+        xpool_release(pool);
+    }
+    EXPECT(s.n <= SLAB_OBJS);
+    xpool_destroy(pool);
+}
+
+int main(void)
+{
+    test_colliding();
+    test_thread_exit();
+    test_release();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * Tests of xring: alignment of the queues, single-threaded wraparound and
+ * multi-threaded runs where every element must come out exactly once.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xring.h>
+
+#define NTHREADS    4
+#define PER_THREAD  50000
+#define TOTAL       (NTHREADS * PER_THREAD)
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+XRING_INIT(u32, uint32_t)
+
+static xring_mpmc_t(u32) *s_mpmc;
+static xring_spsc_t(u32) *s_spsc;
+static atomic_uchar s_seen[TOTAL];
+static atomic_uint s_popped;
+
+static void *mpmc_producer(void *arg)
+{
+    uint32_t base = (uint32_t) (uintptr_t) arg * PER_THREAD, batch[8];
+    uint32_t next = 0;
+    size_t n;
+
+    while (next < PER_THREAD) {
+        /* Alternate single and batch pushes. */
+        if (next & 1) {
+            if (xr_mpmc_push(u32, s_mpmc, base + next) == 0) {
+                next++;
+            }
+            else {
+                sched_yield();
+            }
+            continue;
+        }
+        for (n = 0; n < 8 && next + n < PER_THREAD; n++) {
+            batch[n] = base + next + n;
+        }
+        n = xr_mpmc_push_n(u32, s_mpmc, batch, n);
+        if (n == 0) {
+            sched_yield();
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+    uint32_t batch[8];
+    size_t n, want = 0;
+
+    (void) arg;
+    while (atomic_load(&s_popped) < TOTAL) {
+        /* Vary the batch size between 1 and 8. */
+        want = want % 8 + 1;
+        n = xr_mpmc_pop_n(u32, s_mpmc, batch, want);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i] >= TOTAL || atomic_fetch_add(&s_seen[batch[i]], 1) != 0) {
+                fprintf(stderr, "bad or duplicate element %u\n", batch[i]);
+                abort();
+            }
+        }
+        atomic_fetch_add(&s_popped, (unsigned int) n);
+    }
+    return NULL;
+}
+
+static void *spsc_producer(void *arg)
+{
+    uint32_t next = 0, batch[5];
+    size_t n;
+
+    (void) arg;
+    while (next < TOTAL) {
+        for (n = 0; n < 5 && next + n < TOTAL; n++) {
+            batch[n] = next + n;
+        }
+        n = xr_spsc_push_n(u32, s_spsc, batch, n);
+        if (n == 0) {
+            sched_yield();
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t producers[NTHREADS], consumers[NTHREADS], producer;
+    uint32_t expect = 0, batch[7];
+    size_t n;
+
+    /* Many producers and consumers over a small ring. */
+    s_mpmc = xr_mpmc_init(u32, 64);
+    EXPECT(s_mpmc != NULL);
+    for (uintptr_t i = 0; i < NTHREADS; i++) {
+        pthread_create(&producers[i], NULL, mpmc_producer, (void *) i);
+        pthread_create(&consumers[i], NULL, mpmc_consumer, NULL);
+    }
+    for (int i = 0; i < NTHREADS; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    EXPECT(atomic_load(&s_popped) == TOTAL);
+    for (size_t i = 0; i < TOTAL; i++) {
+        EXPECT(atomic_load(&s_seen[i]) == 1);
+    }
+    xr_mpmc_destroy(u32, s_mpmc);
+
+    /* One producer and one consumer, in order. */
+    s_spsc = xr_spsc_init(u32, 16);
+    EXPECT(s_spsc != NULL);
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+    while (expect < TOTAL) {
+        n = xr_spsc_pop_n(u32, s_spsc, batch, 7);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i] != expect++) {
+                EXPECT(batch[i] == expect - 1);
+                expect = TOTAL;
+                break;
+            }
+        }
+    }
+    pthread_join(producer, NULL);
+    xr_spsc_destroy(u32, s_spsc);
+}
+
+static void test_single(void)
+{
+    xring_spsc_t(u32) *s = xr_spsc_init(u32, 5);
+    xring_mpmc_t(u32) *m = xr_mpmc_init(u32, 5);
+    uint32_t x, buf[16];
+
+    EXPECT(s != NULL && m != NULL);
+    EXPECT((uintptr_t) s % XRING_CACHELINE == 0);
+    EXPECT((uintptr_t) m % XRING_CACHELINE == 0);
+    EXPECT((uintptr_t) &s->tail - (uintptr_t) &s->head >= XRING_CACHELINE);
+    EXPECT((uintptr_t) &m->tail - (uintptr_t) &m->head >= XRING_CACHELINE);
+    EXPECT(xr_capacity(s) == 8 && xr_capacity(m) == 8);
+
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            EXPECT(xr_spsc_push(u32, s, round * 8 + i) == 0);
+            EXPECT(xr_mpmc_push(u32, m, round * 8 + i) == 0);
+        }
+        EXPECT(xr_spsc_push(u32, s, 0) == -1);
+        EXPECT(xr_mpmc_push(u32, m, 0) == -1);
+        EXPECT(xr_spsc_pop(u32, s, &x) == 0 && x == round * 8);
+        EXPECT(xr_mpmc_pop(u32, m, &x) == 0 && x == round * 8);
+        EXPECT(xr_spsc_pop_n(u32, s, buf, 16) == 7 && buf[6] == round * 8 + 7);
+        EXPECT(xr_mpmc_pop_n(u32, m, buf, 16) == 7 && buf[6] == round * 8 + 7);
+        EXPECT(xr_spsc_pop(u32, s, &x) == -1);
+        EXPECT(xr_mpmc_pop(u32, m, &x) == -1);
+    }
+
+    xr_spsc_destroy(u32, s);
+    xr_mpmc_destroy(u32, m);
+}
+
+int main(void)
+{
+    test_single();
+    test_threads();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/*
+ * Tests of xvec: small-buffer vectors and order-preserving range operations,
+ * on both heap and inline storage.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xlib/xvec.h>
+
+#define INLINE_N 8
+
+static unsigned int s_failures;
+
+#define EXPECT(cond) do {                                                   \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+XVEC_SBO_DEFINE(small_vec, int, INLINE_N);
+
+static void test_sbo(void)
+{
+    small_vec v;
+    int *inline_a;
+
+    xv_sbo_init(v);
+    inline_a = v.a;
+    EXPECT(xv_is_inline(v));
+    EXPECT(xv_max(v) == INLINE_N);
+
+    for (int i = 0; i < INLINE_N; i++) {
+        xv_push(int, v, i);
+    }
+    EXPECT(xv_is_inline(v) && v.a == inline_a);
+    EXPECT(xv_size(v) == INLINE_N);
+
+    /* Trimming an inline vector keeps the inline capacity. */
+    (void) xv_pop(v);
+    (void) xv_pop(v);
+    xv_trim(int, v);
+    EXPECT(xv_is_inline(v));
+    EXPECT(xv_max(v) == INLINE_N);
+    xv_push(int, v, 6);
+    xv_push(int, v, 7);
+    EXPECT(xv_is_inline(v) && xv_size(v) == INLINE_N);
+
+    /* Spill to the heap, keeping the elements. */
+    xv_push(int, v, INLINE_N);
+    EXPECT(!xv_is_inline(v));
+    EXPECT(xv_max(v) >= INLINE_N + 1);
+    for (int i = 0; i <= INLINE_N; i++) {
+        EXPECT(xv_A(v, i) == i);
+    }
+
+    *xv_pushp(int, v) = 100;
+    (void) xv_a(int, v, 40);
+    xv_A(v, 40) = 40;
+    EXPECT(xv_size(v) == 41 && xv_A(v, 40) == 40 && xv_A(v, INLINE_N + 1) == 100);
+
+    xv_trim(int, v);
+    EXPECT(xv_max(v) == 41);
+
+    /* xv_destroy is an expression. */
+    (void) (xv_destroy(v), 0);
+
+    /* Copy into an inline vector, within and beyond its capacity. */
+    {
+        small_vec w;
+        xvec_t(int) src;
+
+        xv_sbo_init(w);
+        xv_init(src);
+        for (int i = 0; i < 5; i++) {
+            xv_push(int, src, i * 3);
+        }
+        xv_copy(int, w, src);
+        EXPECT(xv_is_inline(w) && xv_size(w) == 5 && xv_A(w, 4) == 12);
+
+        for (int i = 5; i < 20; i++) {
+            xv_push(int, src, i * 3);
+        }
+        xv_copy(int, w, src);
+        EXPECT(!xv_is_inline(w) && xv_size(w) == 20 && xv_A(w, 19) == 57);
+
+        xv_destroy(w);
+        xv_destroy(src);
+    }
+}
+
+#define is_odd(x) ((x) & 1)
+
+/* Check that v holds exactly the n values of want, in order. */
+#define EXPECT_VEC(v, ...) do {                                             \
+        const int _want[] = { __VA_ARGS__ };                                \
+        size_t _n = sizeof(_want) / sizeof(_want[0]);                       \
+        EXPECT(xv_size(v) == _n);                                           \
+        EXPECT(xv_size(v) != _n || memcmp(xv_data(v), _want, sizeof(_want)) == 0); \
+    } while (0)
+
+static void test_ranges(void)
+{
+    static const int src[] = { 100, 101, 102, 103 };
+    xvec_t(int) h;
+    small_vec s;
+
+    /* Heap vector. */
+    xv_init(h);
+    xv_reserve(int, h, 5);
+    EXPECT(xv_max(h) >= 5 && xv_size(h) == 0);
+    for (int i = 0; i < 6; i++) {
+        xv_push(int, h, i);
+    }
+    xv_insert_n(int, h, 2, src, 2);
+    EXPECT_VEC(h, 0, 1, 100, 101, 2, 3, 4, 5);
+    xv_insert_n(int, h, xv_size(h), src + 3, 1);
+    EXPECT_VEC(h, 0, 1, 100, 101, 2, 3, 4, 5, 103);
+    xv_insert_n(int, h, 0, src, 1);
+    EXPECT_VEC(h, 100, 0, 1, 100, 101, 2, 3, 4, 5, 103);
+    xv_splice(int, h, 1, 4, src, 1);
+    EXPECT_VEC(h, 100, 100, 2, 3, 4, 5, 103);
+    xv_splice(int, h, 2, 2, src, 4);
+    EXPECT_VEC(h, 100, 100, 100, 101, 102, 103, 4, 5, 103);
+    xv_erase_range(h, 1, 5);
+    EXPECT_VEC(h, 100, 103, 4, 5, 103);
+    xv_erase_range(h, 2, 2);
+    EXPECT_VEC(h, 100, 103, 4, 5, 103);
+    xv_remove_if(h, is_odd);
+    EXPECT_VEC(h, 100, 4);
+    xv_erase_range(h, 0, xv_size(h));
+    EXPECT(xv_size(h) == 0);
+    xv_destroy(h);
+
+    /* Middle of an inline vector, staying inline. */
+    xv_sbo_init(s);
+    xv_reserve(int, s, INLINE_N);
+    EXPECT(xv_is_inline(s));
+    for (int i = 0; i < 4; i++) {
+        xv_push(int, s, i);
+    }
+    xv_insert_n(int, s, 2, src, 4);
+    EXPECT(xv_is_inline(s));
+    EXPECT_VEC(s, 0, 1, 100, 101, 102, 103, 2, 3);
+    xv_erase_range(s, 1, 3);
+    EXPECT(xv_is_inline(s));
+    EXPECT_VEC(s, 0, 101, 102, 103, 2, 3);
+    xv_splice(int, s, 1, 3, src, 2);
+    EXPECT_VEC(s, 0, 100, 101, 2, 3);
+    xv_remove_if(s, is_odd);
+    EXPECT(xv_is_inline(s));
+    EXPECT_VEC(s, 0, 100, 2);
+
+    /* Growing past the inline capacity in the middle moves to the heap. */
+    xv_insert_n(int, s, 1, src, 4);
+    xv_insert_n(int, s, 1, src, 4);
+    EXPECT(!xv_is_inline(s));
+    EXPECT_VEC(s, 0, 100, 101, 102, 103, 100, 101, 102, 103, 100, 2);
+    xv_erase_range(s, 1, 9);
+    EXPECT_VEC(s, 0, 100, 2);
+    xv_destroy(s);
+
+    /* Reserving beyond the inline capacity moves to the heap once. */
+    xv_sbo_init(s);
+    xv_push(int, s, 9);
+    xv_reserve(int, s, INLINE_N + 1);
+    EXPECT(!xv_is_inline(s) && xv_max(s) >= INLINE_N + 1);
+    EXPECT_VEC(s, 9);
+    xv_destroy(s);
+}
+
+int main(void)
+{
+    test_sbo();
+    test_ranges();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%u failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}